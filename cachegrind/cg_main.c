@@ -43,6 +43,7 @@
 #include "pub_tool_xarray.h"
 #include "pub_tool_clientstate.h"
 #include "pub_tool_machine.h"      // VG_(fnptr_to_fnentry)
+#include "pub_tool_aspacemgr.h"    // VG_(am_find_nsegment)
 
 #include "cg_arch.h"
 #include "cg_sim.c"
@@ -61,6 +62,16 @@
 
 static Bool  clo_cache_sim  = True;  /* do cache simulation? */
 static Bool  clo_branch_sim = False; /* do branch simulation? */
+static Int   clo_sim_cores  = 1;     /* number of cores to simulate */
+static Int   clo_prefetch   = 0;     /* PF_STREAM and/or PF_STRIDE */
+static Int   clo_prefetch_distance = 2; /* lines or strides ahead */
+static Bool  clo_tlb_sim    = False; /* simulate the DTLB? */
+static Bool  clo_tlb_huge_pages = False; /* 2MB pages for anon memory? */
+static Bool  clo_binary_out = False; /* --cachegrind-out-format=binary? */
+
+/* Use cachesim_D1_doref_X for data accesses?  Set in cg_post_clo_init
+   if any of --sim-cores, --prefetch and --tlb-sim asks for it. */
+static Bool  ext_sim        = False;
 static const HChar* clo_cachegrind_out_file = "cachegrind.out.%p";
 
 /*------------------------------------------------------------*/
@@ -109,6 +120,7 @@ typedef struct {
    CacheCC  Dw;  /* Data write/modify counts */
    BranchCC Bc;  /* Conditional branch counts */
    BranchCC Bi;  /* Indirect branch counts */
+   ExtCC    Dx;  /* --sim-cores, --prefetch and --tlb-sim counts */
 } LineCC;
 
 // First compare file, then fn, then line.
@@ -280,6 +292,13 @@ static LineCC* get_lineCC(Addr origAddr)
       lineCC->Bc.mp    = 0;
       lineCC->Bi.b     = 0;
       lineCC->Bi.mp    = 0;
+      lineCC->Dx.inv   = 0;
+      lineCC->Dx.mc    = 0;
+      lineCC->Dx.mf    = 0;
+      lineCC->Dx.pf    = 0;
+      lineCC->Dx.pfu   = 0;
+      lineCC->Dx.tlb1m = 0;
+      lineCC->Dx.tlbm  = 0;
       VG_(OSetGen_Insert)(CC_table, lineCC);
    }
 
@@ -437,6 +456,37 @@ void log_0Ir_1Dw_cache_access(InstrInfo* n, Addr data_addr, Word data_size)
    n->parent->Dw.a++;
 }
 
+/* The data access helpers used when ext_sim is set.  A modify is
+   counted as a read, but with --sim-cores it invalidates the line in the
+   other cores' D1 caches as a write does.  log_0Ir_1Dr_X_cache_access and
+   log_0Ir_1Dw_X_cache_access are also used by addEvent_D_guarded. */
+static VG_REGPARM(3)
+void log_0Ir_1Dr_X_cache_access(InstrInfo* n, Addr data_addr, Word data_size)
+{
+   cachesim_D1_doref_X(data_addr, data_size, False, n->instr_addr,
+                       &n->parent->Dr.m1, &n->parent->Dr.mL,
+                       &n->parent->Dx);
+   n->parent->Dr.a++;
+}
+
+static VG_REGPARM(3)
+void log_0Ir_1Dm_X_cache_access(InstrInfo* n, Addr data_addr, Word data_size)
+{
+   cachesim_D1_doref_X(data_addr, data_size, True, n->instr_addr,
+                       &n->parent->Dr.m1, &n->parent->Dr.mL,
+                       &n->parent->Dx);
+   n->parent->Dr.a++;
+}
+
+static VG_REGPARM(3)
+void log_0Ir_1Dw_X_cache_access(InstrInfo* n, Addr data_addr, Word data_size)
+{
+   cachesim_D1_doref_X(data_addr, data_size, True, n->instr_addr,
+                       &n->parent->Dw.m1, &n->parent->Dw.mL,
+                       &n->parent->Dx);
+   n->parent->Dw.a++;
+}
+
 /* For branches, we consult two different predictors, one which
    predicts taken/untaken for conditional branches, and the other
    which predicts the branch target address for indirect branches
@@ -731,8 +781,10 @@ static void flushEvents ( CgState* cgs )
          i appropriately. */
       switch (ev->tag) {
          case Ev_IrNoX:
-            /* Merge an IrNoX with a following Dr/Dm. */
-            if (ev2 && (ev2->tag == Ev_Dr || ev2->tag == Ev_Dm)) {
+            /* Merge an IrNoX with a following Dr/Dm.  With ext_sim
+               the data accesses have helpers of their own. */
+            if (!ext_sim
+                && ev2 && (ev2->tag == Ev_Dr || ev2->tag == Ev_Dm)) {
                /* Why is this true?  It's because we're merging an Ir
                   with a following Dr or Dm.  The Ir derives from the
                   instruction's IMark and the Dr/Dm from data
@@ -752,7 +804,7 @@ static void flushEvents ( CgState* cgs )
             }
             /* Merge an IrNoX with a following Dw. */
             else
-            if (ev2 && ev2->tag == Ev_Dw) {
+            if (!ext_sim && ev2 && ev2->tag == Ev_Dw) {
                tl_assert(ev2->inode == ev->inode);
                helperName = "log_1IrNoX_1Dw_cache_access";
                helperAddr = &log_1IrNoX_1Dw_cache_access;
@@ -823,8 +875,16 @@ static void flushEvents ( CgState* cgs )
          case Ev_Dr:
          case Ev_Dm:
             /* Data read or modify */
-            helperName = "log_0Ir_1Dr_cache_access";
-            helperAddr = &log_0Ir_1Dr_cache_access;
+            if (!ext_sim) {
+               helperName = "log_0Ir_1Dr_cache_access";
+               helperAddr = &log_0Ir_1Dr_cache_access;
+            } else if (ev->tag == Ev_Dr) {
+               helperName = "log_0Ir_1Dr_X_cache_access";
+               helperAddr = &log_0Ir_1Dr_X_cache_access;
+            } else {
+               helperName = "log_0Ir_1Dm_X_cache_access";
+               helperAddr = &log_0Ir_1Dm_X_cache_access;
+            }
             argv = mkIRExprVec_3( i_node_expr, 
                                   get_Event_dea(ev), 
                                   mkIRExpr_HWord( get_Event_dszB(ev) ) );
@@ -833,8 +893,13 @@ static void flushEvents ( CgState* cgs )
             break;
          case Ev_Dw:
             /* Data write */
-            helperName = "log_0Ir_1Dw_cache_access";
-            helperAddr = &log_0Ir_1Dw_cache_access;
+            if (!ext_sim) {
+               helperName = "log_0Ir_1Dw_cache_access";
+               helperAddr = &log_0Ir_1Dw_cache_access;
+            } else {
+               helperName = "log_0Ir_1Dw_X_cache_access";
+               helperAddr = &log_0Ir_1Dw_X_cache_access;
+            }
             argv = mkIRExprVec_3( i_node_expr,
                                   get_Event_dea(ev), 
                                   mkIRExpr_HWord( get_Event_dszB(ev) ) );
@@ -980,12 +1045,21 @@ void addEvent_D_guarded ( CgState* cgs, InstrInfo* inode,
    Int          regparms;
    IRDirty*     di;
    i_node_expr = mkIRExpr_HWord( (HWord)inode );
-   helperName  = isWrite ? "log_0Ir_1Dw_cache_access"
-                         : "log_0Ir_1Dr_cache_access";
-   helperAddr  = isWrite ? &log_0Ir_1Dw_cache_access
-                         : &log_0Ir_1Dr_cache_access;
-   argv        = mkIRExprVec_3( i_node_expr,
-                                ea, mkIRExpr_HWord( datasize ) );
+   if (ext_sim) {
+      helperName = isWrite ? "log_0Ir_1Dw_X_cache_access"
+                           : "log_0Ir_1Dr_X_cache_access";
+      helperAddr = isWrite ? &log_0Ir_1Dw_X_cache_access
+                           : &log_0Ir_1Dr_X_cache_access;
+      argv       = mkIRExprVec_3( i_node_expr,
+                                  ea, mkIRExpr_HWord( datasize ) );
+   } else {
+      helperName = isWrite ? "log_0Ir_1Dw_cache_access"
+                           : "log_0Ir_1Dr_cache_access";
+      helperAddr = isWrite ? &log_0Ir_1Dw_cache_access
+                           : &log_0Ir_1Dr_cache_access;
+      argv       = mkIRExprVec_3( i_node_expr,
+                                  ea, mkIRExpr_HWord( datasize ) );
+   }
    regparms    = 3;
    di          = unsafeIRDirty_0_N(
                     regparms, 
@@ -1371,14 +1445,210 @@ static CacheCC  Dr_total;
 static CacheCC  Dw_total;
 static BranchCC Bc_total;
 static BranchCC Bi_total;
+static ExtCC    Dx_total;
+
+// The most events there can be: 9 cache, 4 branch and 7 ext_sim ones.
+#define MAX_EVENTS  20
+
+// Fills in 'c' with the counts of the events that are being collected,
+// in the order of the "events:" line, and returns how many there are.
+static Int get_counts(ULong* c,
+                      const CacheCC* Ir, const CacheCC* Dr, const CacheCC* Dw,
+                      const BranchCC* Bc, const BranchCC* Bi, const ExtCC* Dx)
+{
+   Int n = 0;
+   c[n++] = Ir->a;
+   if (clo_cache_sim) {
+      c[n++] = Ir->m1; c[n++] = Ir->mL;
+      c[n++] = Dr->a;  c[n++] = Dr->m1; c[n++] = Dr->mL;
+      c[n++] = Dw->a;  c[n++] = Dw->m1; c[n++] = Dw->mL;
+   }
+   if (clo_branch_sim) {
+      c[n++] = Bc->b;  c[n++] = Bc->mp;
+      c[n++] = Bi->b;  c[n++] = Bi->mp;
+   }
+   // The ext_sim events come last, so that the other columns don't
+   // move with them.
+   if (clo_sim_cores > 1) {
+      c[n++] = Dx->inv; c[n++] = Dx->mc; c[n++] = Dx->mf;
+   }
+   if (clo_prefetch != 0) {
+      c[n++] = Dx->pf;  c[n++] = Dx->pfu;
+   }
+   if (clo_tlb_sim) {
+      c[n++] = Dx->tlb1m; c[n++] = Dx->tlbm;
+   }
+   tl_assert(n <= MAX_EVENTS);
+   return n;
+}
+
+// Appends the space-separated 'events' to 'buf', which may already end
+// in a space (the cache-only line historically does).
+static void add_events(HChar* buf, const HChar* events)
+{
+   Int len = VG_(strlen)(buf);
+   if (len > 0 && buf[len-1] != ' ')
+      VG_(strcat)(buf, " ");
+   VG_(strcat)(buf, events);
+}
+
+// The "events:" line, without the "events: ".
+static const HChar* events_line(void)
+{
+   static HChar buf[128];
+
+   if (clo_cache_sim && clo_branch_sim) {
+      VG_(strcpy)(buf, "Ir I1mr ILmr Dr D1mr DLmr Dw D1mw DLmw "
+                       "Bc Bcm Bi Bim");
+   }
+   else if (clo_cache_sim && !clo_branch_sim) {
+      VG_(strcpy)(buf, "Ir I1mr ILmr Dr D1mr DLmr Dw D1mw DLmw ");
+   }
+   else if (!clo_cache_sim && clo_branch_sim) {
+      VG_(strcpy)(buf, "Ir Bc Bcm Bi Bim");
+   }
+   else {
+      VG_(strcpy)(buf, "Ir");
+   }
+   if (clo_sim_cores > 1) {
+      add_events(buf, "D1inv D1mc D1mf");
+   }
+   if (clo_prefetch != 0) {
+      add_events(buf, "Pf Pfu");
+   }
+   if (clo_tlb_sim) {
+      add_events(buf, "DTLB1m DTLBm");
+   }
+   return buf;
+}
+
+//------------------------------------------------------------
+// Cachegrind's binary output format (--cachegrind-out-format=binary).
+// It holds the same information as the text format, in about half the
+// space, and is much quicker to read and merge.  After the 8-byte magic
+// "cgbin01\n" it is a sequence of records, each a tag byte, the length
+// of its payload as a BER number (as in Perl's pack "w": 7 bits per
+// byte, most significant first, the top bit set on all but the last
+// byte) and the payload:
+//
+//   'd' <text>         a "desc:" line (one or more)
+//   'c' <text>         the "cmd:" line
+//   'e' <text>         the "events:" line
+//   then any number of
+//   'f' <text>         a "fl=" line
+//   'n' <text>         a "fn=" line
+//   'l' <BER numbers>  a line number and its counts
+//   and finally
+//   's' <BER numbers>  the summary counts
+//
+// where <text> is what follows the "desc: ", "fl=", etc.
+
+#define CGBIN_MAGIC  "cgbin01\n"
+
+static Int   out_fd;
+static UChar out_buf[65536];
+static Int   out_used;
+
+static void out_flush(void)
+{
+   if (out_used > 0)
+      VG_(write)(out_fd, out_buf, out_used);
+   out_used = 0;
+}
+
+static void out_bytes(const void* p, Int n)
+{
+   if (out_used + n > sizeof(out_buf)) {
+      out_flush();
+      if (n > sizeof(out_buf)) {
+         VG_(write)(out_fd, p, n);
+         return;
+      }
+   }
+   VG_(memcpy)(&out_buf[out_used], p, n);
+   out_used += n;
+}
+
+// Encodes 'n' at 'buf', returning the number of bytes used (at most 10).
+static Int encode_BER(UChar* buf, ULong n)
+{
+   UChar tmp[10];
+   Int   i = 0, j;
+   do {
+      tmp[i++] = n & 0x7F;
+      n >>= 7;
+   } while (n > 0);
+   for (j = 0; j < i; j++)
+      buf[j] = tmp[i - 1 - j] | (j < i - 1 ? 0x80 : 0);
+   return i;
+}
+
+static void out_record(HChar tag, const void* payload, Int len)
+{
+   UChar hdr[11];
+   hdr[0] = tag;
+   out_bytes(hdr, 1 + encode_BER(&hdr[1], len));
+   out_bytes(payload, len);
+}
+
+static void out_string_record(HChar tag, const HChar* str)
+{
+   out_record(tag, str, VG_(strlen)(str));
+}
+
+// A record of numbers: 'line' if 'has_line', then the 'n' counts.
+static void out_counts_record(HChar tag, Bool has_line, ULong line,
+                              const ULong* c, Int n)
+{
+   UChar buf[(1 + MAX_EVENTS) * 10];
+   Int   i, len = 0;
+   if (has_line)
+      len += encode_BER(&buf[len], line);
+   for (i = 0; i < n; i++)
+      len += encode_BER(&buf[len], c[i]);
+   out_record(tag, buf, len);
+}
+
+static void out_header_records(void)
+{
+   HChar  desc[32 + sizeof(I1.desc_line)];
+   HChar* cmd;
+   SizeT  len = VG_(strlen)(VG_(args_the_exename)) + 1;
+   Int    i;
+
+   out_bytes(CGBIN_MAGIC, 8);
+   VG_(sprintf)(desc, "I1 cache:         %s", I1.desc_line);
+   out_string_record('d', desc);
+   VG_(sprintf)(desc, "D1 cache:         %s", D1.desc_line);
+   out_string_record('d', desc);
+   VG_(sprintf)(desc, "LL cache:         %s", LL.desc_line);
+   out_string_record('d', desc);
+
+   for (i = 0; i < VG_(sizeXA)( VG_(args_for_client) ); i++) {
+      HChar* arg = * (HChar**) VG_(indexXA)( VG_(args_for_client), i );
+      len += 1 + VG_(strlen)(arg);
+   }
+   cmd = VG_(malloc)("cg.out_header_records.1", len);
+   VG_(strcpy)(cmd, VG_(args_the_exename));
+   for (i = 0; i < VG_(sizeXA)( VG_(args_for_client) ); i++) {
+      HChar* arg = * (HChar**) VG_(indexXA)( VG_(args_for_client), i );
+      VG_(strcat)(cmd, " ");
+      VG_(strcat)(cmd, arg);
+   }
+   out_string_record('c', cmd);
+   VG_(free)(cmd);
+
+   out_string_record('e', events_line());
+}
 
 static void fprint_CC_table_and_calc_totals(void)
 {
-   Int     i;
-   VgFile  *fp;
+   Int     i, n;
+   VgFile  *fp = NULL;
    HChar   *currFile = NULL;
    const HChar *currFn = NULL;
    LineCC* lineCC;
+   ULong   counts[MAX_EVENTS];
 
    // Setup output filename.  Nb: it's important to do this now, ie. as late
    // as possible.  If we do it at start-up and the program forks and the
@@ -1388,9 +1658,18 @@ static void fprint_CC_table_and_calc_totals(void)
    HChar* cachegrind_out_file =
       VG_(expand_file_name)("--cachegrind-out-file", clo_cachegrind_out_file);
 
-   fp = VG_(fopen)(cachegrind_out_file, VKI_O_CREAT|VKI_O_TRUNC|VKI_O_WRONLY,
-                                        VKI_S_IRUSR|VKI_S_IWUSR);
-   if (fp == NULL) {
+   if (clo_binary_out) {
+      SysRes sres = VG_(open)(cachegrind_out_file,
+                              VKI_O_CREAT|VKI_O_TRUNC|VKI_O_WRONLY,
+                              VKI_S_IRUSR|VKI_S_IWUSR);
+      out_fd   = sr_isError(sres) ? -1 : sr_Res(sres);
+      out_used = 0;
+   } else {
+      fp = VG_(fopen)(cachegrind_out_file,
+                      VKI_O_CREAT|VKI_O_TRUNC|VKI_O_WRONLY,
+                      VKI_S_IRUSR|VKI_S_IWUSR);
+   }
+   if (clo_binary_out ? out_fd < 0 : fp == NULL) {
       // If the file can't be opened for whatever reason (conflict
       // between multiple cachegrinded processes?), give up now.
       VG_(umsg)("error: can't open cache simulation output file '%s'\n",
@@ -1402,33 +1681,24 @@ static void fprint_CC_table_and_calc_totals(void)
       VG_(free)(cachegrind_out_file);
    }
 
-   // "desc:" lines (giving I1/D1/LL cache configuration).  The spaces after
-   // the 2nd colon makes cg_annotate's output look nicer.
-   VG_(fprintf)(fp,  "desc: I1 cache:         %s\n"
-                     "desc: D1 cache:         %s\n"
-                     "desc: LL cache:         %s\n",
-                     I1.desc_line, D1.desc_line, LL.desc_line);
-
-   // "cmd:" line
-   VG_(fprintf)(fp, "cmd: %s", VG_(args_the_exename));
-   for (i = 0; i < VG_(sizeXA)( VG_(args_for_client) ); i++) {
-      HChar* arg = * (HChar**) VG_(indexXA)( VG_(args_for_client), i );
-      VG_(fprintf)(fp, " %s", arg);
-   }
-   // "events:" line
-   if (clo_cache_sim && clo_branch_sim) {
-      VG_(fprintf)(fp, "\nevents: Ir I1mr ILmr Dr D1mr DLmr Dw D1mw DLmw "
-                                  "Bc Bcm Bi Bim\n");
-   }
-   else if (clo_cache_sim && !clo_branch_sim) {
-      VG_(fprintf)(fp, "\nevents: Ir I1mr ILmr Dr D1mr DLmr Dw D1mw DLmw "
-                                  "\n");
-   }
-   else if (!clo_cache_sim && clo_branch_sim) {
-      VG_(fprintf)(fp, "\nevents: Ir Bc Bcm Bi Bim\n");
-   }
-   else {
-      VG_(fprintf)(fp, "\nevents: Ir\n");
+   if (clo_binary_out) {
+      out_header_records();
+   } else {
+      // "desc:" lines (giving I1/D1/LL cache configuration).  The spaces
+      // after the 2nd colon makes cg_annotate's output look nicer.
+      VG_(fprintf)(fp,  "desc: I1 cache:         %s\n"
+                        "desc: D1 cache:         %s\n"
+                        "desc: LL cache:         %s\n",
+                        I1.desc_line, D1.desc_line, LL.desc_line);
+
+      // "cmd:" line
+      VG_(fprintf)(fp, "cmd: %s", VG_(args_the_exename));
+      for (i = 0; i < VG_(sizeXA)( VG_(args_for_client) ); i++) {
+         HChar* arg = * (HChar**) VG_(indexXA)( VG_(args_for_client), i );
+         VG_(fprintf)(fp, " %s", arg);
+      }
+      // "events:" line
+      VG_(fprintf)(fp, "\nevents: %s\n", events_line());
    }
 
    // Traverse every lineCC
@@ -1442,7 +1712,10 @@ static void fprint_CC_table_and_calc_totals(void)
       // the whole strings would have to be checked.
       if ( lineCC->loc.file != currFile ) {
          currFile = lineCC->loc.file;
-         VG_(fprintf)(fp, "fl=%s\n", currFile);
+         if (clo_binary_out)
+            out_string_record('f', currFile);
+         else
+            VG_(fprintf)(fp, "fl=%s\n", currFile);
          distinct_files++;
          just_hit_a_new_file = True;
       }
@@ -1452,44 +1725,23 @@ static void fprint_CC_table_and_calc_totals(void)
       // in the old file, hence the just_hit_a_new_file test).
       if ( just_hit_a_new_file || lineCC->loc.fn != currFn ) {
          currFn = lineCC->loc.fn;
-         VG_(fprintf)(fp, "fn=%s\n", currFn);
+         if (clo_binary_out)
+            out_string_record('n', currFn);
+         else
+            VG_(fprintf)(fp, "fn=%s\n", currFn);
          distinct_fns++;
       }
 
       // Print the LineCC
-      if (clo_cache_sim && clo_branch_sim) {
-         VG_(fprintf)(fp,  "%d %llu %llu %llu"
-                             " %llu %llu %llu"
-                             " %llu %llu %llu"
-                             " %llu %llu %llu %llu\n",
-                            lineCC->loc.line,
-                            lineCC->Ir.a, lineCC->Ir.m1, lineCC->Ir.mL, 
-                            lineCC->Dr.a, lineCC->Dr.m1, lineCC->Dr.mL,
-                            lineCC->Dw.a, lineCC->Dw.m1, lineCC->Dw.mL,
-                            lineCC->Bc.b, lineCC->Bc.mp, 
-                            lineCC->Bi.b, lineCC->Bi.mp);
-      }
-      else if (clo_cache_sim && !clo_branch_sim) {
-         VG_(fprintf)(fp,  "%d %llu %llu %llu"
-                             " %llu %llu %llu"
-                             " %llu %llu %llu\n",
-                            lineCC->loc.line,
-                            lineCC->Ir.a, lineCC->Ir.m1, lineCC->Ir.mL, 
-                            lineCC->Dr.a, lineCC->Dr.m1, lineCC->Dr.mL,
-                            lineCC->Dw.a, lineCC->Dw.m1, lineCC->Dw.mL);
-      }
-      else if (!clo_cache_sim && clo_branch_sim) {
-         VG_(fprintf)(fp,  "%d %llu"
-                             " %llu %llu %llu %llu\n",
-                            lineCC->loc.line,
-                            lineCC->Ir.a, 
-                            lineCC->Bc.b, lineCC->Bc.mp, 
-                            lineCC->Bi.b, lineCC->Bi.mp);
-      }
-      else {
-         VG_(fprintf)(fp,  "%d %llu\n",
-                            lineCC->loc.line,
-                            lineCC->Ir.a);
+      n = get_counts(counts, &lineCC->Ir, &lineCC->Dr, &lineCC->Dw,
+                             &lineCC->Bc, &lineCC->Bi, &lineCC->Dx);
+      if (clo_binary_out) {
+         out_counts_record('l', True, lineCC->loc.line, counts, n);
+      } else {
+         VG_(fprintf)(fp, "%d", lineCC->loc.line);
+         for (i = 0; i < n; i++)
+            VG_(fprintf)(fp, " %llu", counts[i]);
+         VG_(fprintf)(fp, "\n");
       }
 
       // Update summary stats
@@ -1506,48 +1758,32 @@ static void fprint_CC_table_and_calc_totals(void)
       Bc_total.mp += lineCC->Bc.mp;
       Bi_total.b  += lineCC->Bi.b;
       Bi_total.mp += lineCC->Bi.mp;
+      Dx_total.inv += lineCC->Dx.inv;
+      Dx_total.mc  += lineCC->Dx.mc;
+      Dx_total.mf  += lineCC->Dx.mf;
+      Dx_total.pf  += lineCC->Dx.pf;
+      Dx_total.pfu += lineCC->Dx.pfu;
+      Dx_total.tlb1m += lineCC->Dx.tlb1m;
+      Dx_total.tlbm  += lineCC->Dx.tlbm;
 
       distinct_lines++;
    }
 
    // Summary stats must come after rest of table, since we calculate them
    // during traversal.  */
-   if (clo_cache_sim && clo_branch_sim) {
-      VG_(fprintf)(fp,  "summary:"
-                        " %llu %llu %llu"
-                        " %llu %llu %llu"
-                        " %llu %llu %llu"
-                        " %llu %llu %llu %llu\n", 
-                        Ir_total.a, Ir_total.m1, Ir_total.mL,
-                        Dr_total.a, Dr_total.m1, Dr_total.mL,
-                        Dw_total.a, Dw_total.m1, Dw_total.mL,
-                        Bc_total.b, Bc_total.mp, 
-                        Bi_total.b, Bi_total.mp);
-   }
-   else if (clo_cache_sim && !clo_branch_sim) {
-      VG_(fprintf)(fp,  "summary:"
-                        " %llu %llu %llu"
-                        " %llu %llu %llu"
-                        " %llu %llu %llu\n",
-                        Ir_total.a, Ir_total.m1, Ir_total.mL,
-                        Dr_total.a, Dr_total.m1, Dr_total.mL,
-                        Dw_total.a, Dw_total.m1, Dw_total.mL);
-   }
-   else if (!clo_cache_sim && clo_branch_sim) {
-      VG_(fprintf)(fp,  "summary:"
-                        " %llu"
-                        " %llu %llu %llu %llu\n", 
-                        Ir_total.a,
-                        Bc_total.b, Bc_total.mp, 
-                        Bi_total.b, Bi_total.mp);
-   }
-   else {
-      VG_(fprintf)(fp, "summary:"
-                        " %llu\n", 
-                        Ir_total.a);
+   n = get_counts(counts, &Ir_total, &Dr_total, &Dw_total,
+                          &Bc_total, &Bi_total, &Dx_total);
+   if (clo_binary_out) {
+      out_counts_record('s', False, 0, counts, n);
+      out_flush();
+      VG_(close)(out_fd);
+   } else {
+      VG_(fprintf)(fp, "summary:");
+      for (i = 0; i < n; i++)
+         VG_(fprintf)(fp, " %llu", counts[i]);
+      VG_(fprintf)(fp, "\n");
+      VG_(fclose)(fp);
    }
-
-   VG_(fclose)(fp);
 }
 
 static UInt ULong_width(ULong n)
@@ -1652,6 +1888,31 @@ static void cg_fini(Int exitcode)
                 l1, LL_total_m  * 100.0 / (Ir_total.a + D_total.a),
                 l2, LL_total_mr * 100.0 / (Ir_total.a + Dr_total.a),
                 l3, LL_total_mw * 100.0 / Dw_total.a);
+
+      /* Coherence results */
+      if (clo_sim_cores > 1) {
+         VG_(sprintf)(fmt, "%%s %%,%dllu\n", l1);
+         VG_(umsg)("\n");
+         VG_(umsg)(fmt, "D1  invals:   ", Dx_total.inv);
+         VG_(umsg)(fmt, "Coh misses:   ", Dx_total.mc);
+         VG_(umsg)(fmt, "False sharing:", Dx_total.mf);
+      }
+
+      /* Prefetch results */
+      if (clo_prefetch != 0) {
+         VG_(sprintf)(fmt, "%%s %%,%dllu\n", l1);
+         VG_(umsg)("\n");
+         VG_(umsg)(fmt, "Prefetches:   ", Dx_total.pf);
+         VG_(umsg)(fmt, "Useful pf:    ", Dx_total.pfu);
+      }
+
+      /* DTLB results */
+      if (clo_tlb_sim) {
+         VG_(sprintf)(fmt, "%%s %%,%dllu\n", l1);
+         VG_(umsg)("\n");
+         VG_(umsg)(fmt, "DTLB1 misses: ", Dx_total.tlb1m);
+         VG_(umsg)(fmt, "DTLB misses:  ", Dx_total.tlbm);
+      }
    }
 
    /* If branch profiling is enabled, show branch overall results. */
@@ -1748,8 +2009,22 @@ static Bool cg_process_cmd_line_option(const HChar* arg)
                               &clo_LL_cache)) {}
 
    else if VG_STR_CLO( arg, "--cachegrind-out-file", clo_cachegrind_out_file) {}
+   else if VG_XACT_CLO(arg, "--cachegrind-out-format=text",
+                            clo_binary_out, False) {}
+   else if VG_XACT_CLO(arg, "--cachegrind-out-format=binary",
+                            clo_binary_out, True) {}
    else if VG_BOOL_CLO(arg, "--cache-sim",  clo_cache_sim)  {}
    else if VG_BOOL_CLO(arg, "--branch-sim", clo_branch_sim) {}
+   else if VG_BINT_CLO(arg, "--sim-cores",  clo_sim_cores, 1, 64) {}
+   else if VG_XACT_CLO(arg, "--prefetch=none",   clo_prefetch, 0) {}
+   else if VG_XACT_CLO(arg, "--prefetch=stream", clo_prefetch, PF_STREAM) {}
+   else if VG_XACT_CLO(arg, "--prefetch=stride", clo_prefetch, PF_STRIDE) {}
+   else if VG_XACT_CLO(arg, "--prefetch=both",   clo_prefetch,
+                                                 PF_STREAM | PF_STRIDE) {}
+   else if VG_BINT_CLO(arg, "--prefetch-distance", clo_prefetch_distance,
+                                                   1, 16) {}
+   else if VG_BOOL_CLO(arg, "--tlb-sim",    clo_tlb_sim)    {}
+   else if VG_BOOL_CLO(arg, "--tlb-huge-pages", clo_tlb_huge_pages) {}
    else
       return False;
 
@@ -1762,7 +2037,16 @@ static void cg_print_usage(void)
    VG_(printf)(
 "    --cache-sim=yes|no               collect cache stats? [yes]\n"
 "    --branch-sim=yes|no              collect branch prediction stats? [no]\n"
+"    --sim-cores=<number>             simulate <number> cores with private\n"
+"                                     I1/D1 caches and a shared LL [1]\n"
+"    --prefetch=none|stream|stride|both  simulate D1 prefetchers [none]\n"
+"    --prefetch-distance=<number>     how many lines or strides ahead\n"
+"                                     to prefetch [2]\n"
+"    --tlb-sim=no|yes                 collect DTLB miss stats? [no]\n"
+"    --tlb-huge-pages=no|yes          use 2MB pages for anonymous memory\n"
+"                                     in the DTLB simulation? [no]\n"
 "    --cachegrind-out-file=<file>     output file name [cachegrind.out.%%p]\n"
+"    --cachegrind-out-format=text|binary  output file format [text]\n"
    );
 }
 
@@ -1779,6 +2063,12 @@ static void cg_print_debug_usage(void)
 
 static void cg_post_clo_init(void); /* just below */
 
+/* With --sim-cores=N, thread 'tid' runs on core (tid-1) % N. */
+static void cg_start_client_code(ThreadId tid, ULong blocks_dispatched)
+{
+   cachesim_switch_core((tid - 1) % clo_sim_cores);
+}
+
 static void cg_pre_clo_init(void)
 {
    VG_(details_name)            ("Cachegrind");
@@ -1849,6 +2139,21 @@ static void cg_post_clo_init(void)
    }
 
    cachesim_initcaches(I1c, D1c, LLc);
+
+   if (!clo_cache_sim) {
+      clo_sim_cores = 1;
+      clo_prefetch  = 0;
+      clo_tlb_sim   = False;
+   }
+   ext_sim = clo_sim_cores > 1 || clo_prefetch != 0 || clo_tlb_sim;
+   if (clo_tlb_sim)
+      cachesim_init_dtlb(clo_tlb_huge_pages);
+   if (clo_prefetch != 0)
+      cachesim_init_prefetch(clo_prefetch, clo_prefetch_distance);
+   if (clo_sim_cores > 1) {
+      cachesim_init_cores(clo_sim_cores);
+      VG_(track_start_client_code)(cg_start_client_code);
+   }
 }
 
 VG_DETERMINE_INTERFACE_VERSION(cg_pre_clo_init)
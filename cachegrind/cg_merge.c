@@ -11,11 +11,6 @@
   Copyright (C) 2002-2017 Nicholas Nethercote
      njn@valgrind.org
 
-  AVL tree code derived from
-  ANSI C Library for maintenance of AVL Balanced Trees
-  (C) 2000 Daniel Nagy, Budapest University of Technology and Economics
-  Released under GNU General Public License (GPL) version 2
-
   This program is free software; you can redistribute it and/or
   modify it under the terms of the GNU General Public License as
   published by the Free Software Foundation; either version 2 of the
@@ -39,6 +34,8 @@
 #include <assert.h>
 #include <string.h>
 #include <ctype.h>
+#include <stddef.h>
+#include <pthread.h>
 
 typedef  signed long   Word;
 typedef  unsigned long UWord;
@@ -48,84 +45,32 @@ typedef  unsigned char Bool;
 typedef  signed int    Int;
 typedef  unsigned int  UInt;
 typedef  unsigned long long int ULong;
+typedef  unsigned char UChar;
 typedef  signed char   Char;
 typedef  size_t        SizeT;
 
 
-//------------------------------------------------------------------//
-//---                           WordFM                           ---//
-//---                      Public interface                      ---//
-//------------------------------------------------------------------//
-
-typedef  struct _WordFM  WordFM; /* opaque */
-
-/* Initialise a WordFM */
-void initFM ( WordFM* t, 
-              void*   (*alloc_nofail)( SizeT ),
-              void    (*dealloc)(void*),
-              Word    (*kCmp)(Word,Word) );
-
-/* Allocate and initialise a WordFM */
-WordFM* newFM( void* (*alloc_nofail)( SizeT ),
-               void  (*dealloc)(void*),
-               Word  (*kCmp)(Word,Word) );
-
-/* Free up the FM.  If kFin is non-NULL, it is applied to keys
-   before the FM is deleted; ditto with vFin for vals. */
-void deleteFM ( WordFM*, void(*kFin)(Word), void(*vFin)(Word) );
-
-/* Add (k,v) to fm.  If a binding for k already exists, it is updated
-   to map to this new v.  In that case we should really return the
-   previous v so that caller can finalise it.  Oh well. */
-void addToFM ( WordFM* fm, Word k, Word v );
-
-// Delete key from fm, returning associated val if found
-Bool delFromFM ( WordFM* fm, /*OUT*/Word* oldV, Word key );
-
-// Look up in fm, assigning found val at spec'd address
-Bool lookupFM ( WordFM* fm, /*OUT*/Word* valP, Word key );
-
-Word sizeFM ( WordFM* fm );
-
-// set up FM for iteration
-void initIterFM ( WordFM* fm );
-
-// get next key/val pair.  Will assert if fm has been modified
-// or looked up in since initIterFM was called.
-Bool nextIterFM ( WordFM* fm, /*OUT*/Word* pKey, /*OUT*/Word* pVal );
-
-// clear the I'm iterating flag
-void doneIterFM ( WordFM* fm );
-
-// Deep copy a FM.  If dopyK is NULL, keys are copied verbatim.
-// If non-null, dopyK is applied to each key to generate the
-// version in the new copy.  In that case, if the argument to dopyK
-// is non-NULL but the result is NULL, it is assumed that dopyK
-// could not allocate memory, in which case the copy is abandoned
-// and NULL is returned.  Ditto with dopyV for values.
-WordFM* dopyFM ( WordFM* fm, Word(*dopyK)(Word), Word(*dopyV)(Word) );
-
-//------------------------------------------------------------------//
-//---                         end WordFM                         ---//
-//---                      Public interface                      ---//
-//------------------------------------------------------------------//
-
-
 static const char* argv0 = "cg_merge";
 
 /* Keep track of source filename/line no so as to be able to
-   print decent error messages. */
+   print decent error messages.  For a binary file, 'lno' counts
+   records rather than lines. */
 typedef
    struct {
-      FILE* fp;
-      UInt  lno;
-      char* filename;
+      FILE*  fp;
+      UInt   lno;
+      const char* filename;
+      Bool   binary;
+      // The buffer for the line or record most recently read.
+      char*  line;
+      size_t linesiz;
    }
    SOURCE;
 
 static void printSrcLoc ( SOURCE* s )
 {
-   fprintf(stderr, "%s: near %s line %u\n", argv0, s->filename, s->lno-1);
+   fprintf(stderr, "%s: near %s %s %u\n", argv0, s->filename,
+                   s->binary ? "record" : "line", s->lno-1);
 }
 
 __attribute__((noreturn))
@@ -152,43 +97,37 @@ static void barf ( SOURCE* s, const char* msg )
    exit(1);
 }
 
+// Make sure s->line can hold 'size' bytes.
+static void growLine ( SOURCE* s, size_t size )
+{
+   if (size > s->linesiz) {
+      s->linesiz = size + 500;
+      s->line = realloc(s->line, s->linesiz * sizeof *s->line);
+      if (s->line == NULL)
+         mallocFail(s, "growLine");
+   }
+}
+
 // Read a line. Return the line read, or NULL if at EOF.
-// The line is allocated dynamically but will be overwritten with
+// The line is in s->line and will be overwritten with
 // every invocation. Caller must not free it.
 static const char *readline ( SOURCE* s )
 {
-   static char  *line = NULL;
-   static size_t linesiz = 0;
+   ssize_t n = getline(&s->line, &s->linesiz, s->fp);
 
-   int ch, i = 0;
-
-   while (1) {
-      ch = getc(s->fp);
-      if (ch != EOF) {
-          if (i + 1 >= linesiz) {
-             linesiz += 500;
-             line = realloc(line, linesiz * sizeof *line);
-             if (line == NULL)
-                mallocFail(s, "readline:");
-          }
-          line[i++] = ch;
-          line[i] = 0;
-          if (ch == '\n') {
-             line[i-1] = 0;
-             s->lno++;
-             break;
-          }
-      } else {
-         if (ferror(s->fp)) {
-            perror(argv0);
-            barf(s, "I/O error while reading input file");
-         } else {
-            // hit EOF
-            break;
-         }
+   if (n <= 0) {
+      if (ferror(s->fp)) {
+         perror(argv0);
+         barf(s, "I/O error while reading input file");
       }
+      // hit EOF
+      return NULL;
+   }
+   if (s->line[n-1] == '\n') {
+      s->line[n-1] = 0;
+      s->lno++;
    }
-   return i == 0 ? NULL : line;
+   return s->line;
 }
 
 static Bool streqn ( const char* s1, const char* s2, size_t n )
@@ -203,260 +142,356 @@ static Bool streq ( const char* s1, const char* s2 )
 
 
 ////////////////////////////////////////////////////////////////
+// The binary format.  See "Cachegrind's binary output format" in
+// cg_main.c.
+
+#define CGBIN_MAGIC      "cgbin01\n"
+#define CGBIN_MAGIC_LEN  8
+
+// The longest a number can be: 64 bits, 7 at a time.
+#define MAX_BER_LEN  10
+
+// Encode 'n' at 'buf', returning the number of bytes used.
+static UInt encode_BER ( UChar* buf, ULong n )
+{
+   UChar tmp[MAX_BER_LEN];
+   UInt  i = 0, j;
+   do {
+      tmp[i++] = n & 0x7F;
+      n >>= 7;
+   } while (n > 0);
+   for (j = 0; j < i; j++)
+      buf[j] = tmp[i - 1 - j] | (j < i - 1 ? 0x80 : 0);
+   return i;
+}
+
+// Decode a number at *pptr, which must be before 'end'.
+static Bool decode_BER ( /*OUT*/ULong* res,
+                         /*INOUT*/const UChar** pptr, const UChar* end )
+{
+   const UChar* ptr = *pptr;
+   ULong n = 0;
+   Int   i;
+   for (i = 0; i < MAX_BER_LEN && ptr < end; i++) {
+      n = (n << 7) | (*ptr & 0x7F);
+      if (!(*ptr++ & 0x80)) {
+         *res  = n;
+         *pptr = ptr;
+         return True;
+      }
+   }
+   return False;
+}
+
+// Read a record.  Return its tag, or EOF if at EOF, and its payload
+// in s->line (NUL-terminated, to make string payloads easier to use)
+// with its length in *len.
+static int readrecord ( SOURCE* s, /*OUT*/size_t* len )
+{
+   int   tag, ch, i;
+   ULong n = 0;
+
+   tag = getc_unlocked(s->fp);
+   if (tag == EOF) {
+      if (ferror(s->fp)) {
+         perror(argv0);
+         barf(s, "I/O error while reading input file");
+      }
+      return EOF;
+   }
+   for (i = 0; i < MAX_BER_LEN; i++) {
+      ch = getc_unlocked(s->fp);
+      if (ch == EOF)
+         parseError(s, "truncated record");
+      n = (n << 7) | (ch & 0x7F);
+      if (!(ch & 0x80))
+         break;
+   }
+   if (i == MAX_BER_LEN)
+      parseError(s, "bad record length");
+   growLine(s, n + 1);
+   if (fread(s->line, 1, n, s->fp) != n)
+      parseError(s, "truncated record");
+   s->line[n] = 0;
+   s->lno++;
+   *len = n;
+   return tag;
+}
+
+static void writerecord ( FILE* f, UChar tag, const void* payload,
+                          size_t len )
+{
+   UChar hdr[1 + MAX_BER_LEN];
+   UInt  hdr_len;
+   hdr[0]  = tag;
+   hdr_len = 1 + encode_BER(&hdr[1], len);
+   fwrite(hdr, 1, hdr_len, f);
+   fwrite(payload, 1, len, f);
+}
+
+// Write a record of numbers: 'first' if 'has_first', then 'counts'.
+static void writecountsrecord ( FILE* f, UChar tag,
+                                Bool has_first, ULong first,
+                                const ULong* counts, Int n_counts )
+{
+   UChar buf[(1 + n_counts) * MAX_BER_LEN];
+   UInt  len = 0;
+   Int   i;
+   if (has_first)
+      len += encode_BER(&buf[len], first);
+   for (i = 0; i < n_counts; i++)
+      len += encode_BER(&buf[len], counts[i]);
+   writerecord(f, tag, buf, len);
+}
+
+
+////////////////////////////////////////////////////////////////
+// Profiles.  The counts of all the input files merged into a
+// profile are kept in a hash table, keyed by file name, function
+// name and line number; the names are interned in a second hash
+// table, so the key's names can be compared by address.  The files
+// are merged into the profile as they're read, so a file's own
+// counts never need to be held in memory.
 
 typedef
-   struct {
-      char* fi_name;
-      char* fn_name;
+   struct _Str {
+      struct _Str* next;
+      UWord        hash;
+      UWord        rank;   // position in sort order, for output
+      char         s[0];
    }
-   FileFn;
+   Str;
 
 typedef
-   struct {
-      Int n_counts;
-      ULong* counts;
+   struct _Entry {
+      struct _Entry* next;
+      const char*    fi_name;    // interned
+      const char*    fn_name;    // interned
+      UWord          lnno;
+      ULong          counts[0];  // [n_events]
    }
-   Counts;
+   Entry;
 
 typedef
    struct {
-      // null-terminated vector of desc_lines
+      // null-terminated vector of desc_lines, from the first file
       char** desc_lines;
 
-      // Cmd line
+      // Cmd line, from the first file
       char* cmd_line;
 
       // Events line
       char* events_line;
       Int   n_events;
 
-      // Summary line (copied from input)
-      char* summary_line;
+      // Summary counts
+      ULong* summary;
 
-      /* Outermost map is
-            WordFM FileFn* innerMap
-         where innerMap is   WordFM line-number=UWord Counts */
-      WordFM* outerMap;
+      // Interned file and function names
+      Str** strs;
+      UWord n_strs;
+      UWord strs_size;     // a power of 2
 
-      // Summary counts (computed whilst parsing)
-      // should match .summary_line
-      Counts* summary;
+      // (file, fn, line) -> counts
+      Entry** entries;
+      UWord   n_entries;
+      UWord   entries_size; // a power of 2
    }
-   CacheProfFile;
-
-static FileFn* new_FileFn ( char* file_name, char* fn_name )
-{
-   FileFn* ffn = malloc(sizeof(FileFn));
-   if (ffn == NULL)
-      return NULL;
-   ffn->fi_name = file_name;
-   ffn->fn_name = fn_name;
-   return ffn;
-}
+   Profile;
 
-static void ddel_FileFn ( FileFn* ffn )
+static UWord hash_string ( const char* s )
 {
-   if (ffn->fi_name)
-      free(ffn->fi_name);
-   if (ffn->fn_name)
-      free(ffn->fn_name);
-   memset(ffn, 0, sizeof(FileFn));
-   free(ffn);
+   UWord h = 2166136261UL;
+   for (; *s; s++)
+      h = (h ^ (UChar)*s) * 16777619UL;
+   return h;
 }
 
-static FileFn* dopy_FileFn ( FileFn* ff )
+static UWord hash_key ( const char* fi, const char* fn, UWord lnno )
 {
-   char *fi2, *fn2;
-   fi2 = strdup(ff->fi_name);
-   if (fi2 == NULL) return NULL;
-   fn2 = strdup(ff->fn_name);
-   if (fn2 == NULL) {
-      free(fi2);
-      return NULL;
-   }
-   return new_FileFn( fi2, fn2 );
+   UWord h = (UWord)fi * 0x9E3779B1UL;
+   h ^= (UWord)fn * 0x85EBCA77UL + (h >> 13);
+   h ^= lnno * 0xC2B2AE3DUL + (h >> 11);
+   return h ^ (h >> 17);
 }
 
-static Counts* new_Counts ( Int n_counts, /*COPIED*/ULong* counts )
+static void init_Profile ( Profile* prof )
 {
-   Int i;
-   Counts* cts = malloc(sizeof(Counts));
-   if (cts == NULL)
-      return NULL;
-
-   assert(n_counts >= 0);
-   cts->counts = malloc(n_counts * sizeof(ULong));
-   if (cts->counts == NULL) {
-      free(cts);
-      return NULL;
-   }
-
-   cts->n_counts = n_counts;
-   for (i = 0; i < n_counts; i++)
-      cts->counts[i] = counts[i];
-
-   return cts;
+   memset(prof, 0, sizeof(Profile));
 }
 
-static Counts* new_Counts_Zeroed ( Int n_counts )
+// Double the size of a hash table whose chains are linked through
+// their first word, 'hash_of' giving each element's hash.
+static void** grow_table ( SOURCE* s, void** table, UWord* size,
+                           UWord (*hash_of)(void*) )
 {
-   Int i;
-   Counts* cts = malloc(sizeof(Counts));
-   if (cts == NULL)
-      return NULL;
-
-   assert(n_counts >= 0);
-   cts->counts = malloc(n_counts * sizeof(ULong));
-   if (cts->counts == NULL) {
-      free(cts);
-      return NULL;
+   UWord  new_size = *size ? 2 * *size : 1024;
+   void** new_table = calloc(new_size, sizeof(void*));
+   UWord  i;
+   if (new_table == NULL)
+      mallocFail(s, "grow_table");
+   for (i = 0; i < *size; i++) {
+      void* e = table[i];
+      while (e) {
+         void*  next = *(void**)e;
+         UWord  j    = hash_of(e) & (new_size - 1);
+         *(void**)e   = new_table[j];
+         new_table[j] = e;
+         e = next;
+      }
    }
-
-   cts->n_counts = n_counts;
-   for (i = 0; i < n_counts; i++)
-      cts->counts[i] = 0;
-
-   return cts;
+   free(table);
+   *size = new_size;
+   return new_table;
 }
 
-static void sdel_Counts ( Counts* cts )
+static UWord hash_of_Str ( void* v )
 {
-   memset(cts, 0, sizeof(Counts));
-   free(cts);
+   return ((Str*)v)->hash;
 }
 
-static void ddel_Counts ( Counts* cts )
+static UWord hash_of_Entry ( void* v )
 {
-   if (cts->counts)
-      free(cts->counts);
-   memset(cts, 0, sizeof(Counts));
-   free(cts);
+   Entry* e = v;
+   return hash_key(e->fi_name, e->fn_name, e->lnno);
 }
 
-static Counts* dopy_Counts ( Counts* cts )
+static const char* intern ( SOURCE* s, Profile* prof, const char* name )
 {
-   return new_Counts( cts->n_counts, cts->counts );
-}
+   UWord hash = hash_string(name);
+   Str*  str;
+
+   if (prof->strs_size > 0) {
+      for (str = prof->strs[hash & (prof->strs_size - 1)];
+           str; str = str->next) {
+         if (str->hash == hash && streq(str->s, name))
+            return str->s;
+      }
+   }
 
-static
-CacheProfFile* new_CacheProfFile ( char**  desc_lines,
-                                   char*   cmd_line,
-                                   char*   events_line,
-                                   Int     n_events,
-                                   char*   summary_line,
-                                   WordFM* outerMap,
-                                   Counts* summary )
-{
-   CacheProfFile* cpf = malloc(sizeof(CacheProfFile));
-   if (cpf == NULL)
-      return NULL;
-   cpf->desc_lines   = desc_lines;
-   cpf->cmd_line     = cmd_line;
-   cpf->events_line  = events_line;
-   cpf->n_events     = n_events;
-   cpf->summary_line = summary_line;
-   cpf->outerMap     = outerMap;
-   cpf->summary      = summary;
-   return cpf;
+   if (prof->n_strs >= prof->strs_size)
+      prof->strs = (Str**)grow_table(s, (void**)prof->strs,
+                                     &prof->strs_size, hash_of_Str);
+   str = malloc(sizeof(Str) + strlen(name) + 1);
+   if (str == NULL)
+      mallocFail(s, "intern");
+   str->hash = hash;
+   strcpy(str->s, name);
+   str->next = prof->strs[hash & (prof->strs_size - 1)];
+   prof->strs[hash & (prof->strs_size - 1)] = str;
+   prof->n_strs++;
+   return str->s;
 }
 
-static WordFM* dopy_InnerMap ( WordFM* innerMap )
+// Add 'counts' to the entry for (fi, fn, lnno), whose names must
+// have been interned in 'prof'.
+static void add_counts ( SOURCE* s, Profile* prof,
+                         const char* fi, const char* fn, UWord lnno,
+                         const ULong* counts )
 {
-   return dopyFM ( innerMap, NULL,
-                             (Word(*)(Word))dopy_Counts );
-}
+   UWord  hash = hash_key(fi, fn, lnno);
+   Entry* e;
+   Int    i;
+
+   if (prof->entries_size > 0) {
+      for (e = prof->entries[hash & (prof->entries_size - 1)];
+           e; e = e->next) {
+         if (e->lnno == lnno && e->fi_name == fi && e->fn_name == fn) {
+            for (i = 0; i < prof->n_events; i++)
+               e->counts[i] += counts[i];
+            return;
+         }
+      }
+   }
 
-static void ddel_InnerMap ( WordFM* innerMap )
-{
-   deleteFM( innerMap, NULL, (void(*)(Word))ddel_Counts );
+   if (prof->n_entries >= prof->entries_size)
+      prof->entries = (Entry**)grow_table(s, (void**)prof->entries,
+                                          &prof->entries_size,
+                                          hash_of_Entry);
+   e = malloc(sizeof(Entry) + prof->n_events * sizeof(ULong));
+   if (e == NULL)
+      mallocFail(s, "add_counts");
+   e->fi_name = fi;
+   e->fn_name = fn;
+   e->lnno    = lnno;
+   memcpy(e->counts, counts, prof->n_events * sizeof(ULong));
+   e->next = prof->entries[hash & (prof->entries_size - 1)];
+   prof->entries[hash & (prof->entries_size - 1)] = e;
+   prof->n_entries++;
 }
 
-static void ddel_CacheProfFile ( CacheProfFile* cpf )
+static void ddel_Profile ( Profile* prof )
 {
    char** p;
-   if (cpf->desc_lines) {
-      for (p = cpf->desc_lines; *p; p++)
+   UWord  i;
+   if (prof->desc_lines) {
+      for (p = prof->desc_lines; *p; p++)
          free(*p);
-      free(cpf->desc_lines);
+      free(prof->desc_lines);
    }
-   if (cpf->cmd_line)
-      free(cpf->cmd_line);
-   if (cpf->events_line)
-      free(cpf->events_line);
-   if (cpf->summary_line)
-      free(cpf->summary_line);
-   if (cpf->outerMap)
-      deleteFM( cpf->outerMap, (void(*)(Word))ddel_FileFn, 
-                               (void(*)(Word))ddel_InnerMap );
-   if (cpf->summary)
-      ddel_Counts(cpf->summary);
-
-   memset(cpf, 0, sizeof(CacheProfFile));
-   free(cpf);
-}
-
-static void showCounts ( FILE* f, Counts* c )
-{
-   Int i;
-   for (i = 0; i < c->n_counts; i++) {
-      fprintf(f, "%lld ", c->counts[i]);
+   free(prof->cmd_line);
+   free(prof->events_line);
+   free(prof->summary);
+   for (i = 0; i < prof->strs_size; i++) {
+      Str* str = prof->strs[i];
+      while (str) {
+         Str* next = str->next;
+         free(str);
+         str = next;
+      }
+   }
+   free(prof->strs);
+   for (i = 0; i < prof->entries_size; i++) {
+      Entry* e = prof->entries[i];
+      while (e) {
+         Entry* next = e->next;
+         free(e);
+         e = next;
+      }
    }
+   free(prof->entries);
+   memset(prof, 0, sizeof(Profile));
 }
 
-static void show_CacheProfFile ( FILE* f, CacheProfFile* cpf )
+// Called with the header of each file merged into 'prof', the first
+// one of which it keeps.  'desc_lines' is consumed.
+static void set_header ( SOURCE* s, Profile* prof,
+                         char** desc_lines, const char* cmd_line,
+                         const char* events_line )
 {
-   Int     i;
-   char**  d;
-   FileFn* topKey;
-   WordFM* topVal;
-   UWord   subKey;
-   Counts* subVal;  
-
-   for (d = cpf->desc_lines; *d; d++)
-      fprintf(f, "%s\n", *d);
-   fprintf(f, "%s\n", cpf->cmd_line);
-   fprintf(f, "%s\n", cpf->events_line);
-
-   initIterFM( cpf->outerMap );
-   while (nextIterFM( cpf->outerMap, (Word*)(&topKey), (Word*)(&topVal) )) {
-      fprintf(f, "fl=%s\nfn=%s\n", 
-                 topKey->fi_name, topKey->fn_name );
-      initIterFM( topVal );
-      while (nextIterFM( topVal, (Word*)(&subKey), (Word*)(&subVal) )) {
-         fprintf(f, "%ld   ", subKey );
-         showCounts( f, subVal );
-         fprintf(f, "\n");
-      }
-      doneIterFM( topVal );
+   const char* p;
+   char** d;
+
+   if (prof->events_line) {
+      // First check mundane things: that the events: lines are
+      // identical.
+      if (!streq( prof->events_line, events_line ))
+        barf(s, "\"events:\" line of most recent file does "
+                "not match those previously processed");
+      for (d = desc_lines; *d; d++)
+         free(*d);
+      free(desc_lines);
+      return;
    }
-   doneIterFM( cpf->outerMap );
 
-   //fprintf(f, "%s\n", cpf->summary_line);
-   fprintf(f, "summary:");
-   for (i = 0; i < cpf->summary->n_counts; i++)
-      fprintf(f, " %lld", cpf->summary->counts[i]);
-   fprintf(f, "\n");
-}
+   prof->desc_lines  = desc_lines;
+   prof->cmd_line    = strdup(cmd_line);
+   prof->events_line = strdup(events_line);
+   if (prof->cmd_line == NULL || prof->events_line == NULL)
+      mallocFail(s, "set_header");
 
-////////////////////////////////////////////////////////////////
-
-static Word cmp_FileFn ( Word s1, Word s2 )
-{
-   FileFn* ff1 = (FileFn*)s1;
-   FileFn* ff2 = (FileFn*)s2;
-   Word r = strcmp(ff1->fi_name, ff2->fi_name);
-   if (r == 0)
-      r = strcmp(ff1->fn_name, ff2->fn_name);
-   return r;
-}
+   // figure out how many events there are by counting the number
+   // of space-alphanum transitions in the events_line
+   prof->n_events = 0;
+   assert(prof->events_line[6] == ':');
+   for (p = &prof->events_line[6]; *p; p++) {
+      if (p[0] == ' ' && isalpha(p[1]))
+         prof->n_events++;
+   }
 
-static Word cmp_unboxed_UWord ( Word s1, Word s2 )
-{
-   UWord u1 = (UWord)s1;
-   UWord u2 = (UWord)s2;
-   if (u1 < u2) return -1;
-   if (u1 > u2) return 1;
-   return 0;
+   prof->summary = calloc(prof->n_events, sizeof(ULong));
+   if (prof->summary == NULL)
+      mallocFail(s, "set_header");
 }
 
 ////////////////////////////////////////////////////////////////
@@ -480,217 +515,125 @@ static Bool parse_ULong ( /*OUT*/ULong* res, /*INOUT*/const char** pptr)
    return True;
 }
 
-// str is a line of integers, starting with a line number.  Parse it,
-// returning the first number in *lnno and the rest in a newly
-// allocated Counts struct.  If lnno is non-NULL, treat the first
-// number as a line number and assign it to *lnno instead of
-// incorporating it in the counts array.
-static 
-Counts* splitUpCountsLine ( SOURCE* s, /*OUT*/UWord* lnno, const char* str )
+// str is a line of integers.  Parse exactly 'n' of them into 'res'.
+static void splitUpCountsLine ( SOURCE* s, /*OUT*/ULong* res, Int n,
+                                const char* str )
 {
-   Bool    ok;
-   Counts* counts;
-   ULong   *tmpC = NULL;
-   UInt     n_tmpC = 0, tmpCsize = 0;
-   while (1) {
-      if (n_tmpC >= tmpCsize) {
-         tmpCsize += 50;
-         tmpC = realloc(tmpC, tmpCsize * sizeof *tmpC);
-         if (tmpC == NULL)
-            mallocFail(s, "splitUpCountsLine:");
+   Int i;
+   for (i = 0; i < n; i++) {
+      if (!parse_ULong( &res[i], &str )) {
+         if (*str != 0)
+            parseError(s, "garbage in counts line");
+         parseError(s, "# counts doesn't match # events");
       }
-      ok = parse_ULong( &tmpC[n_tmpC], &str );
-      if (!ok)
-         break;
-      n_tmpC++;
    }
+   while (isspace(*str)) str++;
+   if (isdigit(*str))
+      parseError(s, "# counts doesn't match # events");
    if (*str != 0)
       parseError(s, "garbage in counts line");
-   if (lnno ? (n_tmpC < 2) : (n_tmpC < 1))
-      parseError(s, "too few counts in count line");
-
-   if (lnno) {
-      *lnno = (UWord)tmpC[0];
-      counts = new_Counts( n_tmpC-1, /*COPIED*/&tmpC[1] );
-   } else {
-      counts = new_Counts( n_tmpC, /*COPIED*/&tmpC[0] );
-   }
-   free(tmpC);
-
-   return counts;
 }
 
-static void addCounts ( SOURCE* s, /*OUT*/Counts* counts1, Counts* counts2 )
+// The binary equivalent: 'len' bytes at 'p' must be exactly 'n'
+// numbers.
+static void splitUpCountsRecord ( SOURCE* s, /*OUT*/ULong* res, Int n,
+                                  const char* p, size_t len )
 {
+   const UChar* ptr = (const UChar*)p;
+   const UChar* end = ptr + len;
    Int i;
-   if (counts1->n_counts != counts2->n_counts)
-      parseError(s, "addCounts: inconsistent number of counts");
-   for (i = 0; i < counts1->n_counts; i++)
-      counts1->counts[i] += counts2->counts[i];
+   for (i = 0; i < n; i++) {
+      if (!decode_BER( &res[i], &ptr, end ))
+         parseError(s, "# counts doesn't match # events");
+   }
+   if (ptr != end)
+      parseError(s, "# counts doesn't match # events");
 }
 
-static Bool addCountsToMap ( SOURCE* s,
-                             WordFM* counts_map, 
-                             UWord lnno, Counts* newCounts )
+static void check_summary ( SOURCE* s, Profile* prof,
+                            const ULong* computed, const ULong* stated )
 {
-   Counts* oldCounts;
-   // look up lnno in the map.  If none present, add a binding
-   // lnno->counts.  If present, add counts to the existing entry.
-   if (lookupFM( counts_map, (Word*)(&oldCounts), (Word)lnno )) {
-      // merge with existing binding
-      addCounts( s, oldCounts, newCounts );
-      return True;
-   } else {
-      // create new binding
-      addToFM( counts_map, (Word)lnno, (Word)newCounts );
-      return False;
+   Int i;
+   for (i = 0; i < prof->n_events; i++) {
+      if (computed[i] != stated[i]) {
+         parseError(s, "parse_CacheProfFile: "
+                       "computed vs stated SUMMARY counts mismatch");
+      }
+      prof->summary[i] += computed[i];
    }
 }
 
-static
-void handle_counts ( SOURCE* s,
-                     CacheProfFile* cpf, 
-                     const char* fi, const char* fn, const char* newCountsStr )
+// Add a line to a growing NULL-terminated vector.
+static char** add_desc_line ( SOURCE* s, char** desc_lines, Int* n,
+                              const char* line )
 {
-   WordFM* countsMap;
-   Bool    freeNewCounts;
-   UWord   lnno;
-   Counts* newCounts;
-   FileFn* topKey; 
-
-   if (0)  printf("%s %s %s\n", fi, fn, newCountsStr );
-
-   // parse the numbers
-   newCounts = splitUpCountsLine( s, &lnno, newCountsStr );
-
-   // Did we get the right number?
-   if (newCounts->n_counts != cpf->n_events)
-      goto oom;
-
-   // allocate the key
-   topKey = malloc(sizeof(FileFn));
-   if (topKey) {
-      topKey->fi_name = strdup(fi);
-      topKey->fn_name = strdup(fn);
-   }
-   if (! (topKey && topKey->fi_name && topKey->fn_name))
-      mallocFail(s, "handle_counts:");
-
-   // search for it
-   if (lookupFM( cpf->outerMap, (Word*)(&countsMap), (Word)topKey )) {
-      // found it.  Merge in new counts
-      freeNewCounts = addCountsToMap( s, countsMap, lnno, newCounts );
-      ddel_FileFn(topKey);
-   } else {
-      // not found in the top map.  Create new entry
-      countsMap = newFM( malloc, free, cmp_unboxed_UWord );
-      if (!countsMap)
-         goto oom;
-      addToFM( cpf->outerMap, (Word)topKey, (Word)countsMap );
-      freeNewCounts = addCountsToMap( s, countsMap, lnno, newCounts );
-   }
-
-   // also add to running summary total
-   addCounts( s, cpf->summary, newCounts );
-
-   // if safe to do so, free up the count vector
-   if (freeNewCounts)
-      ddel_Counts(newCounts);
-
-   return;
-
-  oom:
-   parseError(s, "# counts doesn't match # events");
+   desc_lines = realloc(desc_lines, (*n + 2) * sizeof(char*));
+   if (desc_lines == NULL)
+      mallocFail(s, "add_desc_line");
+   desc_lines[*n] = strdup(line);
+   if (desc_lines[*n] == NULL)
+      mallocFail(s, "add_desc_line");
+   desc_lines[++*n] = NULL;
+   return desc_lines;
 }
 
-
-/* Parse a complete file from the stream in 's'.  If a parse error
-   happens, do not return; instead exit via parseError().  If an
-   out-of-memory condition happens, do not return; instead exit via
-   mallocError().
+/* Parse a complete text file from the stream in 's', merging it into
+   'prof'.  If a parse error happens, do not return; instead exit via
+   parseError().  If an out-of-memory condition happens, do not
+   return; instead exit via mallocError().
 */
-static CacheProfFile* parse_CacheProfFile ( SOURCE* s )
+static void parse_CacheProfFile ( SOURCE* s, Profile* prof )
 {
-   Int            i;
-   char**         tmp_desclines = NULL;
-   unsigned       tmp_desclines_size = 0;
-   char*          p;
-   int            n_tmp_desclines = 0;
-   CacheProfFile* cpf;
-   Counts*        summaryRead; 
-   char*          curr_fn = strdup("???");
-   char*          curr_fl = strdup("???");
-   const char*    line;
-
-   cpf = new_CacheProfFile( NULL, NULL, NULL, 0, NULL, NULL, NULL );
-   if (cpf == NULL)
-      mallocFail(s, "parse_CacheProfFile(1)");
+   char**      desc_lines = NULL;
+   Int         n_desc_lines = 0;
+   char*       cmd_line;
+   const char* curr_fn;
+   const char* curr_fl;
+   const char* line;
+   ULong*      counts;
+   ULong*      summary;
+   ULong       lnno;
 
    // Parse "desc:" lines
    while (1) {
       line = readline(s);
-      if (!line) 
+      if (!line)
          break;
       if (!streqn(line, "desc: ", 6))
          break;
-      if (n_tmp_desclines >= tmp_desclines_size) {
-         tmp_desclines_size += 100;
-         tmp_desclines = realloc(tmp_desclines,
-                                 tmp_desclines_size * sizeof *tmp_desclines);
-         if (tmp_desclines == NULL)
-            mallocFail(s, "parse_CacheProfFile(1)");
-      }
-      tmp_desclines[n_tmp_desclines++] = strdup(line);
+      desc_lines = add_desc_line(s, desc_lines, &n_desc_lines, line);
    }
 
-   if (n_tmp_desclines == 0)
+   if (n_desc_lines == 0)
       parseError(s, "parse_CacheProfFile: no DESC lines present");
 
-   cpf->desc_lines = malloc( (1+n_tmp_desclines) * sizeof(char*) );
-   if (cpf->desc_lines == NULL)
-      mallocFail(s, "parse_CacheProfFile(2)");
-
-   cpf->desc_lines[n_tmp_desclines] = NULL;
-   for (i = 0; i < n_tmp_desclines; i++)
-      cpf->desc_lines[i] = tmp_desclines[i];
-
    // Parse "cmd:" line
+   if (!line)
+      parseError(s, "parse_CacheProfFile: eof before CMD line");
    if (!streqn(line, "cmd: ", 5))
       parseError(s, "parse_CacheProfFile: no CMD line present");
 
-   cpf->cmd_line = strdup(line);
-   if (cpf->cmd_line == NULL)
+   cmd_line = strdup(line);
+   if (cmd_line == NULL)
       mallocFail(s, "parse_CacheProfFile(3)");
 
-   // Parse "events:" line and figure out how many events there are
+   // Parse "events:" line
    line = readline(s);
    if (!line)
       parseError(s, "parse_CacheProfFile: eof before EVENTS line");
    if (!streqn(line, "events: ", 8))
       parseError(s, "parse_CacheProfFile: no EVENTS line present");
 
-   // figure out how many events there are by counting the number
-   // of space-alphanum transitions in the events_line
-   cpf->events_line = strdup(line);
-   if (cpf->events_line == NULL)
-      mallocFail(s, "parse_CacheProfFile(3)");
-
-   cpf->n_events = 0;
-   assert(cpf->events_line[6] == ':');
-   for (p = &cpf->events_line[6]; *p; p++) {
-      if (p[0] == ' ' && isalpha(p[1]))
-         cpf->n_events++;
-   }
+   set_header(s, prof, desc_lines, cmd_line, line);
+   free(cmd_line);
 
-   // create the running cross-check summary
-   cpf->summary = new_Counts_Zeroed( cpf->n_events );
-   if (cpf->summary == NULL)
+   // counts[0] is for the line number
+   counts  = malloc((1 + prof->n_events) * sizeof(ULong));
+   summary = calloc(prof->n_events, sizeof(ULong));
+   if (counts == NULL || summary == NULL)
       mallocFail(s, "parse_CacheProfFile(4)");
 
-   // create the outer map (file+fn name --> inner map)
-   cpf->outerMap = newFM ( malloc, free, cmp_FileFn );
-   if (cpf->outerMap == NULL)
-      mallocFail(s, "parse_CacheProfFile(5)");
+   curr_fl = curr_fn = intern(s, prof, "???");
 
    // process count lines
    while (1) {
@@ -699,19 +642,22 @@ static CacheProfFile* parse_CacheProfFile ( SOURCE* s )
          parseError(s, "parse_CacheProfFile: eof before SUMMARY line");
 
       if (isdigit(line[0])) {
-         handle_counts(s, cpf, curr_fl, curr_fn, line);
+         Int i;
+         splitUpCountsLine(s, counts, 1 + prof->n_events, line);
+         lnno = counts[0];
+         add_counts(s, prof, curr_fl, curr_fn, lnno, &counts[1]);
+         for (i = 0; i < prof->n_events; i++)
+            summary[i] += counts[1 + i];
          continue;
       }
       else
       if (streqn(line, "fn=", 3)) {
-         free(curr_fn);
-         curr_fn = strdup(line+3);
+         curr_fn = intern(s, prof, line+3);
          continue;
       }
       else
       if (streqn(line, "fl=", 3)) {
-         free(curr_fl);
-         curr_fl = strdup(line+3);
+         curr_fl = intern(s, prof, line+3);
          continue;
       }
       else
@@ -722,13 +668,9 @@ static CacheProfFile* parse_CacheProfFile ( SOURCE* s )
          parseError(s, "parse_CacheProfFile: unexpected line in main data");
    }
 
-   // finally, the "summary:" line
-   if (!streqn(line, "summary: ", 9))
-      parseError(s, "parse_CacheProfFile: missing SUMMARY line");
-
-   cpf->summary_line = strdup(line);
-   if (cpf->summary_line == NULL)
-      mallocFail(s, "parse_CacheProfFile(6)");
+   // check the summary counts are as expected
+   splitUpCountsLine(s, counts, prof->n_events, &line[8]);
+   check_summary(s, prof, summary, counts);
 
    // there should be nothing more
    line = readline(s);
@@ -736,122 +678,349 @@ static CacheProfFile* parse_CacheProfFile ( SOURCE* s )
       parseError(s, "parse_CacheProfFile: "
                     "extraneous content after SUMMARY line");
 
-   // check the summary counts are as expected
-   summaryRead = splitUpCountsLine( s, NULL, &cpf->summary_line[8] );
-   if (summaryRead == NULL)
-      mallocFail(s, "parse_CacheProfFile(7)");
-   if (summaryRead->n_counts != cpf->n_events)
-      parseError(s, "parse_CacheProfFile: wrong # counts in SUMMARY line");
-   for (i = 0; i < summaryRead->n_counts; i++) {
-      if (summaryRead->counts[i] != cpf->summary->counts[i]) {
-         parseError(s, "parse_CacheProfFile: "
-                       "computed vs stated SUMMARY counts mismatch");
+   free(counts);
+   free(summary);
+}
+
+/* The same for a binary file, whose magic has been read. */
+static void parse_CacheProfFile_binary ( SOURCE* s, Profile* prof )
+{
+   char**      desc_lines = NULL;
+   Int         n_desc_lines = 0;
+   char*       cmd_line = NULL;
+   const char* curr_fn;
+   const char* curr_fl;
+   ULong*      counts;
+   ULong*      summary;
+   size_t      len;
+   int         tag;
+   char*       line;
+
+   // The header records, as text lines.
+   while (1) {
+      tag = readrecord(s, &len);
+      if (tag != 'd')
+         break;
+      line = malloc(len + 7);
+      if (line == NULL)
+         mallocFail(s, "parse_CacheProfFile_binary(1)");
+      sprintf(line, "desc: %s", s->line);
+      desc_lines = add_desc_line(s, desc_lines, &n_desc_lines, line);
+      free(line);
+   }
+   if (n_desc_lines == 0)
+      parseError(s, "parse_CacheProfFile: no DESC lines present");
+
+   if (tag != 'c')
+      parseError(s, "parse_CacheProfFile: no CMD line present");
+   cmd_line = malloc(len + 6);
+   if (cmd_line == NULL)
+      mallocFail(s, "parse_CacheProfFile_binary(2)");
+   sprintf(cmd_line, "cmd: %s", s->line);
+
+   tag = readrecord(s, &len);
+   if (tag != 'e')
+      parseError(s, "parse_CacheProfFile: no EVENTS line present");
+   line = malloc(len + 9);
+   if (line == NULL)
+      mallocFail(s, "parse_CacheProfFile_binary(3)");
+   sprintf(line, "events: %s", s->line);
+   set_header(s, prof, desc_lines, cmd_line, line);
+   free(cmd_line);
+   free(line);
+
+   counts  = malloc((1 + prof->n_events) * sizeof(ULong));
+   summary = calloc(prof->n_events, sizeof(ULong));
+   if (counts == NULL || summary == NULL)
+      mallocFail(s, "parse_CacheProfFile_binary(4)");
+
+   curr_fl = curr_fn = intern(s, prof, "???");
+
+   while (1) {
+      tag = readrecord(s, &len);
+      if (tag == 'l') {
+         Int i;
+         splitUpCountsRecord(s, counts, 1 + prof->n_events, s->line, len);
+         add_counts(s, prof, curr_fl, curr_fn, counts[0], &counts[1]);
+         for (i = 0; i < prof->n_events; i++)
+            summary[i] += counts[1 + i];
       }
+      else if (tag == 'n')
+         curr_fn = intern(s, prof, s->line);
+      else if (tag == 'f')
+         curr_fl = intern(s, prof, s->line);
+      else if (tag == 's')
+         break;
+      else if (tag == EOF)
+         parseError(s, "parse_CacheProfFile: eof before SUMMARY line");
+      else
+         parseError(s, "parse_CacheProfFile: unexpected record in main data");
    }
-   free(summaryRead->counts);
-   sdel_Counts(summaryRead);
 
-   // since the summary counts are OK, free up the summary_line text
-   // which contains the same info.
-   free(cpf->summary_line);
-   cpf->summary_line = NULL;
+   splitUpCountsRecord(s, counts, prof->n_events, s->line, len);
+   check_summary(s, prof, summary, counts);
 
-   free(tmp_desclines);
-   free(curr_fn);
-   free(curr_fl);
+   if (readrecord(s, &len) != EOF)
+      parseError(s, "parse_CacheProfFile: "
+                    "extraneous content after SUMMARY line");
 
-   // All looks OK
-   return cpf;
+   free(counts);
+   free(summary);
 }
 
+static void merge_file ( Profile* prof, char* filename )
+{
+   SOURCE src;
+   char   magic[CGBIN_MAGIC_LEN];
+
+   fprintf(stderr, "%s: parsing %s\n", argv0, filename);
+   if (prof->events_line)
+      fprintf(stderr, "%s: merging %s\n", argv0, filename);
+   memset(&src, 0, sizeof(src));
+   src.lno      = 1;
+   src.filename = filename;
+   src.fp       = fopen(src.filename, "r");
+   if (!src.fp) {
+      perror(argv0);
+      barf(&src, "Cannot open input file");
+   }
 
-static void merge_CacheProfInfo ( SOURCE* s,
-                                  /*MOD*/CacheProfFile* dst,
-                                  CacheProfFile* src )
+   if (fread(magic, 1, CGBIN_MAGIC_LEN, src.fp) == CGBIN_MAGIC_LEN
+       && 0 == memcmp(magic, CGBIN_MAGIC, CGBIN_MAGIC_LEN)) {
+      src.binary = True;
+      parse_CacheProfFile_binary( &src, prof );
+   } else {
+      rewind(src.fp);
+      parse_CacheProfFile( &src, prof );
+   }
+   fclose(src.fp);
+   free(src.line);
+}
+
+/* Merge 'src', the profile of the 'n_files' files from 'files' on,
+   into 'dst', emptying 'src'.  Those files have been checked to agree
+   on their "events:" line already, but not with the ones before them. */
+static void merge_Profile ( Profile* dst, Profile* src,
+                            char** files, Int n_files )
 {
-   /* For each (filefn, innerMap) in src
-      if filefn not in dst
-         add binding dopy(filefn)->dopy(innerMap) in src
+   SOURCE s;
+   UWord  i;
+   Int    j;
+
+   if (src->events_line == NULL)
+      return;
+   if (dst->events_line == NULL) {
+      *dst = *src;
+      memset(src, 0, sizeof(Profile));
+      return;
+   }
+
+   if (!streq( dst->events_line, src->events_line )) {
+      if (n_files == 1)
+         fprintf(stderr, "%s: \"events:\" line of %s does not match "
+                         "those of the files before it\n", argv0, files[0]);
       else
-         // merge src->innerMap with dst->innerMap
-         for each (lineno, counts) in src->innerMap
-         if lineno not in dst->innerMap
-            add binding lineno->dopy(counts) to dst->innerMap
-         else
-            add counts into dst->innerMap[lineno]
-   */
-   /* Outer iterator:  FileFn* -> WordFM* (inner iterator)
-      Inner iterator:  UWord   -> Counts*
-   */
-   FileFn* soKey;
-   WordFM* soVal;
-   WordFM* doVal;
-   UWord   siKey;
-   Counts* siVal;
-   Counts* diVal;
-
-   /* First check mundane things: that the events: lines are
-      identical. */
-   if (!streq( dst->events_line, src->events_line ))
-     barf(s, "\"events:\" line of most recent file does "
-             "not match those previously processed");
-
-   initIterFM( src->outerMap );
-
-   // for (filefn, innerMap) in src
-   while (nextIterFM( src->outerMap, (Word*)&soKey, (Word*)&soVal )) {
-
-      // is filefn in dst?   
-      if (! lookupFM( dst->outerMap, (Word*)&doVal, (Word)soKey )) {
-
-         // no .. add dopy(filefn) -> dopy(innerMap) to src
-         FileFn* c_soKey = dopy_FileFn(soKey);
-         WordFM* c_soVal = dopy_InnerMap(soVal);
-         if ((!c_soKey) || (!c_soVal)) goto oom;
-         addToFM( dst->outerMap, (Word)c_soKey, (Word)c_soVal );
+         fprintf(stderr, "%s: \"events:\" line of %s to %s does not match "
+                         "those of the files before them\n",
+                         argv0, files[0], files[n_files - 1]);
+      exit(1);
+   }
 
-      } else {
+   memset(&s, 0, sizeof(s));
+   s.filename = files[0];
+   for (i = 0; i < src->entries_size; i++) {
+      Entry* e;
+      for (e = src->entries[i]; e; e = e->next) {
+         add_counts(&s, dst, intern(&s, dst, e->fi_name),
+                             intern(&s, dst, e->fn_name),
+                             e->lnno, e->counts);
+      }
+   }
+   for (j = 0; j < dst->n_events; j++)
+      dst->summary[j] += src->summary[j];
 
-         // yes .. merge the two innermaps
-         initIterFM( soVal );
+   ddel_Profile(src);
+}
 
-         // for (lno, counts) in soVal (source inner map)
-         while (nextIterFM( soVal, (Word*)&siKey, (Word*)&siVal )) {
+////////////////////////////////////////////////////////////////
 
-            // is lno in the corresponding dst inner map?
-            if (! lookupFM( doVal, (Word*)&diVal, siKey )) {
+static const Str* str_of ( const char* name )
+{
+   return (const Str*)(name - offsetof(Str, s));
+}
 
-               // no .. add lineno->dopy(counts) to dst inner map
-               Counts* c_siVal = dopy_Counts( siVal );
-               if (!c_siVal) goto oom;
-               addToFM( doVal, siKey, (Word)c_siVal );
+static int cmp_Str ( const void* v1, const void* v2 )
+{
+   return strcmp((*(Str* const*)v1)->s, (*(Str* const*)v2)->s);
+}
 
-            } else {
+// Sort by file name, then function name, then line number.  The names
+// have been ranked already, so no string comparisons are needed.
+static int cmp_Entry ( const void* v1, const void* v2 )
+{
+   const Entry* e1 = *(const Entry* const*)v1;
+   const Entry* e2 = *(const Entry* const*)v2;
+   UWord r1, r2;
+   r1 = str_of(e1->fi_name)->rank;
+   r2 = str_of(e2->fi_name)->rank;
+   if (r1 != r2)
+      return r1 < r2 ? -1 : 1;
+   r1 = str_of(e1->fn_name)->rank;
+   r2 = str_of(e2->fn_name)->rank;
+   if (r1 != r2)
+      return r1 < r2 ? -1 : 1;
+   return e1->lnno < e2->lnno ? -1 : e1->lnno > e2->lnno ? 1 : 0;
+}
 
-               // yes .. merge counts into dst inner map val
-               addCounts( s, diVal, siVal );
+static Entry** sorted_entries ( Profile* prof )
+{
+   Str**   strs = malloc((prof->n_strs + 1) * sizeof(Str*));
+   Entry** v    = malloc((prof->n_entries + 1) * sizeof(Entry*));
+   UWord   i, n = 0;
+   if (strs == NULL || v == NULL) {
+      fprintf(stderr, "%s: out of memory in sorted_entries\n", argv0);
+      exit(2);
+   }
 
-            }
-         }
+   for (i = 0; i < prof->strs_size; i++) {
+      Str* str;
+      for (str = prof->strs[i]; str; str = str->next)
+         strs[n++] = str;
+   }
+   assert(n == prof->n_strs);
+   qsort(strs, n, sizeof(Str*), cmp_Str);
+   for (i = 0; i < n; i++)
+      strs[i]->rank = i;
+   free(strs);
+
+   n = 0;
+   for (i = 0; i < prof->entries_size; i++) {
+      Entry* e;
+      for (e = prof->entries[i]; e; e = e->next)
+         v[n++] = e;
+   }
+   assert(n == prof->n_entries);
+   qsort(v, n, sizeof(Entry*), cmp_Entry);
+   return v;
+}
 
+// Write 'n' in decimal at 'p', returning the end.  This is a lot
+// quicker than fprintf for the millions of counts in a big profile.
+static char* show_ULong ( char* p, ULong n )
+{
+   char tmp[20];
+   Int  i = 0;
+   do {
+      tmp[i++] = '0' + n % 10;
+      n /= 10;
+   } while (n > 0);
+   while (i > 0)
+      *p++ = tmp[--i];
+   return p;
+}
+
+static void show_Profile ( FILE* f, Profile* prof )
+{
+   Int     i;
+   char**  d;
+   Entry** v = sorted_entries(prof);
+   UWord   k;
+   const char* fi = NULL;
+   const char* fn = NULL;
+   char*   buf = malloc((prof->n_events + 1) * 21 + 4);
+
+   assert(buf);
+   for (d = prof->desc_lines; *d; d++)
+      fprintf(f, "%s\n", *d);
+   fprintf(f, "%s\n", prof->cmd_line);
+   fprintf(f, "%s\n", prof->events_line);
+
+   for (k = 0; k < prof->n_entries; k++) {
+      Entry* e = v[k];
+      char*  p = buf;
+      if (e->fi_name != fi || e->fn_name != fn) {
+         fi = e->fi_name;
+         fn = e->fn_name;
+         fprintf(f, "fl=%s\nfn=%s\n", fi, fn );
+      }
+      p = show_ULong(p, e->lnno);
+      memcpy(p, "   ", 3);
+      p += 3;
+      for (i = 0; i < prof->n_events; i++) {
+         p = show_ULong(p, e->counts[i]);
+         *p++ = ' ';
       }
+      *p++ = '\n';
+      fwrite(buf, 1, p - buf, f);
+   }
+
+   fprintf(f, "summary:");
+   for (i = 0; i < prof->n_events; i++)
+      fprintf(f, " %llu", prof->summary[i]);
+   fprintf(f, "\n");
+
+   free(buf);
+   free(v);
+}
 
+static void show_Profile_binary ( FILE* f, Profile* prof )
+{
+   char**  d;
+   Entry** v = sorted_entries(prof);
+   UWord   k;
+   const char* fi = NULL;
+   const char* fn = NULL;
+
+   fwrite(CGBIN_MAGIC, 1, CGBIN_MAGIC_LEN, f);
+   for (d = prof->desc_lines; *d; d++)
+      writerecord(f, 'd', *d + 6, strlen(*d + 6));
+   writerecord(f, 'c', prof->cmd_line + 5, strlen(prof->cmd_line + 5));
+   writerecord(f, 'e', prof->events_line + 8,
+                       strlen(prof->events_line + 8));
+
+   for (k = 0; k < prof->n_entries; k++) {
+      Entry* e = v[k];
+      if (e->fi_name != fi) {
+         fi = e->fi_name;
+         writerecord(f, 'f', fi, strlen(fi));
+         fn = NULL;
+      }
+      if (e->fn_name != fn) {
+         fn = e->fn_name;
+         writerecord(f, 'n', fn, strlen(fn));
+      }
+      writecountsrecord(f, 'l', True, e->lnno, e->counts, prof->n_events);
    }
+   writecountsrecord(f, 's', False, 0, prof->summary, prof->n_events);
 
-   // add the summaries too
-   addCounts(s, dst->summary, src->summary );
+   free(v);
+}
+
+////////////////////////////////////////////////////////////////
 
-   return;
+typedef
+   struct {
+      char**  files;
+      Int     n_files;
+      Profile prof;
+   }
+   Job;
 
-  oom:
-   mallocFail(s, "merge_CacheProfInfo");
+static void* merge_files ( void* v )
+{
+   Job* job = v;
+   Int  i;
+   for (i = 0; i < job->n_files; i++)
+      merge_file( &job->prof, job->files[i] );
+   return NULL;
 }
 
 static void usage ( void )
 {
-   fprintf(stderr, "%s: Merges multiple cachegrind output files into one\n", 
+   fprintf(stderr, "%s: Merges multiple cachegrind output files into one\n",
                    argv0);
-   fprintf(stderr, "%s: usage: %s [-o outfile] [files-to-merge]\n", 
+   fprintf(stderr, "%s: usage: %s [-o outfile] [-j nthreads] [--binary] "
+                   "[files-to-merge]\n",
                    argv0, argv0);
    exit(1);
 }
@@ -859,12 +1028,16 @@ static void usage ( void )
 int main ( int argc, char** argv )
 {
    Int            i;
-   SOURCE         src;
-   CacheProfFile  *cpf, *cpfTmp;
+   Profile        prof;
+   Job*           jobs;
+   pthread_t*     threads;
+   char**         files;
+   Int            n_files = 0;
+   Int            n_threads = 1;
+   Bool           binary = False;
 
    FILE*          outfile = NULL;
    char*          outfilename = NULL;
-   Int            outfileix = 0;
 
    if (argv[0])
       argv0 = argv[0];
@@ -872,71 +1045,74 @@ int main ( int argc, char** argv )
    if (argc < 2)
       usage();
 
-   for (i = 1; i < argc; i++) {
-      if (streq(argv[i], "-h") || streq(argv[i], "--help"))
-         usage();
-   }
+   files = malloc(argc * sizeof(char*));
+   assert(files);
 
-   /* Scan args, looking for '-o outfilename'. */
+   /* Scan args, looking for options; the rest are files to merge. */
    for (i = 1; i < argc; i++) {
-      if (streq(argv[i], "-o")) {
-         if (i+1 < argc) {
-            outfilename = argv[i+1];
-            outfileix   = i;
-            break;
-         } else {
+      if (streq(argv[i], "-h") || streq(argv[i], "--help")) {
+         usage();
+      } else if (streq(argv[i], "-o")) {
+         if (i+1 >= argc)
             usage();
-         }
+         outfilename = argv[++i];
+      } else if (streq(argv[i], "-j")) {
+         if (i+1 >= argc || atoi(argv[i+1]) < 1)
+            usage();
+         n_threads = atoi(argv[++i]);
+      } else if (streq(argv[i], "--binary")) {
+         binary = True;
+      } else {
+         files[n_files++] = argv[i];
       }
    }
 
-   cpf = NULL;
-
-   for (i = 1; i < argc; i++) {
-
-      if (i == outfileix) {
-         /* Skip '-o' and whatever follows it */
-         i += 1;
-         continue;
-      }
-
-      fprintf(stderr, "%s: parsing %s\n", argv0, argv[i]);
-      src.lno      = 1;
-      src.filename = argv[i];
-      src.fp       = fopen(src.filename, "r");
-      if (!src.fp) {
-         perror(argv0);
-         barf(&src, "Cannot open input file");
+   /* Each thread merges a contiguous range of the files into a profile
+      of its own; then the profiles are merged in order, so that the
+      first file's description and command are the ones kept. */
+   if (n_threads > n_files)
+      n_threads = n_files;
+   init_Profile(&prof);
+   if (n_threads > 1) {
+      jobs    = malloc(n_threads * sizeof(Job));
+      threads = malloc(n_threads * sizeof(pthread_t));
+      assert(jobs && threads);
+      for (i = 0; i < n_threads; i++) {
+         Int first = (Word)n_files * i / n_threads;
+         Int next  = (Word)n_files * (i+1) / n_threads;
+         jobs[i].files   = &files[first];
+         jobs[i].n_files = next - first;
+         init_Profile(&jobs[i].prof);
+         if (pthread_create(&threads[i], NULL, merge_files, &jobs[i]) != 0) {
+            fprintf(stderr, "%s: can't create thread\n", argv0);
+            exit(1);
+         }
       }
-      assert(src.fp);
-      cpfTmp = parse_CacheProfFile( &src );
-      fclose(src.fp);
-
-      /* If this isn't the first file, merge */
-      if (cpf == NULL) {
-         /* this is the first file */
-         cpf = cpfTmp;
-      } else {
-         /* not the first file; merge */
-         fprintf(stderr, "%s: merging %s\n", argv0, argv[i]);
-         merge_CacheProfInfo( &src, cpf, cpfTmp );
-         ddel_CacheProfFile( cpfTmp );
+      for (i = 0; i < n_threads; i++) {
+         pthread_join(threads[i], NULL);
+         merge_Profile(&prof, &jobs[i].prof,
+                       jobs[i].files, jobs[i].n_files);
       }
-
+      free(jobs);
+      free(threads);
+   } else {
+      for (i = 0; i < n_files; i++)
+         merge_file(&prof, files[i]);
    }
+   free(files);
 
    /* Now create the output file. */
 
-   if (cpf) {
+   if (prof.events_line) {
 
-      fprintf(stderr, "%s: writing %s\n", 
+      fprintf(stderr, "%s: writing %s\n",
                        argv0, outfilename ? outfilename : "(stdout)" );
 
       /* Write the output. */
       if (outfilename) {
          outfile = fopen(outfilename, "w");
          if (!outfile) {
-            fprintf(stderr, "%s: can't create output file %s\n", 
+            fprintf(stderr, "%s: can't create output file %s\n",
                             argv0, outfilename);
             perror(argv0);
             exit(1);
@@ -945,9 +1121,12 @@ int main ( int argc, char** argv )
          outfile = stdout;
       }
 
-      show_CacheProfFile( outfile, cpf );
+      if (binary)
+         show_Profile_binary( outfile, &prof );
+      else
+         show_Profile( outfile, &prof );
       if (ferror(outfile)) {
-         fprintf(stderr, "%s: error writing output file %s\n", 
+         fprintf(stderr, "%s: error writing output file %s\n",
                          argv0, outfilename ? outfilename : "(stdout)" );
          perror(argv0);
          if (outfile != stdout)
@@ -959,624 +1138,12 @@ int main ( int argc, char** argv )
       if (outfile != stdout)
          fclose( outfile );
 
-      ddel_CacheProfFile( cpf );
-   }
-
-   return 0;
-}
-
-
-//------------------------------------------------------------------//
-//---                           WordFM                           ---//
-//---                       Implementation                       ---//
-//------------------------------------------------------------------//
-
-/* ------------ Implementation ------------ */
-
-/* One element of the AVL tree */
-typedef
-   struct _AvlNode {
-      Word key;
-      Word val;
-      struct _AvlNode* left;
-      struct _AvlNode* right;
-      Char balance;
-   }
-   AvlNode;
-
-typedef 
-   struct {
-      Word w;
-      Bool b;
-   }
-   MaybeWord;
-
-#define WFM_STKMAX    32    // At most 2**32 entries can be iterated over
-
-struct _WordFM {
-   AvlNode* root;
-   void*    (*alloc_nofail)( SizeT );
-   void     (*dealloc)(void*);
-   Word     (*kCmp)(Word,Word);
-   AvlNode* nodeStack[WFM_STKMAX]; // Iterator node stack
-   Int      numStack[WFM_STKMAX];  // Iterator num stack
-   Int      stackTop;              // Iterator stack pointer, one past end
-}; 
-
-/* forward */
-static Bool avl_removeroot_wrk(AvlNode** t, Word(*kCmp)(Word,Word));
-
-/* Swing to the left.  Warning: no balance maintenance. */
-static void avl_swl ( AvlNode** root )
-{
-   AvlNode* a = *root;
-   AvlNode* b = a->right;
-   *root    = b;
-   a->right = b->left;
-   b->left  = a;
-}
-
-/* Swing to the right.  Warning: no balance maintenance. */
-static void avl_swr ( AvlNode** root )
-{
-   AvlNode* a = *root;
-   AvlNode* b = a->left;
-   *root    = b;
-   a->left  = b->right;
-   b->right = a;
-}
-
-/* Balance maintenance after especially nasty swings. */
-static void avl_nasty ( AvlNode* root )
-{
-   switch (root->balance) {
-      case -1: 
-         root->left->balance  = 0;
-         root->right->balance = 1;
-         break;
-      case 1:
-         root->left->balance  = -1;
-         root->right->balance = 0;
-         break;
-      case 0:
-         root->left->balance  = 0;
-         root->right->balance = 0;
-         break;
-      default:
-         assert(0);
+      ddel_Profile( &prof );
    }
-   root->balance=0;
-}
 
-/* Find size of a non-NULL tree. */
-static Word size_avl_nonNull ( AvlNode* nd )
-{
-   return 1 + (nd->left  ? size_avl_nonNull(nd->left)  : 0)
-            + (nd->right ? size_avl_nonNull(nd->right) : 0);
-}
-
-/* Insert element a into the AVL tree t.  Returns True if the depth of
-   the tree has grown.  If element with that key is already present,
-   just copy a->val to existing node, first returning old ->val field
-   of existing node in *oldV, so that the caller can finalize it
-   however it wants.
-*/
-static 
-Bool avl_insert_wrk ( AvlNode**         rootp, 
-                      /*OUT*/MaybeWord* oldV,
-                      AvlNode*          a, 
-                      Word              (*kCmp)(Word,Word) )
-{
-   Word cmpres;
-
-   /* initialize */
-   a->left    = 0;
-   a->right   = 0;
-   a->balance = 0;
-   oldV->b    = False;
-
-   /* insert into an empty tree? */
-   if (!(*rootp)) {
-      (*rootp) = a;
-      return True;
-   }
- 
-   cmpres = kCmp( (*rootp)->key, a->key );
-
-   if (cmpres > 0) {
-      /* insert into the left subtree */
-      if ((*rootp)->left) {
-         AvlNode* left_subtree = (*rootp)->left;
-         if (avl_insert_wrk(&left_subtree, oldV, a, kCmp)) {
-            switch ((*rootp)->balance--) {
-               case  1: return False;
-               case  0: return True;
-               case -1: break;
-               default: assert(0);
-            }
-            if ((*rootp)->left->balance < 0) {
-               avl_swr( rootp );
-               (*rootp)->balance = 0;
-               (*rootp)->right->balance = 0;
-            } else {
-               avl_swl( &((*rootp)->left) );
-               avl_swr( rootp );
-               avl_nasty( *rootp );
-            }
-         } else {
-            (*rootp)->left = left_subtree;
-         }
-         return False;
-      } else {
-         (*rootp)->left = a;
-         if ((*rootp)->balance--) 
-            return False;
-         return True;
-      }
-      assert(0);/*NOTREACHED*/
-   }
-   else 
-   if (cmpres < 0) {
-      /* insert into the right subtree */
-      if ((*rootp)->right) {
-         AvlNode* right_subtree = (*rootp)->right;
-         if (avl_insert_wrk(&right_subtree, oldV, a, kCmp)) {
-            switch((*rootp)->balance++){
-               case -1: return False;
-               case  0: return True;
-               case  1: break;
-               default: assert(0);
-            }
-            if ((*rootp)->right->balance > 0) {
-               avl_swl( rootp );
-               (*rootp)->balance = 0;
-               (*rootp)->left->balance = 0;
-            } else {
-               avl_swr( &((*rootp)->right) );
-               avl_swl( rootp );
-               avl_nasty( *rootp );
-            }
-         } else {
-            (*rootp)->right = right_subtree;
-         }
-         return False;
-      } else {
-         (*rootp)->right = a;
-         if ((*rootp)->balance++) 
-            return False;
-         return True;
-      }
-      assert(0);/*NOTREACHED*/
-   }
-   else {
-      /* cmpres == 0, a duplicate - replace the val, but don't
-         incorporate the node in the tree */
-      oldV->b = True;
-      oldV->w = (*rootp)->val;
-      (*rootp)->val = a->val;
-      return False;
-   }
-}
-
-/* Remove an element a from the AVL tree t.  a must be part of
-   the tree.  Returns True if the depth of the tree has shrunk. 
-*/
-static
-Bool avl_remove_wrk ( AvlNode** rootp, 
-                      AvlNode*  a, 
-                      Word(*kCmp)(Word,Word) )
-{
-   Bool ch;
-   Word cmpres = kCmp( (*rootp)->key, a->key );
-
-   if (cmpres > 0){
-      /* remove from the left subtree */
-      AvlNode* left_subtree = (*rootp)->left;
-      assert(left_subtree);
-      ch = avl_remove_wrk(&left_subtree, a, kCmp);
-      (*rootp)->left=left_subtree;
-      if (ch) {
-         switch ((*rootp)->balance++) {
-            case -1: return True;
-            case  0: return False;
-            case  1: break;
-            default: assert(0);
-         }
-         switch ((*rootp)->right->balance) {
-            case 0:
-               avl_swl( rootp );
-               (*rootp)->balance = -1;
-               (*rootp)->left->balance = 1;
-               return False;
-            case 1: 
-               avl_swl( rootp );
-               (*rootp)->balance = 0;
-               (*rootp)->left->balance = 0;
-               return -1;
-            case -1:
-               break;
-            default:
-               assert(0);
-         }
-         avl_swr( &((*rootp)->right) );
-         avl_swl( rootp );
-         avl_nasty( *rootp );
-         return True;
-      }
-   }
-   else
-   if (cmpres < 0) {
-      /* remove from the right subtree */
-      AvlNode* right_subtree = (*rootp)->right;
-      assert(right_subtree);
-      ch = avl_remove_wrk(&right_subtree, a, kCmp);
-      (*rootp)->right = right_subtree;
-      if (ch) {
-         switch ((*rootp)->balance--) {
-            case  1: return True;
-            case  0: return False;
-            case -1: break;
-            default: assert(0);
-         }
-         switch ((*rootp)->left->balance) {
-            case 0:
-               avl_swr( rootp );
-               (*rootp)->balance = 1;
-               (*rootp)->right->balance = -1;
-               return False;
-            case -1:
-               avl_swr( rootp );
-               (*rootp)->balance = 0;
-               (*rootp)->right->balance = 0;
-               return True;
-            case 1:
-               break;
-            default:
-               assert(0);
-         }
-         avl_swl( &((*rootp)->left) );
-         avl_swr( rootp );
-         avl_nasty( *rootp );
-         return True;
-      }
-   }
-   else {
-      assert(cmpres == 0);
-      assert((*rootp)==a);
-      return avl_removeroot_wrk(rootp, kCmp);
-   }
    return 0;
 }
 
-/* Remove the root of the AVL tree *rootp.
- * Warning: dumps core if *rootp is empty
- */
-static 
-Bool avl_removeroot_wrk ( AvlNode** rootp, 
-                          Word(*kCmp)(Word,Word) )
-{
-   Bool     ch;
-   AvlNode* a;
-   if (!(*rootp)->left) {
-      if (!(*rootp)->right) {
-         (*rootp) = 0;
-         return True;
-      }
-      (*rootp) = (*rootp)->right;
-      return True;
-   }
-   if (!(*rootp)->right) {
-      (*rootp) = (*rootp)->left;
-      return True;
-   }
-   if ((*rootp)->balance < 0) {
-      /* remove from the left subtree */
-      a = (*rootp)->left;
-      while (a->right) a = a->right;
-   } else {
-      /* remove from the right subtree */
-      a = (*rootp)->right;
-      while (a->left) a = a->left;
-   }
-   ch = avl_remove_wrk(rootp, a, kCmp);
-   a->left    = (*rootp)->left;
-   a->right   = (*rootp)->right;
-   a->balance = (*rootp)->balance;
-   (*rootp)   = a;
-   if(a->balance == 0) return ch;
-   return False;
-}
-
-static 
-AvlNode* avl_find_node ( AvlNode* t, Word k, Word(*kCmp)(Word,Word) )
-{
-   Word cmpres;
-   while (True) {
-      if (t == NULL) return NULL;
-      cmpres = kCmp(t->key, k);
-      if (cmpres > 0) t = t->left;  else
-      if (cmpres < 0) t = t->right; else
-      return t;
-   }
-}
-
-// Clear the iterator stack.
-static void stackClear(WordFM* fm)
-{
-   Int i;
-   assert(fm);
-   for (i = 0; i < WFM_STKMAX; i++) {
-      fm->nodeStack[i] = NULL;
-      fm->numStack[i]  = 0;
-   }
-   fm->stackTop = 0;
-}
-
-// Push onto the iterator stack.
-static inline void stackPush(WordFM* fm, AvlNode* n, Int i)
-{
-   assert(fm->stackTop < WFM_STKMAX);
-   assert(1 <= i && i <= 3);
-   fm->nodeStack[fm->stackTop] = n;
-   fm-> numStack[fm->stackTop] = i;
-   fm->stackTop++;
-}
-
-// Pop from the iterator stack.
-static inline Bool stackPop(WordFM* fm, AvlNode** n, Int* i)
-{
-   assert(fm->stackTop <= WFM_STKMAX);
-
-   if (fm->stackTop > 0) {
-      fm->stackTop--;
-      *n = fm->nodeStack[fm->stackTop];
-      *i = fm-> numStack[fm->stackTop];
-      assert(1 <= *i && *i <= 3);
-      fm->nodeStack[fm->stackTop] = NULL;
-      fm-> numStack[fm->stackTop] = 0;
-      return True;
-   } else {
-      return False;
-   }
-}
-
-static 
-AvlNode* avl_dopy ( AvlNode* nd, 
-                    Word(*dopyK)(Word), 
-                    Word(*dopyV)(Word),
-                    void*(alloc_nofail)(SizeT) )
-{
-   AvlNode* nyu;
-   if (! nd)
-      return NULL;
-   nyu = alloc_nofail(sizeof(AvlNode));
-   assert(nyu);
-   
-   nyu->left = nd->left;
-   nyu->right = nd->right;
-   nyu->balance = nd->balance;
-
-   /* Copy key */
-   if (dopyK) {
-      nyu->key = dopyK( nd->key );
-      if (nd->key != 0 && nyu->key == 0)
-         return NULL; /* oom in key dcopy */
-   } else {
-      /* copying assumedly unboxed keys */
-      nyu->key = nd->key;
-   }
-
-   /* Copy val */
-   if (dopyV) {
-      nyu->val = dopyV( nd->val );
-      if (nd->val != 0 && nyu->val == 0)
-         return NULL; /* oom in val dcopy */
-   } else {
-      /* copying assumedly unboxed vals */
-      nyu->val = nd->val;
-   }
-
-   /* Copy subtrees */
-   if (nyu->left) {
-      nyu->left = avl_dopy( nyu->left, dopyK, dopyV, alloc_nofail );
-      if (! nyu->left)
-         return NULL;
-   }
-   if (nyu->right) {
-      nyu->right = avl_dopy( nyu->right, dopyK, dopyV, alloc_nofail );
-      if (! nyu->right)
-         return NULL;
-   }
-
-   return nyu;
-}
-
-/* --- Public interface functions --- */
-
-/* Initialise a WordFM. */
-void initFM ( WordFM* fm,
-              void*   (*alloc_nofail)( SizeT ),
-              void    (*dealloc)(void*),
-              Word    (*kCmp)(Word,Word) )
-{
-   fm->root         = 0;
-   fm->kCmp         = kCmp;
-   fm->alloc_nofail = alloc_nofail;
-   fm->dealloc      = dealloc;
-   fm->stackTop     = 0;
-}
-
-/* Allocate and Initialise a WordFM. */
-WordFM* newFM( void* (*alloc_nofail)( SizeT ),
-               void  (*dealloc)(void*),
-               Word  (*kCmp)(Word,Word) )
-{
-   WordFM* fm = alloc_nofail(sizeof(WordFM));
-   assert(fm);
-   initFM(fm, alloc_nofail, dealloc, kCmp);
-   return fm;
-}
-
-static void avl_free ( AvlNode* nd, 
-                       void(*kFin)(Word),
-                       void(*vFin)(Word),
-                       void(*dealloc)(void*) )
-{
-   if (!nd)
-      return;
-   if (nd->left)
-      avl_free(nd->left, kFin, vFin, dealloc);
-   if (nd->right)
-      avl_free(nd->right, kFin, vFin, dealloc);
-   if (kFin)
-      kFin( nd->key );
-   if (vFin)
-      vFin( nd->val );
-   memset(nd, 0, sizeof(AvlNode));
-   dealloc(nd);
-}
-
-/* Free up the FM.  If kFin is non-NULL, it is applied to keys
-   before the FM is deleted; ditto with vFin for vals. */
-void deleteFM ( WordFM* fm, void(*kFin)(Word), void(*vFin)(Word) )
-{
-   void(*dealloc)(void*) = fm->dealloc;
-   avl_free( fm->root, kFin, vFin, dealloc );
-   memset(fm, 0, sizeof(WordFM) );
-   dealloc(fm);
-}
-
-/* Add (k,v) to fm. */
-void addToFM ( WordFM* fm, Word k, Word v )
-{
-   MaybeWord oldV;
-   AvlNode* node;
-   node = fm->alloc_nofail( sizeof(struct _AvlNode) );
-   node->key = k;
-   node->val = v;
-   oldV.b = False;
-   oldV.w = 0;
-   avl_insert_wrk( &fm->root, &oldV, node, fm->kCmp );
-   //if (oldV.b && fm->vFin)
-   //   fm->vFin( oldV.w );
-   if (oldV.b)
-      free(node);
-}
-
-// Delete key from fm, returning associated val if found
-Bool delFromFM ( WordFM* fm, /*OUT*/Word* oldV, Word key )
-{
-   AvlNode* node = avl_find_node( fm->root, key, fm->kCmp );
-   if (node) {
-      avl_remove_wrk( &fm->root, node, fm->kCmp );
-      if (oldV)
-         *oldV = node->val;
-      fm->dealloc(node);
-      return True;
-   } else {
-      return False;
-   }
-}
-
-// Look up in fm, assigning found val at spec'd address
-Bool lookupFM ( WordFM* fm, /*OUT*/Word* valP, Word key )
-{
-   AvlNode* node = avl_find_node( fm->root, key, fm->kCmp );
-   if (node) {
-      if (valP)
-         *valP = node->val;
-      return True;
-   } else {
-      return False;
-   }
-}
-
-Word sizeFM ( WordFM* fm )
-{
-   // Hmm, this is a bad way to do this
-   return fm->root ? size_avl_nonNull( fm->root ) : 0;
-}
-
-// set up FM for iteration
-void initIterFM ( WordFM* fm )
-{
-   assert(fm);
-   stackClear(fm);
-   if (fm->root)
-      stackPush(fm, fm->root, 1);
-}
-
-// get next key/val pair.  Will assert if fm has been modified
-// or looked up in since initIterFM was called.
-Bool nextIterFM ( WordFM* fm, /*OUT*/Word* pKey, /*OUT*/Word* pVal )
-{
-   Int i = 0;
-   AvlNode* n = NULL;
-   
-   assert(fm);
-
-   // This in-order traversal requires each node to be pushed and popped
-   // three times.  These could be avoided by updating nodes in-situ on the
-   // top of the stack, but the push/pop cost is so small that it's worth
-   // keeping this loop in this simpler form.
-   while (stackPop(fm, &n, &i)) {
-      switch (i) {
-      case 1: 
-         stackPush(fm, n, 2);
-         if (n->left)  stackPush(fm, n->left, 1);
-         break;
-      case 2: 
-         stackPush(fm, n, 3);
-         if (pKey) *pKey = n->key;
-         if (pVal) *pVal = n->val;
-         return True;
-      case 3:
-         if (n->right) stackPush(fm, n->right, 1);
-         break;
-      default:
-         assert(0);
-      }
-   }
-
-   // Stack empty, iterator is exhausted, return NULL
-   return False;
-}
-
-// clear the I'm iterating flag
-void doneIterFM ( WordFM* fm )
-{
-}
-
-WordFM* dopyFM ( WordFM* fm, Word(*dopyK)(Word), Word(*dopyV)(Word) )
-{
-   WordFM* nyu; 
-
-   /* can't clone the fm whilst iterating on it */
-   assert(fm->stackTop == 0);
-
-   nyu = fm->alloc_nofail( sizeof(WordFM) );
-   assert(nyu);
-
-   *nyu = *fm;
-
-   fm->stackTop = 0;
-   memset(fm->nodeStack, 0, sizeof(fm->nodeStack));
-   memset(fm->numStack, 0,  sizeof(fm->numStack));
-
-   if (nyu->root) {
-      nyu->root = avl_dopy( nyu->root, dopyK, dopyV, fm->alloc_nofail );
-      if (! nyu->root)
-         return NULL;
-   }
-
-   return nyu;
-}
-
-//------------------------------------------------------------------//
-//---                         end WordFM                         ---//
-//---                       Implementation                       ---//
-//------------------------------------------------------------------//
-
 /*--------------------------------------------------------------------*/
 /*--- end                                               cg_merge.c ---*/
 /*--------------------------------------------------------------------*/
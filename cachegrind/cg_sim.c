@@ -214,6 +214,463 @@ void cachesim_D1_doref(Addr a, UChar size, ULong* m1, ULong *mL)
    }
 }
 
+/*------------------------------------------------------------*/
+/*--- Extended data-side simulation                        ---*/
+/*------------------------------------------------------------*/
+
+/* Multi-core simulation (--sim-cores), prefetching (--prefetch) and
+   the DTLB (--tlb-sim) are simulated by cachesim_D1_doref_X, which is
+   used instead of cachesim_D1_doref for all data accesses if any of
+   them is enabled.  The events they count are these. */
+typedef struct {
+   ULong inv;    /* lines invalidated in other cores' D1 by writes */
+   ULong mc;     /* D1 misses on lines taken by another core's write */
+   ULong mf;     /* ... of which didn't touch any of the written bytes */
+   ULong pf;     /* lines prefetched into D1 */
+   ULong pfu;    /* prefetched lines then used by a demand access */
+   ULong tlb1m;  /* first-level DTLB misses */
+   ULong tlbm;   /* ... which also missed in the second-level TLB */
+} ExtCC;
+
+/*--- DTLB ---*/
+
+/* The DTLB has first-level TLBs for 4KB pages (64 entries, 4-way) and
+   2MB pages (32 entries, 4-way), which are looked up together, and a
+   second-level TLB for both (1536 entries, 12-way), as on recent x86
+   cores.  The TLBs are caches whose lines are pages.  Unless
+   tlb_huge_pages is set all pages are 4KB; if it is, the 2MB-aligned
+   parts of anonymous client mappings are taken to be 2MB pages, as
+   with transparent huge pages. */
+
+#define TLB_4K_BITS  12
+#define TLB_2M_BITS  21
+
+static Bool     tlb_on = False;
+static Bool     tlb_huge_pages;
+static cache_t2 DTLB1_4K;
+static cache_t2 DTLB1_2M;
+static cache_t2 DTLB2;
+
+static void cachesim_init_dtlb(Bool huge_pages)
+{
+   cache_t DTLB1_4Kc = {   64 << TLB_4K_BITS,  4, 1 << TLB_4K_BITS };
+   cache_t DTLB1_2Mc = {   32 << TLB_2M_BITS,  4, 1 << TLB_2M_BITS };
+   cache_t DTLB2c    = { 1536 << TLB_4K_BITS, 12, 1 << TLB_4K_BITS };
+
+   tlb_on         = True;
+   tlb_huge_pages = huge_pages;
+   cachesim_initcache(DTLB1_4Kc, &DTLB1_4K);
+   cachesim_initcache(DTLB1_2Mc, &DTLB1_2M);
+   cachesim_initcache(DTLB2c,    &DTLB2);
+}
+
+/* Like cachesim_setref_is_miss, but doesn't insert 'tag' if it isn't
+   there.  Returns True if it is. */
+static Bool cachesim_setref_lookup(cache_t2* c, UInt set_no, UWord tag)
+{
+   UWord* set = &(c->tags[set_no * c->assoc]);
+   Int i, j;
+
+   for (i = 0; i < c->assoc; i++) {
+      if (set[i] == tag) {
+         for (j = i; j > 0; j--)
+            set[j] = set[j - 1];
+         set[0] = tag;
+         return True;
+      }
+   }
+   return False;
+}
+
+static Bool is_huge_page(Addr a)
+{
+   Addr start = a & ~(((Addr)1 << TLB_2M_BITS) - 1);
+   Addr end   = start + ((Addr)1 << TLB_2M_BITS) - 1;
+   NSegment const* seg;
+
+   if (!tlb_huge_pages)
+      return False;
+   seg = VG_(am_find_nsegment)(a);
+   return seg != NULL && seg->kind == SkAnonC
+          && seg->start <= start && end <= seg->end;
+}
+
+static void cachesim_DTLB_doref(Addr a, ExtCC* cc)
+{
+   UWord page4 = a >> TLB_4K_BITS;
+   UWord page2 = a >> TLB_2M_BITS;
+   UWord page;
+   Bool  huge;
+
+   if (cachesim_setref_lookup(&DTLB1_4K, page4 & DTLB1_4K.sets_min_1, page4)
+       || (tlb_huge_pages
+           && cachesim_setref_lookup(&DTLB1_2M, page2 & DTLB1_2M.sets_min_1,
+                                     page2)))
+      return;
+
+   cc->tlb1m++;
+   huge = is_huge_page(a);
+   page = huge ? page2 : page4;
+   /* Both page sizes share the second-level TLB, so the tag says
+      which one it is. */
+   if (cachesim_setref_is_miss(&DTLB2, page & DTLB2.sets_min_1,
+                               (page << 1) | huge))
+      cc->tlbm++;
+   if (huge)
+      cachesim_setref_is_miss(&DTLB1_2M, page & DTLB1_2M.sets_min_1, page);
+   else
+      cachesim_setref_is_miss(&DTLB1_4K, page & DTLB1_4K.sets_min_1, page);
+}
+
+/*--- Prefetching ---*/
+
+/* Two prefetchers can bring lines into D1 (through LL, as misses do):
+   - the stream prefetcher watches the lines missed in D1 (or found
+     there thanks to a prefetch) in each 4KB page, and once it has seen
+     three consecutive ones, ascending or descending, prefetches the
+     line pf_distance lines further on in the same page;
+   - the stride prefetcher remembers the last address accessed by each
+     instruction, and once an instruction has used the same stride
+     three times in a row, prefetches pf_distance strides ahead.
+   A prefetched line has PF_BIT set in its tag until a demand access
+   finds it there, which counts it as a useful prefetch.  Only
+   cachesim_D1_doref_X knows about the bit, so the ordinary lookups
+   must not be used for D1 while prefetching is on. */
+
+#define PF_STREAM       1
+#define PF_STRIDE       2
+
+#define PF_BIT          ((UWord)1 << (sizeof(UWord) * 8 - 1))
+#define PF_PAGE_BITS    12
+#define PF_STREAMS      16
+#define PF_STRIDE_ENTS  256   /* a power of 2 */
+
+typedef struct {
+   Addr pc;                  /* instruction, 0 == empty */
+   Addr last;                /* the address it last accessed */
+   Word stride;
+   Int  conf;                /* times in a row 'stride' was seen, up to 3 */
+} StrideEnt;
+
+static Int       pf_kinds = 0;   /* PF_STREAM | PF_STRIDE */
+static Int       pf_distance;
+static UWord     pf_lastblock[PF_STREAMS];
+static Int       pf_seqblocks[PF_STREAMS];
+static StrideEnt pf_stride_tab[PF_STRIDE_ENTS];
+
+static void cachesim_init_prefetch(Int kinds, Int distance)
+{
+   pf_kinds    = kinds;
+   pf_distance = distance;
+}
+
+/* Brings the line containing 'a' into D1, as MRU, unless it's there. */
+static void cachesim_D1_prefetch(Addr a, ExtCC* cc)
+{
+   UWord  block = a >> D1.line_size_bits;
+   UWord* set   = &(D1.tags[(block & D1.sets_min_1) * D1.assoc]);
+   Int i;
+
+   for (i = 0; i < D1.assoc; i++)
+      if ((set[i] & ~PF_BIT) == block)
+         return;
+   for (i = D1.assoc - 1; i > 0; i--)
+      set[i] = set[i - 1];
+   set[0] = block | PF_BIT;
+   cc->pf++;
+   cachesim_ref_is_miss(&LL, a, 1);
+}
+
+/* If 'block' was prefetched into D1 and not used since, clears its
+   PF_BIT and returns True. */
+static Bool cachesim_D1_take_prefetched(UWord block)
+{
+   UWord* set = &(D1.tags[(block & D1.sets_min_1) * D1.assoc]);
+   Int i;
+
+   for (i = 0; i < D1.assoc; i++) {
+      if (set[i] == (block | PF_BIT)) {
+         set[i] = block;
+         return True;
+      }
+   }
+   return False;
+}
+
+static void pf_stream_train(Addr a, ExtCC* cc)
+{
+   UInt  s     = (a >> PF_PAGE_BITS) % PF_STREAMS;
+   UWord block = a >> D1.line_size_bits;
+   Addr  target;
+
+   if (block == pf_lastblock[s])
+      return;
+   if (block == pf_lastblock[s] + 1)
+      pf_seqblocks[s] = pf_seqblocks[s] > 0 ? pf_seqblocks[s] + 1 : 1;
+   else if (block == pf_lastblock[s] - 1)
+      pf_seqblocks[s] = pf_seqblocks[s] < 0 ? pf_seqblocks[s] - 1 : -1;
+   else
+      pf_seqblocks[s] = 0;
+   pf_lastblock[s] = block;
+
+   if (pf_seqblocks[s] >= 2)
+      target = a + pf_distance * D1.line_size;
+   else if (pf_seqblocks[s] <= -2)
+      target = a - pf_distance * D1.line_size;
+   else
+      return;
+   if ((target >> PF_PAGE_BITS) == (a >> PF_PAGE_BITS))
+      cachesim_D1_prefetch(target, cc);
+}
+
+static void pf_stride_train(Addr pc, Addr a, ExtCC* cc)
+{
+   StrideEnt* e = &pf_stride_tab[(pc ^ (pc >> 8)) & (PF_STRIDE_ENTS - 1)];
+   Word       stride;
+
+   if (e->pc != pc) {
+      e->pc     = pc;
+      e->last   = a;
+      e->stride = 0;
+      e->conf   = 0;
+      return;
+   }
+   stride = a - e->last;
+   if (stride == 0)
+      return;
+   if (stride == e->stride) {
+      if (e->conf < 3)
+         e->conf++;
+   } else {
+      e->stride = stride;
+      e->conf   = 0;
+   }
+   e->last = a;
+
+   /* Like hardware stride prefetchers, ignore large strides. */
+   if (e->conf >= 2 && stride > -2048 && stride < 2048)
+      cachesim_D1_prefetch(a + pf_distance * stride, cc);
+}
+
+/*--- Multi-core ---*/
+
+/* With --sim-cores=N for N > 1, each simulated core has private I1 and
+   D1 caches and DTLB, and LL is shared.  The caches of the core running
+   the current thread are the ones in I1, D1 and the DTLB variables;
+   cachesim_switch_core swaps them.  A write by one core invalidates the
+   line in the D1 caches of all the other cores.  Each core remembers,
+   in a small direct-mapped table, which lines were taken from it that
+   way and which bytes of them were written, so that a later D1 miss on
+   such a line can be counted as a coherence miss, and as a
+   false-sharing miss if it does not touch any of those bytes.  The
+   table can forget lines, so the coherence miss counts are a lower
+   bound.  I1 is not kept coherent, and the prefetchers are shared. */
+
+#define INV_TAB_SIZE  4096   /* entries per core; a power of 2 */
+
+typedef struct {
+   UWord block;              /* 0 == empty, like cache tags */
+   ULong written;            /* one bit per 1/64 of the line */
+} InvEnt;
+
+typedef struct {
+   cache_t2 I1;
+   cache_t2 D1;
+   cache_t2 DTLB1_4K;
+   cache_t2 DTLB1_2M;
+   cache_t2 DTLB2;
+} CoreCaches;
+
+static Int         n_cores  = 1;
+static Int         cur_core = 0;
+static CoreCaches* cores;    /* [n_cores], not valid for cur_core */
+static InvEnt*     core_inv; /* [n_cores * INV_TAB_SIZE] */
+static Int         written_gran_bits;
+
+static void cachesim_save_core(CoreCaches* core)
+{
+   core->I1 = I1;
+   core->D1 = D1;
+   if (tlb_on) {
+      core->DTLB1_4K = DTLB1_4K;
+      core->DTLB1_2M = DTLB1_2M;
+      core->DTLB2    = DTLB2;
+   }
+}
+
+static void cachesim_restore_core(const CoreCaches* core)
+{
+   I1 = core->I1;
+   D1 = core->D1;
+   if (tlb_on) {
+      DTLB1_4K = core->DTLB1_4K;
+      DTLB1_2M = core->DTLB1_2M;
+      DTLB2    = core->DTLB2;
+   }
+}
+
+/* Called after the caches, and the DTLB if it's simulated, have been
+   set up for core 0. */
+static void cachesim_init_cores(Int n)
+{
+   Int i;
+
+   n_cores = n;
+   if (n_cores == 1)
+      return;
+
+   cores    = VG_(malloc)("cg.sim.ic.1", n_cores * sizeof(CoreCaches));
+   core_inv = VG_(calloc)("cg.sim.ic.2", n_cores * INV_TAB_SIZE,
+                          sizeof(InvEnt));
+   cachesim_save_core(&cores[0]);
+   for (i = 1; i < n_cores; i++) {
+      CoreCaches* c = &cores[i];
+      cache_t I1c = { I1.size, I1.assoc, I1.line_size };
+      cache_t D1c = { D1.size, D1.assoc, D1.line_size };
+      cachesim_initcache(I1c, &c->I1);
+      cachesim_initcache(D1c, &c->D1);
+      if (tlb_on) {
+         cache_t DTLB1_4Kc = { DTLB1_4K.size, DTLB1_4K.assoc,
+                               DTLB1_4K.line_size };
+         cache_t DTLB1_2Mc = { DTLB1_2M.size, DTLB1_2M.assoc,
+                               DTLB1_2M.line_size };
+         cache_t DTLB2c    = { DTLB2.size, DTLB2.assoc, DTLB2.line_size };
+         cachesim_initcache(DTLB1_4Kc, &c->DTLB1_4K);
+         cachesim_initcache(DTLB1_2Mc, &c->DTLB1_2M);
+         cachesim_initcache(DTLB2c,    &c->DTLB2);
+      }
+   }
+   written_gran_bits = D1.line_size_bits > 6 ? D1.line_size_bits - 6 : 0;
+}
+
+static void cachesim_switch_core(Int core)
+{
+   if (core == cur_core)
+      return;
+   cachesim_save_core(&cores[cur_core]);
+   cur_core = core;
+   cachesim_restore_core(&cores[cur_core]);
+}
+
+/* The bits for the bytes of [a, a+size) that lie in D1 line 'block'. */
+static ULong written_mask(UWord block, Addr a, UChar size)
+{
+   Addr  start = block << D1.line_size_bits;
+   Addr  end   = start + D1.line_size - 1;
+   Addr  lo    = a > start ? a : start;
+   Addr  hi    = a + size - 1 < end ? a + size - 1 : end;
+   UInt  lo_b  = (lo - start) >> written_gran_bits;
+   UInt  hi_b  = (hi - start) >> written_gran_bits;
+   ULong mask  = hi_b == 63 ? ~0ULL : (1ULL << (hi_b + 1)) - 1;
+
+   return mask & ~((1ULL << lo_b) - 1);
+}
+
+/* Removes 'block' from D1 cache 'c', if it is there, prefetched or
+   not. */
+static Bool cachesim_evict(cache_t2* c, UWord block)
+{
+   UWord* set = &(c->tags[(block & c->sets_min_1) * c->assoc]);
+   Int i, j;
+
+   for (i = 0; i < c->assoc; i++) {
+      if ((set[i] & ~PF_BIT) == block) {
+         for (j = i; j < c->assoc - 1; j++)
+            set[j] = set[j + 1];
+         set[c->assoc - 1] = 0;
+         return True;
+      }
+   }
+   return False;
+}
+
+static void cachesim_coherence_write_block(UWord block, Addr a, UChar size,
+                                           ExtCC* cc)
+{
+   ULong written = written_mask(block, a, size);
+   Int   core;
+
+   for (core = 0; core < n_cores; core++) {
+      InvEnt* e;
+      if (core == cur_core)
+         continue;
+      e = &core_inv[core * INV_TAB_SIZE + (block & (INV_TAB_SIZE - 1))];
+      if (cachesim_evict(&cores[core].D1, block)) {
+         cc->inv++;
+         e->block   = block;
+         e->written = written;
+      } else if (e->block == block) {
+         e->written |= written;
+      }
+   }
+}
+
+/* Returns 0 if 'block' was not taken from the current core by another
+   core's write, 1 if it was and [a, a+size) overlaps the bytes written,
+   and 2 if it doesn't (false sharing). */
+static Int cachesim_coherence_miss_block(UWord block, Addr a, UChar size)
+{
+   InvEnt* e = &core_inv[cur_core * INV_TAB_SIZE
+                         + (block & (INV_TAB_SIZE - 1))];
+
+   if (e->block != block)
+      return 0;
+   e->block = 0;
+   return (e->written & written_mask(block, a, size)) == 0 ? 2 : 1;
+}
+
+/* cachesim_D1_doref, plus whatever else is simulated.  'pc' is the
+   address of the accessing instruction. */
+static void cachesim_D1_doref_X(Addr a, UChar size, Bool is_write, Addr pc,
+                                ULong* m1, ULong *mL, ExtCC* cc)
+{
+   UWord block1 =  a         >> D1.line_size_bits;
+   UWord block2 = (a+size-1) >> D1.line_size_bits;
+   Bool  miss, pf_hit = False;
+
+   if (tlb_on) {
+      cachesim_DTLB_doref(a, cc);
+      if ((a >> TLB_4K_BITS) != ((a+size-1) >> TLB_4K_BITS))
+         cachesim_DTLB_doref(a+size-1, cc);
+   }
+
+   if (pf_kinds != 0) {
+      pf_hit = cachesim_D1_take_prefetched(block1);
+      if (block2 != block1 && cachesim_D1_take_prefetched(block2))
+         pf_hit = True;
+      if (pf_hit)
+         cc->pfu++;
+   }
+
+   miss = cachesim_ref_is_miss(&D1, a, size);
+   if (miss) {
+      (*m1)++;
+      if (cachesim_ref_is_miss(&LL, a, size))
+         (*mL)++;
+      if (n_cores > 1) {
+         /* Count a straddling access once, like the miss itself. */
+         Int k1 = cachesim_coherence_miss_block(block1, a, size);
+         Int k2 = block2 == block1
+                     ? 0 : cachesim_coherence_miss_block(block2, a, size);
+         if (k1 != 0 || k2 != 0) {
+            cc->mc++;
+            if (k1 != 1 && k2 != 1)
+               cc->mf++;
+         }
+      }
+   }
+   if (is_write && n_cores > 1) {
+      cachesim_coherence_write_block(block1, a, size, cc);
+      if (block2 != block1)
+         cachesim_coherence_write_block(block2, a, size, cc);
+   }
+
+   if ((pf_kinds & PF_STREAM) && (miss || pf_hit))
+      pf_stream_train(a, cc);
+   if (pf_kinds & PF_STRIDE)
+      pf_stride_train(pc, a, cc);
+}
+
 /* Check for special case IrNoX. Called at instrumentation time.
  *
  * Does this Ir only touch one cache line, and are L1I/LL cache
@@ -0,0 +1,42 @@
+// Two threads taking turns to write to the same cache line: to the same
+// word ("true" sharing), or to different words ("false" sharing).  Each
+// thread yields every so often so that, run with --sim-cores=2, the line
+// moves between the two simulated cores.
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROUNDS  100
+#define WRITES  100
+
+static struct {
+   volatile int word[16];
+} line __attribute__((aligned(64)));
+
+static void* writer(void* arg)
+{
+   volatile int* p = arg;
+   int i, j;
+
+   for (i = 0; i < ROUNDS; i++) {
+      for (j = 0; j < WRITES; j++)
+         *p += 1;
+      sched_yield();
+   }
+   return NULL;
+}
+
+int main(int argc, char** argv)
+{
+   pthread_t t1, t2;
+   int false_sharing = argc > 1 && strcmp(argv[1], "false") == 0;
+
+   pthread_create(&t1, NULL, writer, (void*)&line.word[0]);
+   pthread_create(&t2, NULL, writer,
+                  (void*)&line.word[false_sharing ? 8 : 0]);
+   pthread_join(t1, NULL);
+   pthread_join(t2, NULL);
+   return 0;
+}
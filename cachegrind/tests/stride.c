@@ -0,0 +1,34 @@
+// Walks a large buffer in one of three ways, for the prefetcher and
+// DTLB tests:
+//   stream  reads every cache line in turn (the stream prefetcher's case)
+//   stride  reads one cache line in sixteen (the stride prefetcher's)
+//   pages   reads one line in each 4KB page, several times (the DTLB's)
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SIZE  (32 << 20)
+
+static int walk(volatile char* buf, size_t step, int times)
+{
+   int sum = 0, t;
+   size_t i;
+
+   for (t = 0; t < times; t++)
+      for (i = 0; i < SIZE; i += step)
+         sum += buf[i];
+   return sum;
+}
+
+int main(int argc, char** argv)
+{
+   char* buf = malloc(SIZE);
+   const char* how = argc > 1 ? argv[1] : "stream";
+
+   memset(buf, 1, SIZE);
+   if (strcmp(how, "stream") == 0)
+      return walk(buf, 64, 1) == 0;
+   if (strcmp(how, "stride") == 0)
+      return walk(buf, 1024, 1) == 0;
+   return walk(buf, 4096, 4) == 0;
+}
@@ -0,0 +1,351 @@
+/*--------------------------------------------------------------------*/
+/*--- A program that converts callgrind's binary output format     ---*/
+/*--- to the text format.                     callgrind_convert.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+  This file is part of Callgrind, a Valgrind tool for call graph
+  profiling programs.
+
+  Copyright (C) 2019 The Valgrind developers
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307, USA.
+
+  The GNU General Public License is contained in the file COPYING.
+*/
+
+/* The binary format is described in dump.c.  The text written is
+   exactly the one callgrind would have written with
+   --callgrind-out-format=text; a text file is copied unchanged. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../coregrind/m_debuginfo/minilzo.h"
+
+typedef  unsigned char      UChar;
+typedef  signed int         Int;
+typedef  unsigned int       UInt;
+typedef  unsigned long long ULong;
+
+#define BIN_MAGIC  "# callgrind binary format 1\n"
+
+#define REC_COST   1
+#define REC_CALLS  2
+#define REC_POS    3
+#define REC_JUMP   4
+#define REC_JCND   5
+
+#define POS_HEX    0
+#define POS_DEC    1
+#define POS_DIFF   2
+
+static const char* argv0 = "callgrind_convert";
+static const char* in_name;
+static FILE*       in_fp;
+
+/* The data of the current block, and how far it has been read */
+static UChar* block;
+static UInt   block_size;
+static UInt   block_len;
+static UInt   block_pos;
+static UChar* zblock;
+static UInt   zblock_size;
+
+/* Output is collected here, to avoid a stdio call per item */
+#define OUT_SIZE  (1 << 16)
+static UChar  out_buf[OUT_SIZE];
+static UInt   out_used;
+static FILE*  out_fp;
+
+__attribute__((noreturn))
+static void barf ( const char* msg )
+{
+   fprintf(stderr, "%s: %s: %s\n", argv0, in_name, msg);
+   exit(1);
+}
+
+static void grow ( UChar** buf, UInt* size, UInt needed )
+{
+   if (needed > *size) {
+      free(*buf);
+      *size = needed;
+      *buf = malloc(needed);
+      if (*buf == NULL) {
+         fprintf(stderr, "%s: out of memory\n", argv0);
+         exit(2);
+      }
+   }
+}
+
+static UInt get_le32 ( const UChar* p )
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | ((UInt)p[3] << 24);
+}
+
+/* Reads the next block; returns 0 at the end of the file */
+static Int next_block ( void )
+{
+   UChar hdr[8];
+   UInt  len, zlen;
+   size_t n = fread(hdr, 1, 8, in_fp);
+
+   if (n == 0) return 0;
+   if (n != 8) barf("truncated block header");
+   len  = get_le32(hdr);
+   zlen = get_le32(hdr+4);
+   if (len == 0 || zlen > len) barf("bad block header");
+
+   grow(&block, &block_size, len);
+   if (zlen == len) {
+      if (fread(block, 1, len, in_fp) != len) barf("truncated block");
+   }
+   else {
+      lzo_uint dst_len = len;
+      grow(&zblock, &zblock_size, zlen);
+      if (fread(zblock, 1, zlen, in_fp) != zlen) barf("truncated block");
+      if (lzo1x_decompress_safe(zblock, zlen, block, &dst_len, NULL)
+          != LZO_E_OK || dst_len != len)
+         barf("corrupt compressed block");
+   }
+   block_len = len;
+   block_pos = 0;
+   return 1;
+}
+
+/* Returns the next byte of the data, or -1 at the end of the file */
+static inline Int get_byte ( void )
+{
+   if (block_pos == block_len && !next_block())
+      return -1;
+   return block[block_pos++];
+}
+
+static ULong get_num ( void )
+{
+   ULong n = 0;
+   Int shift = 0, c;
+
+   do {
+      c = get_byte();
+      if (c < 0) barf("truncated record");
+      if (shift > 63) barf("bad number in record");
+      n |= (ULong)(c & 0x7f) << shift;
+      shift += 7;
+   } while (c & 0x80);
+   return n;
+}
+
+static void flush_out ( void )
+{
+   if (fwrite(out_buf, 1, out_used, out_fp) != out_used) {
+      fprintf(stderr, "%s: error writing output\n", argv0);
+      exit(1);
+   }
+   out_used = 0;
+}
+
+static inline void put_char ( UChar c )
+{
+   if (out_used == OUT_SIZE) flush_out();
+   out_buf[out_used++] = c;
+}
+
+static void put_str ( const char* s )
+{
+   while (*s) put_char(*s++);
+}
+
+static void put_num ( ULong n, UInt base )
+{
+   char  tmp[24];
+   Int   i = 0;
+
+   do {
+      tmp[i++] = "0123456789abcdef"[n % base];
+      n /= base;
+   } while (n > 0);
+   while (i > 0) put_char(tmp[--i]);
+}
+
+/* A position, as printed by fprint_pos() in dump.c */
+static void put_pos ( void )
+{
+   ULong parts = get_num(), v;
+   Int d;
+
+   while (parts-- > 0) {
+      v = get_num();
+      switch (v & 3) {
+      case POS_HEX:
+         put_str("0x");
+         put_num(get_num(), 16);
+         break;
+      case POS_DEC:
+         put_num((UInt)(v >> 2), 10);
+         break;
+      case POS_DIFF:
+         v >>= 2;
+         d = (Int)((v >> 1) ^ -(v & 1));
+         if (d > 0) {
+            put_char('+');
+            put_num(d, 10);
+         }
+         else if (d == 0)
+            put_char('*');
+         else {
+            put_char('-');
+            put_num(-(ULong)d, 10);
+         }
+         break;
+      default:
+         barf("bad position in record");
+      }
+      put_char(' ');
+   }
+}
+
+/* Costs, as printed by fprint_cost() in dump.c */
+static void put_costs ( void )
+{
+   ULong n = get_num(), i;
+
+   for (i = 0; i < n; i++) {
+      if (i > 0) put_char(' ');
+      put_num(get_num(), 10);
+   }
+}
+
+static void convert ( void )
+{
+   Int c;
+
+   while ((c = get_byte()) >= 0) {
+      switch (c) {
+      case REC_COST:
+         put_pos();
+         put_costs();
+         break;
+      case REC_CALLS:
+         put_str("calls=");
+         put_num(get_num(), 10);
+         put_char(' ');
+         put_pos();
+         break;
+      case REC_POS:
+         put_pos();
+         break;
+      case REC_JUMP:
+         put_str("jump=");
+         put_num(get_num(), 10);
+         put_char(' ');
+         put_pos();
+         break;
+      case REC_JCND:
+         put_str("jcnd=");
+         put_num(get_num(), 10);
+         put_char('/');
+         put_num(get_num(), 10);
+         put_char(' ');
+         put_pos();
+         break;
+      default:
+         /* a line of text */
+         while (c != '\n') {
+            put_char(c);
+            c = get_byte();
+            if (c < 0) return;
+         }
+         break;
+      }
+      put_char('\n');
+   }
+}
+
+static void usage ( void )
+{
+   fprintf(stderr, "%s: Converts a callgrind output file in the binary "
+                   "format to the text format\n", argv0);
+   fprintf(stderr, "%s: usage: %s [-o outfile] file\n", argv0, argv0);
+   exit(1);
+}
+
+int main ( int argc, char** argv )
+{
+   char   magic[sizeof(BIN_MAGIC)-1];
+   size_t n, j;
+   Int    i;
+   const char* out_name = NULL;
+
+   for (i = 1; i < argc; i++) {
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         usage();
+      } else if (!strcmp(argv[i], "-o")) {
+         if (i+1 >= argc)
+            usage();
+         out_name = argv[++i];
+      } else if (in_name == NULL) {
+         in_name = argv[i];
+      } else {
+         usage();
+      }
+   }
+   if (in_name == NULL)
+      usage();
+
+   in_fp = fopen(in_name, "rb");
+   if (in_fp == NULL) {
+      fprintf(stderr, "%s: can't open '%s' for reading\n", argv0, in_name);
+      exit(1);
+   }
+   out_fp = stdout;
+   if (out_name) {
+      out_fp = fopen(out_name, "w");
+      if (out_fp == NULL) {
+         fprintf(stderr, "%s: can't open '%s' for writing\n",
+                 argv0, out_name);
+         exit(1);
+      }
+   }
+
+   n = fread(magic, 1, sizeof(magic), in_fp);
+   if (n == sizeof(magic) && !memcmp(magic, BIN_MAGIC, sizeof(magic))) {
+      convert();
+   }
+   else {
+      /* Not in the binary format: copy it */
+      Int c;
+      for (j = 0; j < n; j++)
+         put_char(magic[j]);
+      while ((c = getc(in_fp)) != EOF)
+         put_char(c);
+   }
+   flush_out();
+
+   if (out_fp != stdout && fclose(out_fp) != 0) {
+      fprintf(stderr, "%s: error writing '%s'\n", argv0, out_name);
+      exit(1);
+   }
+   return 0;
+}
+
+////////////////////////////////////////////////////
+#include "../coregrind/m_debuginfo/minilzo-inl.c"
+
+/*--------------------------------------------------------------------*/
+/*--- end                                      callgrind_convert.c ---*/
+/*--------------------------------------------------------------------*/
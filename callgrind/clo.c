@@ -427,6 +427,7 @@ Bool CLG_(process_cmd_line_option)(const HChar* arg)
    else if VG_BOOL_CLO(arg, "--compress-strings", CLG_(clo).compress_strings) {}
    else if VG_BOOL_CLO(arg, "--compress-mangled", CLG_(clo).compress_mangled) {}
    else if VG_BOOL_CLO(arg, "--compress-pos",     CLG_(clo).compress_pos) {}
+   else if VG_BOOL_CLO(arg, "--compress-binary",  CLG_(clo).compress_binary) {}
 
    else if VG_STR_CLO(arg, "--fn-skip", tmp_str) {
        fn_config* fnc = get_fnc(tmp_str);
@@ -511,6 +512,10 @@ Bool CLG_(process_cmd_line_option)(const HChar* arg)
    }
 
    else if VG_STR_CLO(arg, "--callgrind-out-file", CLG_(clo).out_format) {}
+   else if VG_XACT_CLO(arg, "--callgrind-out-format=text",
+                            CLG_(clo).binary_out, False) {}
+   else if VG_XACT_CLO(arg, "--callgrind-out-format=binary",
+                            CLG_(clo).binary_out, True) {}
 
    else if VG_BOOL_CLO(arg, "--mangle-names", CLG_(clo).mangle_names) {}
 
@@ -555,6 +560,8 @@ void CLG_(print_usage)(void)
 "    --dump-instr=no|yes       Dump instruction address of costs? [no]\n"
 "    --compress-strings=no|yes Compress strings in profile dump? [yes]\n"
 "    --compress-pos=no|yes     Compress positions in profile dump? [yes]\n"
+"    --callgrind-out-format=text|binary  Format of profile dump [text]\n"
+"    --compress-binary=no|yes  LZO-compress binary profile dump? [yes]\n"
 "    --combine-dumps=no|yes    Concat all dumps into same file [no]\n"
 #if CLG_EXPERIMENTAL
 "    --compress-events=no|yes  Compress events in profile dump? [no]\n"
@@ -635,6 +642,8 @@ void CLG_(set_clo_defaults)(void)
   CLG_(clo).compress_mangled = False;
   CLG_(clo).compress_events  = False;
   CLG_(clo).compress_pos     = True;
+  CLG_(clo).binary_out       = False;
+  CLG_(clo).compress_binary  = True;
   CLG_(clo).mangle_names     = True;
   CLG_(clo).dump_line        = True;
   CLG_(clo).dump_instr       = False;
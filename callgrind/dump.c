@@ -55,6 +55,163 @@ Int CLG_(get_dump_counter)(void)
   return out_counter;
 }
 
+/*------------------------------------------------------------*/
+/*--- Dump files                                           ---*/
+/*------------------------------------------------------------*/
+
+/* With --callgrind-out-format=binary, a dump starts with the line
+ * BIN_MAGIC (unless it is appended to a previous one) and is then a
+ * sequence of blocks, each holding the lengths of its data before and
+ * after compression as 32-bit little-endian words, and the data.  If the
+ * two lengths are equal, the data is not compressed; otherwise it is
+ * compressed with LZO1X-1.  The data of all blocks together is the text
+ * format, except that the lines with positions and costs, which make up
+ * nearly all of a dump, are replaced by records.  A record starts with
+ * one of the REC_ bytes, which no text line starts with, followed by
+ * LEB128-encoded numbers.  callgrind_convert turns such a file back into
+ * exactly the text which would have been written.
+ */
+#define BIN_MAGIC       "# callgrind binary format 1\n"
+#define BIN_BLOCK_SIZE  (1 << 18)               /* flush when this full */
+#define BIN_BUF_SIZE    (2 * BIN_BLOCK_SIZE)
+
+/* The records, and the text line each one stands for */
+#define REC_COST   1  /* <pos> <n> <cost>*n       "<pos> <cost> ...\n"   */
+#define REC_CALLS  2  /* <calls> <pos>            "calls=<calls> <pos>\n" */
+#define REC_POS    3  /* <pos>                    "<pos>\n"               */
+#define REC_JUMP   4  /* <jumps> <pos>            "jump=<jumps> <pos>\n"  */
+#define REC_JCND   5  /* <followed> <execs> <pos>
+                                         "jcnd=<followed>/<execs> <pos>\n" */
+
+/* A <pos> is the number of its parts, followed by the parts.  The low
+ * two bits of each say how it is printed, the rest are its value, except
+ * that the value of an address follows as a number of its own.
+ */
+#define POS_HEX   0   /* an address, "%#lx "                              */
+#define POS_DEC   1   /* a line number, "%u "                             */
+#define POS_DIFF  2   /* a zigzag-encoded difference, "+%d ", "* " or "%d " */
+
+struct _DumpFile {
+    VgFile* vgf;      /* text format: where to write, else NULL */
+    Int     fd;       /* binary format: where to write */
+    UChar*  buf;      /* binary format: the data of the current block */
+    Int     used;
+    UChar*  zbuf;     /* binary format: for compressing it */
+};
+
+static DumpFile* open_dumpfile(const HChar* name, Int flags, Int mode)
+{
+    DumpFile* fp;
+
+    if (!CLG_(clo).binary_out) {
+	VgFile* vgf = VG_(fopen)(name, flags, mode);
+	if (vgf == NULL) return NULL;
+	fp = (DumpFile*) CLG_MALLOC("cl.dump.od.1", sizeof(DumpFile));
+	fp->vgf  = vgf;
+	fp->buf  = 0;
+	fp->zbuf = 0;
+    }
+    else {
+	SysRes res = VG_(open)(name, flags, mode);
+	if (sr_isError(res)) return NULL;
+	fp = (DumpFile*) CLG_MALLOC("cl.dump.od.1", sizeof(DumpFile));
+	fp->vgf  = NULL;
+	fp->fd   = sr_Res(res);
+	fp->buf  = (UChar*) CLG_MALLOC("cl.dump.od.2", BIN_BUF_SIZE);
+	fp->zbuf = CLG_(clo).compress_binary ?
+	    (UChar*) CLG_MALLOC("cl.dump.od.3",
+				VG_LZO_MAX_COMPRESSED(BIN_BUF_SIZE)) : 0;
+    }
+    fp->used = 0;
+    return fp;
+}
+
+static void put_le32(UChar* p, UInt n)
+{
+    p[0] = n; p[1] = n >> 8; p[2] = n >> 16; p[3] = n >> 24;
+}
+
+static void flush_block(DumpFile *fp)
+{
+    UChar hdr[8];
+    const UChar* data = fp->buf;
+    UInt len = fp->used, zlen = len;
+
+    if (len == 0) return;
+    if (fp->zbuf) {
+	zlen = VG_(lzo_compress)(fp->zbuf, fp->buf, len);
+	if (zlen < len)
+	    data = fp->zbuf;
+	else
+	    zlen = len;
+    }
+    put_le32(hdr, len);
+    put_le32(hdr+4, zlen);
+    VG_(write)(fp->fd, hdr, 8);
+    VG_(write)(fp->fd, data, zlen);
+    fp->used = 0;
+}
+
+static void close_file(DumpFile *fp)
+{
+    if (fp->vgf)
+	VG_(fclose)(fp->vgf);
+    else {
+	flush_block(fp);
+	VG_(close)(fp->fd);
+	VG_(free)(fp->buf);
+	if (fp->zbuf) VG_(free)(fp->zbuf);
+    }
+    VG_(free)(fp);
+}
+
+static void add_to_block(HChar c, void* opaque)
+{
+    DumpFile *fp = (DumpFile*) opaque;
+
+    fp->buf[fp->used++] = c;
+    if (fp->used == BIN_BUF_SIZE) flush_block(fp);
+}
+
+void CLG_(dump_printf)(DumpFile *fp, const HChar *format, ...)
+{
+    va_list vargs;
+
+    va_start(vargs, format);
+    if (fp->vgf)
+	VG_(vfprintf)(fp->vgf, format, vargs);
+    else {
+	VG_(vcbprintf)(add_to_block, fp, format, vargs);
+	if (fp->used >= BIN_BLOCK_SIZE) flush_block(fp);
+    }
+    va_end(vargs);
+}
+
+static __inline__
+void put_num(DumpFile *fp, ULong n)
+{
+    while (n >= 0x80) {
+	fp->buf[fp->used++] = (n & 0x7f) | 0x80;
+	n >>= 7;
+    }
+    fp->buf[fp->used++] = n;
+}
+
+/* Starts a record in the binary format; nothing to do for text */
+static void start_record(DumpFile *fp, UChar rec)
+{
+    if (fp->vgf) return;
+    if (fp->used >= BIN_BLOCK_SIZE) flush_block(fp);
+    fp->buf[fp->used++] = rec;
+}
+
+/* Ends a line, which in the binary format is implied by the record */
+static void end_line(DumpFile *fp)
+{
+    if (fp->vgf)
+	VG_(fprintf)(fp->vgf, "\n");
+}
+
 /*------------------------------------------------------------*/
 /*--- Output file related stuff                            ---*/
 /*------------------------------------------------------------*/
@@ -124,25 +281,25 @@ void init_fpos(FnPos* p)
 }
 
 
-static void print_obj(VgFile *fp, const HChar* prefix, obj_node* obj)
+static void print_obj(DumpFile *fp, const HChar* prefix, obj_node* obj)
 {
     if (CLG_(clo).compress_strings) {
 	CLG_ASSERT(obj_dumped != 0);
 	if (obj_dumped[obj->number])
-            VG_(fprintf)(fp, "%s(%u)\n", prefix, obj->number);
+            CLG_(dump_printf)(fp, "%s(%u)\n", prefix, obj->number);
 	else {
-            VG_(fprintf)(fp, "%s(%u) %s\n", prefix, obj->number, obj->name);
+            CLG_(dump_printf)(fp, "%s(%u) %s\n", prefix, obj->number, obj->name);
 	}
     }
     else
-        VG_(fprintf)(fp, "%s%s\n", prefix, obj->name);
+        CLG_(dump_printf)(fp, "%s%s\n", prefix, obj->name);
 
 #if 0
     /* add mapping parameters the first time a object is dumped
      * format: mp=0xSTART SIZE 0xOFFSET */
     if (!obj_dumped[obj->number]) {
 	obj_dumped[obj->number];
-	VG_(fprintf)(fp, "mp=%p %p %p\n",
+	CLG_(dump_printf)(fp, "mp=%p %p %p\n",
 		     pos->obj->start, pos->obj->size, pos->obj->offset);
     }
 #else
@@ -150,41 +307,41 @@ static void print_obj(VgFile *fp, const HChar* prefix, obj_node* obj)
 #endif
 }
 
-static void print_file(VgFile *fp, const char *prefix, const file_node* file)
+static void print_file(DumpFile *fp, const char *prefix, const file_node* file)
 {
     if (CLG_(clo).compress_strings) {
 	CLG_ASSERT(file_dumped != 0);
 	if (file_dumped[file->number])
-            VG_(fprintf)(fp, "%s(%u)\n", prefix, file->number);
+            CLG_(dump_printf)(fp, "%s(%u)\n", prefix, file->number);
 	else {
-            VG_(fprintf)(fp, "%s(%u) %s\n", prefix, file->number, file->name);
+            CLG_(dump_printf)(fp, "%s(%u) %s\n", prefix, file->number, file->name);
 	    file_dumped[file->number] = True;
 	}
     }
     else
-        VG_(fprintf)(fp, "%s%s\n", prefix, file->name);
+        CLG_(dump_printf)(fp, "%s%s\n", prefix, file->name);
 }
 
 /*
  * tag can be "fn", "cfn", "jfn"
  */
-static void print_fn(VgFile *fp, const HChar* tag, const fn_node* fn)
+static void print_fn(DumpFile *fp, const HChar* tag, const fn_node* fn)
 {
-    VG_(fprintf)(fp, "%s=",tag);
+    CLG_(dump_printf)(fp, "%s=",tag);
     if (CLG_(clo).compress_strings) {
 	CLG_ASSERT(fn_dumped != 0);
 	if (fn_dumped[fn->number])
-	    VG_(fprintf)(fp, "(%u)\n", fn->number);
+	    CLG_(dump_printf)(fp, "(%u)\n", fn->number);
 	else {
-	    VG_(fprintf)(fp, "(%u) %s\n", fn->number, fn->name);
+	    CLG_(dump_printf)(fp, "(%u) %s\n", fn->number, fn->name);
 	    fn_dumped[fn->number] = True;
 	}
     }
     else
-        VG_(fprintf)(fp, "%s\n", fn->name);
+        CLG_(dump_printf)(fp, "%s\n", fn->name);
 }
 
-static void print_mangled_fn(VgFile *fp, const HChar* tag, 
+static void print_mangled_fn(DumpFile *fp, const HChar* tag, 
 			     Context* cxt, int rec_index)
 {
     int i;
@@ -196,7 +353,7 @@ static void print_mangled_fn(VgFile *fp, const HChar* tag,
 
 	CLG_ASSERT(cxt_dumped != 0);
 	if (cxt_dumped[cxt->base_number+rec_index]) {
-            VG_(fprintf)(fp, "%s=(%u)\n",
+            CLG_(dump_printf)(fp, "%s=(%u)\n",
 			     tag, cxt->base_number + rec_index);
 	    return;
 	}
@@ -207,7 +364,7 @@ static void print_mangled_fn(VgFile *fp, const HChar* tag,
 	    CLG_ASSERT(cxt->fn[i-1]->pure_cxt != 0);
 	    n = cxt->fn[i-1]->pure_cxt->base_number;
 	    if (cxt_dumped[n]) continue;
-	    VG_(fprintf)(fp, "%s=(%d) %s\n",
+	    CLG_(dump_printf)(fp, "%s=(%d) %s\n",
 			     tag, n, cxt->fn[i-1]->name);
 
 	    cxt_dumped[n] = True;
@@ -216,41 +373,41 @@ static void print_mangled_fn(VgFile *fp, const HChar* tag,
 	/* If the last context was the context to print, we are finished */
 	if ((last == cxt) && (rec_index == 0)) return;
 
-	VG_(fprintf)(fp, "%s=(%u) (%u)", tag,
+	CLG_(dump_printf)(fp, "%s=(%u) (%u)", tag,
 			 cxt->base_number + rec_index,
 			 cxt->fn[0]->pure_cxt->base_number);
 	if (rec_index >0)
-	    VG_(fprintf)(fp, "'%d", rec_index +1);
+	    CLG_(dump_printf)(fp, "'%d", rec_index +1);
 	for(i=1;i<cxt->size;i++)
-	    VG_(fprintf)(fp, "'(%u)", 
+	    CLG_(dump_printf)(fp, "'(%u)", 
 			      cxt->fn[i]->pure_cxt->base_number);
-	VG_(fprintf)(fp, "\n");
+	CLG_(dump_printf)(fp, "\n");
 
 	cxt_dumped[cxt->base_number+rec_index] = True;
 	return;
     }
 
 
-    VG_(fprintf)(fp, "%s=", tag);
+    CLG_(dump_printf)(fp, "%s=", tag);
     if (CLG_(clo).compress_strings) {
 	CLG_ASSERT(cxt_dumped != 0);
 	if (cxt_dumped[cxt->base_number+rec_index]) {
-	    VG_(fprintf)(fp, "(%u)\n", cxt->base_number + rec_index);
+	    CLG_(dump_printf)(fp, "(%u)\n", cxt->base_number + rec_index);
 	    return;
 	}
 	else {
-	    VG_(fprintf)(fp, "(%u) ", cxt->base_number + rec_index);
+	    CLG_(dump_printf)(fp, "(%u) ", cxt->base_number + rec_index);
 	    cxt_dumped[cxt->base_number+rec_index] = True;
 	}
     }
 
-    VG_(fprintf)(fp, "%s", cxt->fn[0]->name);
+    CLG_(dump_printf)(fp, "%s", cxt->fn[0]->name);
     if (rec_index >0)
-	VG_(fprintf)(fp, "'%d", rec_index +1);
+	CLG_(dump_printf)(fp, "'%d", rec_index +1);
     for(i=1;i<cxt->size;i++)
-	VG_(fprintf)(fp, "'%s", cxt->fn[i]->name);
+	CLG_(dump_printf)(fp, "'%s", cxt->fn[i]->name);
 
-    VG_(fprintf)(fp, "\n");
+    CLG_(dump_printf)(fp, "\n");
 }
 
 
@@ -260,7 +417,7 @@ static void print_mangled_fn(VgFile *fp, const HChar* tag,
  * the <last> position, update <last>
  * Return True if something changes.
  */
-static Bool print_fn_pos(VgFile *fp, FnPos* last, BBCC* bbcc)
+static Bool print_fn_pos(DumpFile *fp, FnPos* last, BBCC* bbcc)
 {
     Bool res = False;
 
@@ -273,7 +430,7 @@ static Bool print_fn_pos(VgFile *fp, FnPos* last, BBCC* bbcc)
 
     if (!CLG_(clo).mangle_names) {
 	if (last->rec_index != bbcc->rec_index) {
-	    VG_(fprintf)(fp, "rec=%u\n\n", bbcc->rec_index);
+	    CLG_(dump_printf)(fp, "rec=%u\n\n", bbcc->rec_index);
 	    last->rec_index = bbcc->rec_index;
 	    last->cxt = 0; /* reprint context */
 	    res = True;
@@ -287,7 +444,7 @@ static Bool print_fn_pos(VgFile *fp, FnPos* last, BBCC* bbcc)
 	    if (curr_from == 0) {
 		if (last_from != 0) {
 		    /* switch back to no context */
-		    VG_(fprintf)(fp, "frfn=(spontaneous)\n");
+		    CLG_(dump_printf)(fp, "frfn=(spontaneous)\n");
 		    res = True;
 		}
 	    }
@@ -433,7 +590,7 @@ static void init_fcost(AddrCost* c, Addr addr, Addr bbaddr, file_node* file)
  * print position change inside of a BB (last -> curr)
  * this doesn't update last to curr!
  */
-static void fprint_apos(VgFile *fp, AddrPos* curr, AddrPos* last,
+static void fprint_apos(DumpFile *fp, AddrPos* curr, AddrPos* last,
                         file_node* func_file)
 {
     CLG_ASSERT(curr->file != 0);
@@ -452,13 +609,49 @@ static void fprint_apos(VgFile *fp, AddrPos* curr, AddrPos* last,
 
     if (CLG_(clo).dump_bbs) {
 	if (curr->line != last->line) {
-	    VG_(fprintf)(fp, "ln=%u\n", curr->line);
+	    CLG_(dump_printf)(fp, "ln=%u\n", curr->line);
 	}
     }
 }
 
 
 
+/**
+ * Print one part of a position: an address (is_line False) or a line
+ * number, as a difference to the last one if allowed.
+ */
+static __inline__
+void fprint_pos_part(DumpFile *fp, ULong curr, ULong last, Bool is_line)
+{
+    int diff = curr - last;
+    if ( CLG_(clo).compress_pos && (last >0) &&
+	 (diff > -100) && (diff < 100)) {
+	if (!fp->vgf)
+	    put_num(fp, (ULong)(((UInt)diff << 1) ^ (UInt)(diff >> 31)) << 2
+			| POS_DIFF);
+	else if (diff >0)
+	    VG_(fprintf)(fp->vgf, "+%d ", diff);
+	else if (diff==0)
+	    VG_(fprintf)(fp->vgf, "* ");
+	else
+	    VG_(fprintf)(fp->vgf, "%d ", diff);
+    }
+    else if (is_line) {
+	if (!fp->vgf)
+	    put_num(fp, (curr << 2) | POS_DEC);
+	else
+	    VG_(fprintf)(fp->vgf, "%u ", (UInt)curr);
+    }
+    else {
+	if (!fp->vgf) {
+	    put_num(fp, POS_HEX);
+	    put_num(fp, curr);
+	}
+	else
+	    VG_(fprintf)(fp->vgf, "%#lx ", (Addr)curr);
+    }
+}
+
 /**
  * Print a position.
  * This prints out differences if allowed
@@ -466,70 +659,49 @@ static void fprint_apos(VgFile *fp, AddrPos* curr, AddrPos* last,
  * This doesn't set last to curr afterwards!
  */
 static
-void fprint_pos(VgFile *fp, const AddrPos* curr, const AddrPos* last)
+void fprint_pos(DumpFile *fp, const AddrPos* curr, const AddrPos* last)
 {
-    if (0) //CLG_(clo).dump_bbs)
-	VG_(fprintf)(fp, "%lu ", curr->addr - curr->bb_addr);
-    else {
-	if (CLG_(clo).dump_instr) {
-	    int diff = curr->addr - last->addr;
-	    if ( CLG_(clo).compress_pos && (last->addr >0) && 
-		 (diff > -100) && (diff < 100)) {
-		if (diff >0)
-		    VG_(fprintf)(fp, "+%d ", diff);
-		else if (diff==0)
-		    VG_(fprintf)(fp, "* ");
-	        else
-		    VG_(fprintf)(fp, "%d ", diff);
-	    }
-	    else
-		VG_(fprintf)(fp, "%#lx ", curr->addr);
-	}
+    if (!fp->vgf)
+	put_num(fp, CLG_(clo).dump_instr + CLG_(clo).dump_bb +
+		    CLG_(clo).dump_line);
 
-	if (CLG_(clo).dump_bb) {
-	    int diff = curr->bb_addr - last->bb_addr;
-	    if ( CLG_(clo).compress_pos && (last->bb_addr >0) && 
-		 (diff > -100) && (diff < 100)) {
-		if (diff >0)
-		    VG_(fprintf)(fp, "+%d ", diff);
-		else if (diff==0)
-		    VG_(fprintf)(fp, "* ");
-	        else
-		    VG_(fprintf)(fp, "%d ", diff);
-	    }
-	    else
-		VG_(fprintf)(fp, "%#lx ", curr->bb_addr);
-	}
+    if (CLG_(clo).dump_instr)
+	fprint_pos_part(fp, curr->addr, last->addr, False);
 
-	if (CLG_(clo).dump_line) {
-	    int diff = curr->line - last->line;
-	    if ( CLG_(clo).compress_pos && (last->line >0) && 
-		 (diff > -100) && (diff < 100)) {
-
-		if (diff >0)
-		    VG_(fprintf)(fp, "+%d ", diff);
-		else if (diff==0)
-		    VG_(fprintf)(fp, "* ");
-	        else
-		    VG_(fprintf)(fp, "%d ", diff);
-	    }
-	    else
-		VG_(fprintf)(fp, "%u ", curr->line);
-	}
-    }
+    if (CLG_(clo).dump_bb)
+	fprint_pos_part(fp, curr->bb_addr, last->bb_addr, False);
+
+    if (CLG_(clo).dump_line)
+	fprint_pos_part(fp, curr->line, last->line, True);
 }
 
 
 /**
- * Print events.
+ * Print events, ending the line.
+ * As with CLG_(mappingcost_as_string), zero costs at the end are left out.
  */
 
 static
-void fprint_cost(VgFile *fp, const EventMapping* es, const ULong* cost)
+void fprint_cost(DumpFile *fp, const EventMapping* es, const ULong* cost)
 {
-  HChar *mcost = CLG_(mappingcost_as_string)(es, cost);
-  VG_(fprintf)(fp, "%s\n", mcost);
-  CLG_FREE(mcost);
+  Int i, n = 0;
+
+  if (cost && es->size > 0) {
+    n = 1;
+    for(i=1; i<es->size; i++)
+      if (cost[es->entry[i].offset] != 0) n = i+1;
+  }
+
+  if (!fp->vgf) {
+    put_num(fp, n);
+    for(i=0; i<n; i++)
+      put_num(fp, cost[es->entry[i].offset]);
+    return;
+  }
+
+  for(i=0; i<n; i++)
+    VG_(fprintf)(fp->vgf, i ? " %llu" : "%llu", cost[es->entry[i].offset]);
+  VG_(fprintf)(fp->vgf, "\n");
 }
 
 
@@ -539,7 +711,7 @@ void fprint_cost(VgFile *fp, const EventMapping* es, const ULong* cost)
  * funcPos is the source position of the first line of actual function.
  * Something is written only if cost != 0; returns True in this case.
  */
-static void fprint_fcost(VgFile *fp, AddrCost* c, AddrPos* last)
+static void fprint_fcost(DumpFile *fp, AddrCost* c, AddrPos* last)
 {
   CLG_DEBUGIF(3) {
     CLG_DEBUG(2, "   print_fcost(file '%s', line %u, bb %#lx, addr %#lx):\n",
@@ -547,6 +719,7 @@ static void fprint_fcost(VgFile *fp, AddrCost* c, AddrPos* last)
     CLG_(print_cost)(-5, CLG_(sets).full, c->cost);
   }
     
+  start_record(fp, REC_COST);
   fprint_pos(fp, &(c->p), last);
   copy_apos( last, &(c->p) ); /* update last to current position */
 
@@ -559,7 +732,7 @@ static void fprint_fcost(VgFile *fp, AddrCost* c, AddrPos* last)
 
 /* Write out the calls from jcc (at pos)
  */
-static void fprint_jcc(VgFile *fp, jCC* jcc, AddrPos* curr, AddrPos* last,
+static void fprint_jcc(DumpFile *fp, jCC* jcc, AddrPos* curr, AddrPos* last,
                        ULong ecounter)
 {
     static AddrPos target;
@@ -611,21 +784,33 @@ static void fprint_jcc(VgFile *fp, jCC* jcc, AddrPos* curr, AddrPos* last,
 		print_fn(fp, "jfn", jcc->to->cxt->fn[0]);
 	}
 	    
-	if (jcc->jmpkind == jk_CondJump) {
+	if (!fp->vgf) {
+	    if (jcc->jmpkind == jk_CondJump) {
+		start_record(fp, REC_JCND);
+		put_num(fp, jcc->call_counter);
+		put_num(fp, ecounter);
+	    }
+	    else {
+		start_record(fp, REC_JUMP);
+		put_num(fp, jcc->call_counter);
+	    }
+	}
+	else if (jcc->jmpkind == jk_CondJump) {
 	    /* format: jcnd=<followed>/<executions> <target> */
-	    VG_(fprintf)(fp, "jcnd=%llu/%llu ",
+	    VG_(fprintf)(fp->vgf, "jcnd=%llu/%llu ",
 			 jcc->call_counter, ecounter);
 	}
 	else {
 	    /* format: jump=<jump count> <target> */
-	    VG_(fprintf)(fp, "jump=%llu ",
+	    VG_(fprintf)(fp->vgf, "jump=%llu ",
 			 jcc->call_counter);
 	}
 		
 	fprint_pos(fp, &target, last);
-	VG_(fprintf)(fp, "\n");
+	end_line(fp);
+	start_record(fp, REC_POS);
 	fprint_pos(fp, curr, last);
-	VG_(fprintf)(fp, "\n");
+	end_line(fp);
 
 	jcc->call_counter = 0;
 	return;
@@ -650,11 +835,17 @@ static void fprint_jcc(VgFile *fp, jCC* jcc, AddrPos* curr, AddrPos* last,
 	print_fn(fp, "cfn", jcc->to->cxt->fn[0]);
 
     if (!CLG_(is_zero_cost)( CLG_(sets).full, jcc->cost)) {
-        VG_(fprintf)(fp, "calls=%llu ", 
-		   jcc->call_counter);
+	if (!fp->vgf) {
+	    start_record(fp, REC_CALLS);
+	    put_num(fp, jcc->call_counter);
+	}
+	else
+	    VG_(fprintf)(fp->vgf, "calls=%llu ",
+			 jcc->call_counter);
 
 	fprint_pos(fp, &target, last);
-        VG_(fprintf)(fp, "\n");
+	end_line(fp);
+	start_record(fp, REC_COST);
 	fprint_pos(fp, curr, last);
 	fprint_cost(fp, CLG_(dumpmap), jcc->cost);
 
@@ -678,7 +869,7 @@ static int currSum;
  * - JCCs of the unique jump of this BB
  * returns True if something was written 
  */
-static Bool fprint_bbcc(VgFile *fp, BBCC* bbcc, AddrPos* last)
+static Bool fprint_bbcc(DumpFile *fp, BBCC* bbcc, AddrPos* last)
 {
   InstrInfo* instr_info;
   ULong ecounter;
@@ -794,7 +985,7 @@ static Bool fprint_bbcc(VgFile *fp, BBCC* bbcc, AddrPos* last)
       CLG_(add_and_zero_cost)( CLG_(sets).full,
 			      currCost->cost, bbcc->skipped );
 #if 0
-      VG_(fprintf)(fp, "# Skipped\n");
+      CLG_(dump_printf)(fp, "# Skipped\n");
 #endif
       fprint_fcost(fp, currCost, last);
     }
@@ -816,7 +1007,7 @@ static Bool fprint_bbcc(VgFile *fp, BBCC* bbcc, AddrPos* last)
       fprint_apos(fp, &(currCost->p), last, bbcc->cxt->fn[0]->file);
       fprint_fcost(fp, currCost, last);
     }
-    if (CLG_(clo).dump_bbs) VG_(fprintf)(fp, "\n");
+    if (CLG_(clo).dump_bbs) CLG_(dump_printf)(fp, "\n");
     
     /* when every cost was immediately written, we must have done so,
      * as this function is only called when there's cost in a BBCC
@@ -1142,11 +1333,11 @@ BBCC** prepare_dump(void)
 
 
 
-static void fprint_cost_ln(VgFile *fp, const HChar* prefix,
+static void fprint_cost_ln(DumpFile *fp, const HChar* prefix,
 			   const EventMapping* em, const ULong* cost)
 {
     HChar *mcost = CLG_(mappingcost_as_string)(em, cost);
-    VG_(fprintf)(fp, "%s%s\n", prefix, mcost);
+    CLG_(dump_printf)(fp, "%s%s\n", prefix, mcost);
     CLG_FREE(mcost);
 }
 
@@ -1171,12 +1362,12 @@ void file_err(void)
  *
  * Returns the file descriptor, and -1 on error (no write permission)
  */
-static VgFile *new_dumpfile(int tid, const HChar* trigger)
+static DumpFile *new_dumpfile(int tid, const HChar* trigger)
 {
     Bool appending = False;
     int i;
     FullCost sum = 0;
-    VgFile *fp;
+    DumpFile *fp;
 
     CLG_ASSERT(dumps_initialized);
     CLG_ASSERT(filename != 0);
@@ -1190,18 +1381,18 @@ static VgFile *new_dumpfile(int tid, const HChar* trigger)
 	if (CLG_(clo).separate_threads)
 	    VG_(sprintf)(filename+i, "-%02d", tid);
 
-	fp = VG_(fopen)(filename, VKI_O_WRONLY|VKI_O_TRUNC, 0);
+	fp = open_dumpfile(filename, VKI_O_WRONLY|VKI_O_TRUNC, 0);
     }
     else {
 	VG_(sprintf)(filename, "%s", out_file);
-        fp = VG_(fopen)(filename, VKI_O_WRONLY|VKI_O_APPEND, 0);
+        fp = open_dumpfile(filename, VKI_O_WRONLY|VKI_O_APPEND, 0);
 	if (fp && out_counter>1)
 	    appending = True;
     }
 
     if (fp == NULL) {
-	fp = VG_(fopen)(filename, VKI_O_CREAT|VKI_O_WRONLY,
-                        VKI_S_IRUSR|VKI_S_IWUSR);
+	fp = open_dumpfile(filename, VKI_O_CREAT|VKI_O_WRONLY,
+                           VKI_S_IRUSR|VKI_S_IWUSR);
 	if (fp == NULL) {
 	    /* If the file can not be opened for whatever reason (conflict
 	       between multiple supervised processes?), give up now. */
@@ -1216,55 +1407,59 @@ static VgFile *new_dumpfile(int tid, const HChar* trigger)
 
 
     if (!appending) {
+	/* the binary format is marked by a line of its own before */
+	if (!fp->vgf)
+	    VG_(write)(fp->fd, BIN_MAGIC, sizeof(BIN_MAGIC)-1);
+
 	/* callgrind format specification, has to be on 1st line */
-	VG_(fprintf)(fp, "# callgrind format\n");
+	CLG_(dump_printf)(fp, "# callgrind format\n");
 
 	/* version */
-	VG_(fprintf)(fp, "version: 1\n");
+	CLG_(dump_printf)(fp, "version: 1\n");
 
 	/* creator */
-	VG_(fprintf)(fp, "creator: callgrind-" VERSION "\n");
+	CLG_(dump_printf)(fp, "creator: callgrind-" VERSION "\n");
 
 	/* "pid:" line */
-	VG_(fprintf)(fp, "pid: %d\n", VG_(getpid)());
+	CLG_(dump_printf)(fp, "pid: %d\n", VG_(getpid)());
 
 	/* "cmd:" line */
-	VG_(fprintf)(fp, "cmd: %s", cmdbuf);
+	CLG_(dump_printf)(fp, "cmd: %s", cmdbuf);
     }
 
-    VG_(fprintf)(fp, "\npart: %d\n", out_counter);
+    CLG_(dump_printf)(fp, "\npart: %d\n", out_counter);
     if (CLG_(clo).separate_threads) {
-	VG_(fprintf)(fp, "thread: %d\n", tid);
+	CLG_(dump_printf)(fp, "thread: %d\n", tid);
     }
 
     /* "desc:" lines */
     if (!appending) {
-        VG_(fprintf)(fp, "\n");
+        CLG_(dump_printf)(fp, "\n");
 
 #if 0
 	/* Global options changing the tracing behaviour */
-	VG_(fprintf)(fp, "\ndesc: Option: --skip-plt=%s\n",
+	CLG_(dump_printf)(fp, "\ndesc: Option: --skip-plt=%s\n",
 		     CLG_(clo).skip_plt ? "yes" : "no");
-	VG_(fprintf)(fp, "desc: Option: --collect-jumps=%s\n",
+	CLG_(dump_printf)(fp, "desc: Option: --collect-jumps=%s\n",
 		     CLG_(clo).collect_jumps ? "yes" : "no");
-	VG_(fprintf)(fp, "desc: Option: --separate-recs=%d\n",
+	CLG_(dump_printf)(fp, "desc: Option: --separate-recs=%d\n",
 		     CLG_(clo).separate_recursions);
-	VG_(fprintf)(fp, "desc: Option: --separate-callers=%d\n",
+	CLG_(dump_printf)(fp, "desc: Option: --separate-callers=%d\n",
 		     CLG_(clo).separate_callers);
 
-	VG_(fprintf)(fp, "desc: Option: --dump-bbs=%s\n",
+	CLG_(dump_printf)(fp, "desc: Option: --dump-bbs=%s\n",
 		     CLG_(clo).dump_bbs ? "yes" : "no");
-	VG_(fprintf)(fp, "desc: Option: --separate-threads=%s\n",
+	CLG_(dump_printf)(fp, "desc: Option: --separate-threads=%s\n",
 		     CLG_(clo).separate_threads ? "yes" : "no");
 #endif
 
 	(*CLG_(cachesim).dump_desc)(fp);
     }
 
-    VG_(fprintf)(fp, "\ndesc: Timerange: Basic block %llu - %llu\n",
+    CLG_(dump_printf)(fp, "\ndesc: Timerange: Basic block %llu - %llu\n",
 		 bbs_done, CLG_(stat).bb_executions);
 
-    VG_(fprintf)(fp, "desc: Trigger: %s\n",
+    CLG_(dump_printf)(fp, "desc: Trigger: %s\n",
 		 trigger ? trigger : "Program termination");
 
 #if 0
@@ -1274,22 +1469,22 @@ static VgFile *new_dumpfile(int tid, const HChar* trigger)
        fnc = fnc_table[i];
        while (fnc) {
 	   if (fnc->skip) {
-	       VG_(fprintf)(fp, "desc: Option: --fn-skip=%s\n", fnc->name);
+	       CLG_(dump_printf)(fp, "desc: Option: --fn-skip=%s\n", fnc->name);
 	   }
 	   if (fnc->dump_at_enter) {
-	       VG_(fprintf)(fp, "desc: Option: --fn-dump-at-enter=%s\n",
+	       CLG_(dump_printf)(fp, "desc: Option: --fn-dump-at-enter=%s\n",
 			    fnc->name);
 	   }   
 	   if (fnc->dump_at_leave) {
-	       VG_(fprintf)(fp, "desc: Option: --fn-dump-at-leave=%s\n",
+	       CLG_(dump_printf)(fp, "desc: Option: --fn-dump-at-leave=%s\n",
 			    fnc->name);
 	   }
 	   if (fnc->separate_callers != CLG_(clo).separate_callers) {
-	       VG_(fprintf)(fp, "desc: Option: --separate-callers%d=%s\n",
+	       CLG_(dump_printf)(fp, "desc: Option: --separate-callers%d=%s\n",
 			    fnc->separate_callers, fnc->name);
 	   }   
 	   if (fnc->separate_recursions != CLG_(clo).separate_recursions) {
-	       VG_(fprintf)(fp, "desc: Option: --separate-recs%d=%s\n",
+	       CLG_(dump_printf)(fp, "desc: Option: --separate-recs%d=%s\n",
 			    fnc->separate_recursions, fnc->name);
 	   }   
 	   fnc = fnc->next;
@@ -1298,14 +1493,14 @@ static VgFile *new_dumpfile(int tid, const HChar* trigger)
 #endif
 
    /* "positions:" line */
-   VG_(fprintf)(fp, "\npositions:%s%s%s\n",
+   CLG_(dump_printf)(fp, "\npositions:%s%s%s\n",
 		CLG_(clo).dump_instr ? " instr" : "",
 		CLG_(clo).dump_bb    ? " bb" : "",
 		CLG_(clo).dump_line  ? " line" : "");
 
    /* "events:" line */
    HChar *evmap = CLG_(eventmapping_as_string)(CLG_(dumpmap));
-   VG_(fprintf)(fp, "events: %s\n", evmap);
+   CLG_(dump_printf)(fp, "events: %s\n", evmap);
    VG_(free)(evmap);
 
    /* summary lines */
@@ -1335,7 +1530,7 @@ static VgFile *new_dumpfile(int tid, const HChar* trigger)
    /* all dumped cost will be added to total_fcc */
    CLG_(init_cost_lz)( CLG_(sets).full, &dump_total_cost );
 
-   VG_(fprintf)(fp, "\n\n");
+   CLG_(dump_printf)(fp, "\n\n");
 
    if (VG_(clo_verbosity) > 1)
        VG_(message)(Vg_DebugMsg, "Dump to %s\n", filename);
@@ -1344,7 +1539,7 @@ static VgFile *new_dumpfile(int tid, const HChar* trigger)
 }
 
 
-static void close_dumpfile(VgFile *fp)
+static void close_dumpfile(DumpFile *fp)
 {
     if (fp == NULL) return;
 
@@ -1354,7 +1549,7 @@ static void close_dumpfile(VgFile *fp)
     CLG_(add_cost_lz)(CLG_(sets).full, 
 		     &CLG_(total_cost), dump_total_cost);
 
-    VG_(fclose)(fp);
+    close_file(fp);
 
     if (filename[0] == '.') {
 	if (-1 == VG_(rename) (filename, filename+1)) {
@@ -1378,7 +1573,7 @@ static void print_bbccs_of_thread(thread_info* ti)
 
   CLG_DEBUG(1, "+ print_bbccs(tid %u)\n", CLG_(current_tid));
 
-  VgFile *print_fp = new_dumpfile(CLG_(current_tid), print_trigger);
+  DumpFile *print_fp = new_dumpfile(CLG_(current_tid), print_trigger);
   if (print_fp == NULL) {
     CLG_DEBUG(1, "- print_bbccs(tid %u): No output...\n", CLG_(current_tid));
     return;
@@ -1405,7 +1600,7 @@ static void print_bbccs_of_thread(thread_info* ti)
 	/* switch back to file of function */
 	print_file(print_fp, "fe=", lastFnPos.cxt->fn[0]->file);
       }
-      VG_(fprintf)(print_fp, "\n");
+      CLG_(dump_printf)(print_fp, "\n");
     }
     
     if (*p == 0) break;
@@ -1423,14 +1618,14 @@ static void print_bbccs_of_thread(thread_info* ti)
 	/* FIXME: Specify Object of BB if different to object of fn */
         int i;
 	ULong ecounter = (*p)->ecounter_sum;
-        VG_(fprintf)(print_fp, "bb=%#lx ", (UWord)(*p)->bb->offset);
+        CLG_(dump_printf)(print_fp, "bb=%#lx ", (UWord)(*p)->bb->offset);
 	for(i = 0; i<(*p)->bb->cjmp_count;i++) {
-	    VG_(fprintf)(print_fp, "%u %llu ", 
+	    CLG_(dump_printf)(print_fp, "%u %llu ", 
 				(*p)->bb->jmp[i].instr,
 				ecounter);
 	    ecounter -= (*p)->jmp[i].ecounter;
 	}
-	VG_(fprintf)(print_fp, "%u %llu\n", 
+	CLG_(dump_printf)(print_fp, "%u %llu\n", 
 		     (*p)->bb->instr_count,
 		     ecounter);
     }
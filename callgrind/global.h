@@ -81,6 +81,8 @@ struct _CommandLineOptions {
   Bool compress_strings;
   Bool compress_events;
   Bool compress_pos;
+  Bool binary_out;         /* Write the binary format? */
+  Bool compress_binary;    /* LZO-compress it? */
   Bool mangle_names;
   Bool compress_mangled;
   Bool dump_line;
@@ -621,13 +623,16 @@ struct _FnPos {
 /*--- Cache simulator interface                            ---*/
 /*------------------------------------------------------------*/
 
+/* A profile dump being written, as text or in the binary format. */
+typedef struct _DumpFile DumpFile;
+
 struct cachesim_if
 {
     void (*print_opts)(void);
     Bool (*parse_opt)(const HChar* arg);
     void (*post_clo_init)(void);
     void (*clear)(void);
-    void (*dump_desc)(VgFile *fp);
+    void (*dump_desc)(DumpFile *fp);
     void (*printstat)(Int,Int,Int);
     void (*add_icost)(SimCost, BBCC*, InstrInfo*, ULong);
     void (*finish)(void);
@@ -772,6 +777,8 @@ void CLG_(run_post_signal_on_call_stack_bottom)(void);
 
 /* from dump.c */
 void CLG_(init_dumps)(void);
+void CLG_(dump_printf)(DumpFile *fp, const HChar *format, ...)
+                      PRINTF_CHECK(2, 3);
 
 /*------------------------------------------------------------*/
 /*--- Exported global variables                            ---*/
@@ -1434,11 +1434,11 @@ void cachesim_clear(void)
 }
 
 
-static void cachesim_dump_desc(VgFile *fp)
+static void cachesim_dump_desc(DumpFile *fp)
 {
-  VG_(fprintf)(fp, "\ndesc: I1 cache: %s\n", I1.desc_line);
-  VG_(fprintf)(fp, "desc: D1 cache: %s\n", D1.desc_line);
-  VG_(fprintf)(fp, "desc: LL cache: %s\n", LL.desc_line);
+  CLG_(dump_printf)(fp, "\ndesc: I1 cache: %s\n", I1.desc_line);
+  CLG_(dump_printf)(fp, "desc: D1 cache: %s\n", D1.desc_line);
+  CLG_(dump_printf)(fp, "desc: LL cache: %s\n", LL.desc_line);
 }
 
 static
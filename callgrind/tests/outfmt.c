@@ -0,0 +1,31 @@
+// Calls a few functions a known number of times, to compare what
+// callgrind_annotate makes of callgrind's text and binary output.
+
+volatile int outer = 100, inner = 10, sink;
+
+__attribute__((noinline)) void leaf(int n)
+{
+   int i;
+   for (i = 0; i < n; i++)
+      sink += i;
+}
+
+__attribute__((noinline)) void middle(int n)
+{
+   int i;
+   for (i = 0; i < n; i++)
+      leaf(i);
+}
+
+__attribute__((noinline)) void work(int n)
+{
+   int i;
+   for (i = 0; i < n; i++)
+      middle(inner);
+}
+
+int main(void)
+{
+   work(outer);
+   return 0;
+}
@@ -58,6 +58,7 @@
 #include "priv_d3basics.h"       /* ML_(pp_GX) */
 #include "priv_tytypes.h"
 #include "priv_storage.h"
+#include "priv_diskcache.h"     /* ML_(save_cached_DebugInfo) */
 #include "priv_readdwarf.h"
 #if defined(VGO_linux) || defined(VGO_solaris)
 # include "priv_readelf.h"
@@ -109,6 +110,7 @@
 /*------------------------------------------------------------*/
 
 static void caches__invalidate (void);
+static void load_deferred_DebugInfo ( DebugInfo* di, UInt what );
 
 
 /*------------------------------------------------------------*/
@@ -337,10 +339,14 @@ static void free_DebugInfo ( DebugInfo* di )
    GExpr* gexpr;
 
    vg_assert(di != NULL);
+#  if defined(VGO_linux) || defined(VGO_solaris)
+   ML_(discard_elf_deferred)(di);
+#  endif
    if (di->fsm.maps)     VG_(deleteXA)(di->fsm.maps);
    if (di->fsm.filename) ML_(dinfo_free)(di->fsm.filename);
    if (di->fsm.dbgname)  ML_(dinfo_free)(di->fsm.dbgname);
    if (di->soname)       ML_(dinfo_free)(di->soname);
+   if (di->cache_file)   ML_(dinfo_free)(di->cache_file);
    if (di->loctab)       ML_(dinfo_free)(di->loctab);
    if (di->loctab_fndn_ix) ML_(dinfo_free)(di->loctab_fndn_ix);
    if (di->inltab)       ML_(dinfo_free)(di->inltab);
@@ -473,6 +479,9 @@ static void discard_or_archive_DebugInfo ( DebugInfo* di )
             VG_(redir_notify_delete_DebugInfo)( curr );
          }
          if (archive) {
+            /* The object may be gone by the time its info is wanted,
+               so read whatever was deferred now. */
+            load_deferred_DebugInfo( di, di->deferred );
             /* Adjust the epoch markers appropriately. */
             di->last_epoch = VG_(current_DiEpoch)();
             VG_(archive_ExeContext_in_range) (di->last_epoch,
@@ -651,6 +660,24 @@ static DebugInfo* find_or_create_DebugInfo_for ( const HChar* filename )
 }
 
 
+/* Sets [*lo, *hi] to the code address range of the i'th CFI entry of
+   'di', whose entries are either still in di->cfsi_rd or, as for tables
+   loaded from the debuginfo cache, already in the cfsi_base/cfsi_m_ix
+   form.  Returns False if the entry is a hole of the latter. */
+static Bool cfsi_range ( const DebugInfo* di, Word i,
+                         /*OUT*/Addr* lo, /*OUT*/Addr* hi )
+{
+   if (di->cfsi_rd) {
+      *lo = di->cfsi_rd[i].base;
+      *hi = di->cfsi_rd[i].base + di->cfsi_rd[i].len - 1;
+      return True;
+   }
+   *lo = di->cfsi_base[i];
+   *hi = i + 1 < di->cfsi_used ? di->cfsi_base[i + 1] - 1
+                               : di->cfsi_maxavma;
+   return ML_(get_cfsi_m)(di, i) != NULL;
+}
+
 /* Debuginfo reading for 'di' has just been successfully completed.
    Check that the invariants stated in
    "Comment_on_IMPORTANT_CFSI_REPRESENTATIONAL_INVARIANTS" in
@@ -702,11 +729,12 @@ static void check_CFSI_related_invariants ( const DebugInfo* di )
    /* degenerate case: all r-x sections are empty */
    if (!has_nonempty_rx) {
       vg_assert(di->cfsi_rd == NULL);
+      vg_assert(di->cfsi_base == NULL);
       return;
    }
 
    /* invariant (2) */
-   if (di->cfsi_rd) {
+   if (di->cfsi_rd || di->cfsi_base) {
       vg_assert(di->cfsi_minavma <= di->cfsi_maxavma); /* duh! */
       /* It may be that the cfsi range doesn't fit into any one individual
          mapping, but it is covered by the combination of all the mappings.
@@ -758,9 +786,10 @@ static void check_CFSI_related_invariants ( const DebugInfo* di )
             /* This is a part of cfsi_minavma .. cfsi_maxavma not covered.
                Check no cfsi overlaps with this range. */
             for (i = 0; i < di->cfsi_used; i++) {
-               DiCfSI* cfsi = &di->cfsi_rd[i];
-               vg_assert2(cfsi->base > key_max
-                          || cfsi->base + cfsi->len - 1 < key_min,
+               Addr lo, hi;
+               if (!cfsi_range(di, i, &lo, &hi))
+                  continue;
+               vg_assert2(lo > key_max || hi < key_min,
                           "DiCfsi invariant (2) verification failed");
             }
          }
@@ -771,18 +800,18 @@ static void check_CFSI_related_invariants ( const DebugInfo* di )
    }
 
    /* invariants (3) and (4) */
-   if (di->cfsi_rd) {
+   if (di->cfsi_rd || di->cfsi_base) {
+      Addr lo, hi, prev_hi = 0;
       vg_assert(di->cfsi_used > 0);
       vg_assert(di->cfsi_size > 0);
       for (i = 0; i < di->cfsi_used; i++) {
-         DiCfSI* cfsi = &di->cfsi_rd[i];
-         vg_assert(cfsi->len > 0);
-         vg_assert(cfsi->base >= di->cfsi_minavma);
-         vg_assert(cfsi->base + cfsi->len - 1 <= di->cfsi_maxavma);
-         if (i > 0) {
-            DiCfSI* cfsip = &di->cfsi_rd[i-1];
-            vg_assert(cfsip->base + cfsip->len <= cfsi->base);
-         }
+         cfsi_range(di, i, &lo, &hi);
+         vg_assert(lo <= hi);
+         vg_assert(lo >= di->cfsi_minavma);
+         vg_assert(hi <= di->cfsi_maxavma);
+         if (i > 0)
+            vg_assert(prev_hi < lo);
+         prev_hi = hi;
       }
    } else {
       vg_assert(di->cfsi_used == 0);
@@ -791,6 +820,39 @@ static void check_CFSI_related_invariants ( const DebugInfo* di )
 }
 
 
+/* Read and get ready for use the parts 'what' (DiDefer_ flags) of the
+   debug info of 'di' that were put off by --lazy-debuginfo=yes, if
+   they have not been read yet.  The caches don't need invalidating:
+   a query that could have been answered from these parts loads them
+   before it searches 'di', so nothing derived from their absence has
+   been cached. */
+static void load_deferred_DebugInfo ( DebugInfo* di, UInt what )
+{
+   what &= di->deferred;
+   if (LIKELY(what == 0))
+      return;
+
+#  if defined(VGO_linux) || defined(VGO_solaris)
+   ML_(read_elf_deferred)( di, what );
+#  else
+   vg_assert(0); /* only the ELF reader defers anything */
+#  endif
+   ML_(canonicaliseDeferredTables)( di, what );
+   if (what & DiDefer_CFI) {
+      check_CFSI_related_invariants(di);
+      ML_(finish_CFSI_arrays)(di);
+   }
+}
+
+/* The variable info is read along with the line info, but there is
+   none to wait for unless it was asked for. */
+static void load_deferred_varinfo ( DebugInfo* di )
+{
+   if (VG_(clo_read_var_info))
+      load_deferred_DebugInfo( di, DiDefer_DWARF );
+}
+
+
 /*--------------------------------------------------------------*/
 /*---                                                        ---*/
 /*--- TOP LEVEL: INITIALISE THE DEBUGINFO SYSTEM             ---*/
@@ -981,13 +1043,18 @@ static ULong di_notify_ACHIEVE_ACCEPT_STATE ( struct _DebugInfo* di )
                    "acquired info ------\n");
       /* invalidate the debug info caches. */
       caches__invalidate();
-      /* prepare read data for use */
-      ML_(canonicaliseTables)( di );
+      /* prepare read data for use, unless it was loaded ready for use
+         from the debuginfo cache */
+      if (!di->cache_loaded)
+         ML_(canonicaliseTables)( di );
       /* Check invariants listed in
          Comment_on_IMPORTANT_REPRESENTATIONAL_INVARIANTS in
-         priv_storage.h. */
+         priv_storage.h, of tables loaded from the cache as well. */
       check_CFSI_related_invariants(di);
-      ML_(finish_CFSI_arrays)(di);
+      if (!di->cache_loaded) {
+         ML_(finish_CFSI_arrays)(di);
+         ML_(save_cached_DebugInfo)(di);
+      }
 
       // Mark di's first epoch point as a valid epoch.  Because its
       // last_epoch value is still invalid, this changes di's state from
@@ -1992,6 +2059,7 @@ static void search_all_loctabs ( DiEpoch ep, Addr ptr,
           && di->text_size > 0
           && di->text_avma <= ptr 
           && ptr < di->text_avma + di->text_size) {
+         load_deferred_DebugInfo( di, DiDefer_DWARF );
          lno = ML_(search_one_loctab) ( di, ptr );
          if (lno == -1) goto not_found;
          *locno = lno;
@@ -2943,6 +3011,11 @@ static void find_DiCfSI ( /*OUT*/DebugInfo** diP,
       if (!is_DI_valid_for_epoch(di, curr_epoch))
          continue;
 
+      /* Read CFI that was put off, if ip could be covered by it. */
+      if (UNLIKELY(di->deferred & DiDefer_CFI)
+          && ML_(find_rx_mapping)(di, ip, ip) != NULL)
+         load_deferred_DebugInfo( di, DiDefer_CFI );
+
       /* Use the per-DebugInfo summary address ranges to skip
          inapplicable DebugInfos quickly. */
       if (di->cfsi_used == 0)
@@ -3967,6 +4040,7 @@ Bool consider_vars_in_frame ( /*MOD*/XArray* /* of HChar */ dname1,
    }
    /* End of performance-enhancing hack. */
 
+   load_deferred_varinfo( di );
    /* any var info at all? */
    if (!di->varinfo)
       return False;
@@ -4085,6 +4159,7 @@ Bool VG_(get_data_description)(
       /* text segment missing? unlikely, but handle it .. */
       if (!di->text_present || di->text_size == 0)
          continue;
+      load_deferred_varinfo( di );
       /* any var info at all? */
       if (!di->varinfo)
          continue;
@@ -4411,6 +4486,7 @@ VG_(di_get_stack_blocks_at_ip)( Addr ip, Bool arrays_only )
    }
    /* End of performance-enhancing hack. */
 
+   load_deferred_varinfo( di );
    /* any var info at all? */
    if (!di->varinfo)
       return res; /* currently empty */
@@ -4503,6 +4579,7 @@ VG_(di_get_global_blocks_from_dihandle) ( ULong di_handle, Bool  arrays_only )
    gvars = VG_(newXA)( ML_(dinfo_zalloc), "di.debuginfo.dggbfd.1",
                        ML_(dinfo_free), sizeof(GlobalBlock) );
 
+   load_deferred_varinfo( di );
    /* any var info at all? */
    if (!di->varinfo)
       return gvars;
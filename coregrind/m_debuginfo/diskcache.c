@@ -0,0 +1,1019 @@
+/* -*- mode: C; c-basic-offset: 3; -*- */
+
+/*--------------------------------------------------------------------*/
+/*--- On-disk cache of debuginfo tables.                diskcache.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   Copyright (C) 2019 The Valgrind developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+/* A cache file holds the tables of one DebugInfo, as they are once
+   canonicalised, in the host's own representation.  It starts with a
+   CacheHeader, followed by these sections, in this order:
+
+      strings      n_strs zero-terminated strings, strs_szB bytes
+      fndn         n_fndn CachedFnDn, for fndn_ix 1 .. n_fndn
+      symtab       n_syms CachedSym
+      sec_names    n_sec_names UInts, the secondary names of all
+                   symbols, in symtab order
+      loctab       n_locs DiLoc, then n_locs UInts holding their fndn_ix
+      inltab       n_inls CachedInl
+      cfsi         n_cfsi Addrs (cfsi_base), then n_cfsi UInts
+                   (cfsi_m_ix), then n_cfsi_m DiCfSI_m, for cfsi_m_ix
+                   1 .. n_cfsi_m, then n_cfsi_exprs CfiExpr
+
+   Strings are referred to by their number in the strings section.
+   All addresses are those of the run that wrote the file; they are
+   relocated by the difference between the biases of the object then
+   and now.  The file is only used by the same Valgrind version and
+   platform that wrote it, so the layout of the structures doesn't
+   need to be stable. */
+
+#include "pub_core_basics.h"
+#include "pub_core_vki.h"
+#include "pub_core_libcbase.h"
+#include "pub_core_libcassert.h"
+#include "pub_core_libcprint.h"
+#include "pub_core_libcproc.h"     /* VG_(getpid) */
+#include "pub_core_libcfile.h"
+#include "pub_core_options.h"
+#include "pub_core_debuginfo.h"
+#include "pub_core_xarray.h"
+#include "pub_core_wordfm.h"
+#include "pub_core_deduppoolalloc.h"
+#include "pub_core_rangemap.h"
+
+#include "priv_misc.h"             /* dinfo_zalloc/free/strdup */
+#include "priv_image.h"
+#include "priv_storage.h"
+#include "priv_diskcache.h"        /* self */
+
+#define CACHE_MAGIC  "VGDICACH"
+#define CACHE_IDENT  "valgrind-" VERSION "-" VG_PLATFORM
+
+/* Denotes "no string", for FnDn dirnames. */
+#define NO_STR  0xFFFFFFFF
+
+/* The regions of an object whose biases must all have moved by the
+   same amount for a cache file to be relocatable. */
+#define N_REGIONS  6
+
+typedef
+   struct {
+      HChar    magic[8];
+      HChar    ident[48];
+      /* For checking that the file fits this build */
+      UInt     szB_DiLoc;
+      UInt     szB_DiCfSI_m;
+      UInt     szB_CfiExpr;
+      /* For relocation: the regions present, and their biases */
+      UInt     present;
+      PtrdiffT bias[N_REGIONS];
+      PtrdiffT debug_bias[N_REGIONS];
+      /* The sizes of the sections */
+      UWord    n_strs;
+      UWord    strs_szB;
+      UWord    n_fndn;
+      UWord    n_syms;
+      UWord    n_sec_names;
+      UWord    n_locs;
+      UWord    n_inls;
+      UWord    n_cfsi;
+      UWord    n_cfsi_m;
+      UWord    n_cfsi_exprs;
+      /* Summary of the CFI address range */
+      Addr     cfsi_minavma;
+      Addr     cfsi_maxavma;
+   }
+   CacheHeader;
+
+typedef
+   struct {
+      UInt filename;
+      UInt dirname;   /* or NO_STR */
+   }
+   CachedFnDn;
+
+typedef
+   struct {
+      SymAVMAs avmas;
+      UInt     size;
+      UInt     pri_name;
+      UInt     n_sec_names;
+      Bool     isText;
+      Bool     isIFunc;
+      Bool     isGlobal;
+   }
+   CachedSym;
+
+typedef
+   struct {
+      Addr addr_lo;
+      Addr addr_hi;
+      UInt inlinedfn;
+      UInt fndn_ix;
+      UInt lineno;
+      UInt level;
+   }
+   CachedInl;
+
+
+/*------------------------------------------------------------*/
+/*--- Helpers                                              ---*/
+/*------------------------------------------------------------*/
+
+static void get_biases ( const DebugInfo* di, /*OUT*/UInt* present,
+                         /*OUT*/PtrdiffT* bias, /*OUT*/PtrdiffT* debug_bias )
+{
+   *present = 0;
+   VG_(memset)(bias, 0, N_REGIONS * sizeof(PtrdiffT));
+   VG_(memset)(debug_bias, 0, N_REGIONS * sizeof(PtrdiffT));
+#  define REGION(_n, _r)                       \
+      if (di->_r##_present) {                  \
+         *present |= 1 << (_n);                \
+         bias[_n] = di->_r##_bias;             \
+         debug_bias[_n] = di->_r##_debug_bias; \
+      }
+   REGION(0, text)
+   REGION(1, data)
+   REGION(2, sdata)
+   REGION(3, rodata)
+   REGION(4, bss)
+   REGION(5, sbss)
+#  undef REGION
+}
+
+static UInt fndn_ix_at ( const DebugInfo* di, Word locno )
+{
+   return ML_(fndn_ix)(di, locno);
+}
+
+static UInt cfsi_m_ix_at ( const DebugInfo* di, UWord pos )
+{
+   switch (di->sizeof_cfsi_m_ix) {
+      case 1: return ((UChar*)  di->cfsi_m_ix)[pos];
+      case 2: return ((UShort*) di->cfsi_m_ix)[pos];
+      case 4: return ((UInt*)   di->cfsi_m_ix)[pos];
+      default: vg_assert(0);
+   }
+}
+
+/* The smallest of 1, 2 and 4 bytes that holds indexes up to 'max'. */
+static UInt ix_size ( UWord max )
+{
+   return max <= 255 ? 1 : max <= 65535 ? 2 : 4;
+}
+
+static void set_ix ( void* arr, UInt szB, UWord pos, UInt ix )
+{
+   switch (szB) {
+      case 1: ((UChar*)  arr)[pos] = ix; break;
+      case 2: ((UShort*) arr)[pos] = ix; break;
+      case 4: ((UInt*)   arr)[pos] = ix; break;
+      default: vg_assert(0);
+   }
+}
+
+HChar* ML_(cache_file_name) ( const HChar* buildid, UInt found,
+                              ULong m_szB, ULong d_szB )
+{
+   const HChar* dir = VG_(clo_debuginfo_cache);
+   HChar* name;
+   UInt   flags;
+
+   if (dir == NULL || VG_(clo_read_var_info))
+      return NULL;
+   vg_assert(buildid != NULL);
+   vg_assert(found < (1 << 6));
+   /* Inline info is read or not depending on the options. */
+   flags = found | (VG_(clo_read_inline_info) ? 1 << 6 : 0);
+   name = ML_(dinfo_zalloc)("di.diskcache.cfn.1",
+                            VG_(strlen)(dir) + VG_(strlen)(buildid) + 60);
+   VG_(sprintf)(name, "%s/%s-%x-%llx-%llx.vgdi", dir, buildid, flags,
+                m_szB, d_szB);
+   return name;
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Saving                                               ---*/
+/*------------------------------------------------------------*/
+
+#define WRITE_BUF_SIZE  65536
+
+typedef
+   struct {
+      Int   fd;
+      Bool  failed;
+      UInt  used;
+      UChar buf[WRITE_BUF_SIZE];
+   }
+   Writer;
+
+static void flush ( Writer* w )
+{
+   if (w->used > 0 && !w->failed
+       && VG_(write)(w->fd, w->buf, w->used) != (Int)w->used)
+      w->failed = True;
+   w->used = 0;
+}
+
+static void put ( Writer* w, const void* p, SizeT n )
+{
+   const UChar* src = p;
+   while (n > 0) {
+      SizeT k = WRITE_BUF_SIZE - w->used;
+      if (k > n) k = n;
+      VG_(memcpy)(&w->buf[w->used], src, k);
+      w->used += k;
+      src += k;
+      n -= k;
+      if (w->used == WRITE_BUF_SIZE)
+         flush(w);
+   }
+}
+
+static void put_UInt ( Writer* w, UInt n )
+{
+   put(w, &n, sizeof(n));
+}
+
+/* Numbering of the strings written.  Names are all in di->strpool,
+   so a string is identified by its address. */
+typedef
+   struct {
+      WordFM* map;   /* const HChar* -> string number */
+      XArray* strs;  /* of const HChar*, in number order */
+      UWord   szB;   /* their total size, including terminating zeroes */
+   }
+   StrTab;
+
+static UInt str_no ( StrTab* st, const HChar* str )
+{
+   UWord no;
+   if (VG_(lookupFM)(st->map, NULL, &no, (UWord)str))
+      return (UInt)no;
+   no = VG_(sizeXA)(st->strs);
+   VG_(addToXA)(st->strs, &str);
+   VG_(addToFM)(st->map, (UWord)str, no);
+   st->szB += VG_(strlen)(str) + 1;
+   return (UInt)no;
+}
+
+static void write_tables ( Writer* w, const DebugInfo* di )
+{
+   CacheHeader h;
+   StrTab      st;
+   UWord       i, j;
+
+   VG_(memset)(&h, 0, sizeof(h));
+   st.map  = VG_(newFM)(ML_(dinfo_zalloc), "di.diskcache.wt.1",
+                        ML_(dinfo_free), NULL);
+   st.strs = VG_(newXA)(ML_(dinfo_zalloc), "di.diskcache.wt.2",
+                        ML_(dinfo_free), sizeof(HChar*));
+   st.szB  = 0;
+
+   h.n_fndn       = di->fndnpool ? VG_(sizeDedupPA)(di->fndnpool) : 0;
+   h.n_syms       = di->symtab_used;
+   h.n_locs       = di->loctab_used;
+   h.n_inls       = di->inltab_used;
+   h.n_cfsi       = di->cfsi_used;
+   h.n_cfsi_m     = di->cfsi_m_pool ? VG_(sizeDedupPA)(di->cfsi_m_pool) : 0;
+   h.n_cfsi_exprs = di->cfsi_exprs ? VG_(sizeXA)(di->cfsi_exprs) : 0;
+
+   /* Number the strings, in the order they are first used below. */
+   for (i = 1; i <= h.n_fndn; i++) {
+      const FnDn* fndn = VG_(indexEltNumber)(di->fndnpool, i);
+      str_no(&st, fndn->filename);
+      if (fndn->dirname)
+         str_no(&st, fndn->dirname);
+   }
+   for (i = 0; i < h.n_syms; i++) {
+      const DiSym* sym = &di->symtab[i];
+      str_no(&st, sym->pri_name);
+      if (sym->sec_names) {
+         for (j = 0; sym->sec_names[j]; j++) {
+            str_no(&st, sym->sec_names[j]);
+            h.n_sec_names++;
+         }
+      }
+   }
+   for (i = 0; i < h.n_inls; i++)
+      str_no(&st, di->inltab[i].inlinedfn);
+   h.n_strs   = VG_(sizeXA)(st.strs);
+   h.strs_szB = st.szB;
+
+   VG_(memcpy)(h.magic, CACHE_MAGIC, sizeof(h.magic));
+   VG_(strncpy)(h.ident, CACHE_IDENT, sizeof(h.ident) - 1);
+   h.szB_DiLoc    = sizeof(DiLoc);
+   h.szB_DiCfSI_m = sizeof(DiCfSI_m);
+   h.szB_CfiExpr  = sizeof(CfiExpr);
+   get_biases(di, &h.present, h.bias, h.debug_bias);
+   h.cfsi_minavma = di->cfsi_minavma;
+   h.cfsi_maxavma = di->cfsi_maxavma;
+   put(w, &h, sizeof(h));
+
+   for (i = 0; i < h.n_strs; i++) {
+      const HChar* str = *(const HChar**)VG_(indexXA)(st.strs, i);
+      put(w, str, VG_(strlen)(str) + 1);
+   }
+
+   for (i = 1; i <= h.n_fndn; i++) {
+      const FnDn* fndn = VG_(indexEltNumber)(di->fndnpool, i);
+      CachedFnDn  cf;
+      cf.filename = str_no(&st, fndn->filename);
+      cf.dirname  = fndn->dirname ? str_no(&st, fndn->dirname) : NO_STR;
+      put(w, &cf, sizeof(cf));
+   }
+
+   for (i = 0; i < h.n_syms; i++) {
+      const DiSym* sym = &di->symtab[i];
+      CachedSym    cs;
+      VG_(memset)(&cs, 0, sizeof(cs));
+      cs.avmas    = sym->avmas;
+      cs.size     = sym->size;
+      cs.pri_name = str_no(&st, sym->pri_name);
+      if (sym->sec_names)
+         while (sym->sec_names[cs.n_sec_names])
+            cs.n_sec_names++;
+      cs.isText   = sym->isText;
+      cs.isIFunc  = sym->isIFunc;
+      cs.isGlobal = sym->isGlobal;
+      put(w, &cs, sizeof(cs));
+   }
+   for (i = 0; i < h.n_syms; i++) {
+      const DiSym* sym = &di->symtab[i];
+      if (sym->sec_names)
+         for (j = 0; sym->sec_names[j]; j++)
+            put_UInt(w, str_no(&st, sym->sec_names[j]));
+   }
+
+   if (h.n_locs > 0)
+      put(w, di->loctab, h.n_locs * sizeof(DiLoc));
+   for (i = 0; i < h.n_locs; i++)
+      put_UInt(w, fndn_ix_at(di, i));
+
+   for (i = 0; i < h.n_inls; i++) {
+      const DiInlLoc* inl = &di->inltab[i];
+      CachedInl       ci;
+      VG_(memset)(&ci, 0, sizeof(ci));
+      ci.addr_lo   = inl->addr_lo;
+      ci.addr_hi   = inl->addr_hi;
+      ci.inlinedfn = str_no(&st, inl->inlinedfn);
+      ci.fndn_ix   = inl->fndn_ix;
+      ci.lineno    = inl->lineno;
+      ci.level     = inl->level;
+      put(w, &ci, sizeof(ci));
+   }
+
+   if (h.n_cfsi > 0)
+      put(w, di->cfsi_base, h.n_cfsi * sizeof(Addr));
+   for (i = 0; i < h.n_cfsi; i++)
+      put_UInt(w, cfsi_m_ix_at(di, i));
+   for (i = 1; i <= h.n_cfsi_m; i++)
+      put(w, VG_(indexEltNumber)(di->cfsi_m_pool, i), sizeof(DiCfSI_m));
+   if (h.n_cfsi_exprs > 0)
+      put(w, VG_(indexXA)(di->cfsi_exprs, 0),
+          h.n_cfsi_exprs * sizeof(CfiExpr));
+
+   VG_(deleteXA)(st.strs);
+   VG_(deleteFM)(st.map, NULL, NULL);
+}
+
+void ML_(save_cached_DebugInfo) ( DebugInfo* di )
+{
+   HChar*  tmp;
+   SysRes  sres;
+   Writer* w;
+   Bool    ok;
+
+   if (di->cache_file == NULL)
+      return;
+   vg_assert(di->deferred == 0);
+   vg_assert(!di->cache_loaded);
+
+   /* Write to a temporary file first, and rename it into place, so that
+      concurrent runs never see a partially written cache file. */
+   tmp = ML_(dinfo_zalloc)("di.diskcache.scd.1",
+                           VG_(strlen)(di->cache_file) + 32);
+   VG_(sprintf)(tmp, "%s.%d.tmp", di->cache_file, VG_(getpid)());
+   sres = VG_(open)(tmp, VKI_O_CREAT|VKI_O_WRONLY|VKI_O_TRUNC,
+                    VKI_S_IRUSR|VKI_S_IWUSR|VKI_S_IRGRP|VKI_S_IROTH);
+   if (sr_isError(sres)) {
+      ok = False;
+   } else {
+      w = ML_(dinfo_zalloc)("di.diskcache.scd.2", sizeof(Writer));
+      w->fd = sr_Res(sres);
+      write_tables(w, di);
+      flush(w);
+      VG_(close)(w->fd);
+      ok = !w->failed;
+      ML_(dinfo_free)(w);
+      if (ok)
+         ok = VG_(rename)(tmp, di->cache_file) == 0;
+      if (!ok)
+         VG_(unlink)(tmp);
+   }
+
+   if (VG_(clo_verbosity) > 1)
+      VG_(message)(Vg_DebugMsg, "%s debug info cache file %s\n",
+                   ok ? "Wrote" : "Warning: cannot write", di->cache_file);
+   TRACE_SYMTAB("\n------ %s cache file %s ------\n",
+                ok ? "Wrote" : "Could not write", di->cache_file);
+
+   ML_(dinfo_free)(tmp);
+   ML_(dinfo_free)(di->cache_file);
+   di->cache_file = NULL;
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Loading                                              ---*/
+/*------------------------------------------------------------*/
+
+/* The sections of a cache file, read into ML_(dinfo_zalloc)'d
+   space, before they are checked and installed. */
+typedef
+   struct {
+      HChar*      strs;
+      CachedFnDn* fndn;
+      CachedSym*  syms;
+      UInt*       sec_names;
+      DiLoc*      locs;
+      UInt*       loc_fndn_ix;
+      CachedInl*  inls;
+      Addr*       cfsi_base;
+      UInt*       cfsi_m_ix;
+      DiCfSI_m*   cfsi_m;
+      CfiExpr*    cfsi_exprs;
+   }
+   Sections;
+
+static void* get_section ( DiImage* img, /*MOD*/DiOffT* off, UWord szB )
+{
+   void* p = NULL;
+   if (szB > 0) {
+      p = ML_(dinfo_zalloc)("di.diskcache.gs.1", szB);
+      ML_(img_get)(p, img, *off, szB);
+   }
+   *off += szB;
+   return p;
+}
+
+static void free_sections ( Sections* s )
+{
+   if (s->strs)        ML_(dinfo_free)(s->strs);
+   if (s->fndn)        ML_(dinfo_free)(s->fndn);
+   if (s->syms)        ML_(dinfo_free)(s->syms);
+   if (s->sec_names)   ML_(dinfo_free)(s->sec_names);
+   if (s->locs)        ML_(dinfo_free)(s->locs);
+   if (s->loc_fndn_ix) ML_(dinfo_free)(s->loc_fndn_ix);
+   if (s->inls)        ML_(dinfo_free)(s->inls);
+   if (s->cfsi_base)   ML_(dinfo_free)(s->cfsi_base);
+   if (s->cfsi_m_ix)   ML_(dinfo_free)(s->cfsi_m_ix);
+   if (s->cfsi_m)      ML_(dinfo_free)(s->cfsi_m);
+   if (s->cfsi_exprs)  ML_(dinfo_free)(s->cfsi_exprs);
+}
+
+/* Check that the header fits this build and the file size, and that
+   the object's regions have all moved by the same amount since the
+   file was written.  If so, returns True and sets *delta to that
+   amount. */
+static Bool header_ok ( const CacheHeader* h, DiOffT file_szB,
+                        const DebugInfo* di, /*OUT*/PtrdiffT* delta )
+{
+   UInt     present, i;
+   PtrdiffT bias[N_REGIONS], debug_bias[N_REGIONS];
+   ULong    szB;
+
+   if (VG_(memcmp)(h->magic, CACHE_MAGIC, sizeof(h->magic)) != 0
+       || VG_(strncmp)(h->ident, CACHE_IDENT, sizeof(h->ident)) != 0
+       || h->szB_DiLoc != sizeof(DiLoc)
+       || h->szB_DiCfSI_m != sizeof(DiCfSI_m)
+       || h->szB_CfiExpr != sizeof(CfiExpr))
+      return False;
+
+   /* Guard against overflow in the size computation below. */
+   if (h->n_strs > file_szB || h->strs_szB > file_szB
+       || h->n_fndn > file_szB || h->n_syms > file_szB
+       || h->n_sec_names > file_szB || h->n_locs > file_szB
+       || h->n_inls > file_szB || h->n_cfsi > file_szB
+       || h->n_cfsi_m > file_szB || h->n_cfsi_exprs > file_szB)
+      return False;
+   szB = sizeof(CacheHeader)
+         + (ULong)h->strs_szB
+         + (ULong)h->n_fndn * sizeof(CachedFnDn)
+         + (ULong)h->n_syms * sizeof(CachedSym)
+         + (ULong)h->n_sec_names * sizeof(UInt)
+         + (ULong)h->n_locs * (sizeof(DiLoc) + sizeof(UInt))
+         + (ULong)h->n_inls * sizeof(CachedInl)
+         + (ULong)h->n_cfsi * (sizeof(Addr) + sizeof(UInt))
+         + (ULong)h->n_cfsi_m * sizeof(DiCfSI_m)
+         + (ULong)h->n_cfsi_exprs * sizeof(CfiExpr);
+   if (szB != file_szB)
+      return False;
+
+   get_biases(di, &present, bias, debug_bias);
+   if (present != h->present || !(present & 1))
+      return False;
+   *delta = bias[0] - h->bias[0];
+   for (i = 0; i < N_REGIONS; i++) {
+      if (bias[i] - h->bias[i] != *delta
+          || debug_bias[i] - h->debug_bias[i] != *delta)
+         return False;
+   }
+   return True;
+}
+
+/* Is 'ix' the index of one of 'n' CfiExprs? */
+static Bool expr_ix_ok ( Int ix, UWord n )
+{
+   return ix >= 0 && (UWord)ix < n;
+}
+
+/* Check a CFIR_ rule, as the unwinder would apply it. */
+static Bool cfir_ok ( UChar how, Int off, UWord n_exprs )
+{
+   switch (how) {
+      case CFIR_UNKNOWN:
+      case CFIR_SAME:
+      case CFIR_CFAREL:
+      case CFIR_MEMCFAREL:
+         return True;
+      case CFIR_EXPR:
+         return expr_ix_ok(off, n_exprs);
+      default:
+         return False;
+   }
+}
+
+/* Check that 'm' only has the rules that compute_cfa and
+   VG_(use_CF_info) handle on this platform, and refers only to
+   existing expressions. */
+static Bool cfsi_m_ok ( const DiCfSI_m* m, UWord n_exprs )
+{
+#  if defined(VGA_ppc32) || defined(VGA_ppc64be) || defined(VGA_ppc64le)
+   /* CFI isn't used for unwinding on these. */
+   return True;
+#  else
+   Bool ok;
+
+   switch (m->cfa_how) {
+      case CFIC_EXPR:
+         ok = expr_ix_ok(m->cfa_off, n_exprs);
+         break;
+#     if defined(VGA_x86) || defined(VGA_amd64)
+      case CFIC_IA_SPREL:
+      case CFIC_IA_BPREL:
+         ok = True;
+         break;
+#     elif defined(VGA_arm)
+      case CFIC_ARM_R13REL:
+      case CFIC_ARM_R12REL:
+      case CFIC_ARM_R11REL:
+      case CFIC_ARM_R7REL:
+         ok = True;
+         break;
+#     elif defined(VGA_s390x)
+      case CFIC_IA_SPREL:
+      case CFIC_IA_BPREL:
+      case CFIR_MEMCFAREL:
+      case CFIR_SAME:
+         ok = True;
+         break;
+#     elif defined(VGA_mips32) || defined(VGA_mips64)
+      case CFIC_IA_SPREL:
+      case CFIC_IA_BPREL:
+      case CFIR_SAME:
+         ok = True;
+         break;
+#     elif defined(VGA_arm64)
+      case CFIC_ARM64_SPREL:
+      case CFIC_ARM64_X29REL:
+         ok = True;
+         break;
+#     endif
+      default:
+         ok = False;
+         break;
+   }
+
+#  if defined(VGA_x86) || defined(VGA_amd64)
+   ok = ok && cfir_ok(m->ra_how, m->ra_off, n_exprs)
+           && cfir_ok(m->sp_how, m->sp_off, n_exprs)
+           && cfir_ok(m->bp_how, m->bp_off, n_exprs);
+#  elif defined(VGA_arm)
+   ok = ok && cfir_ok(m->ra_how,  m->ra_off,  n_exprs)
+           && cfir_ok(m->r14_how, m->r14_off, n_exprs)
+           && cfir_ok(m->r13_how, m->r13_off, n_exprs)
+           && cfir_ok(m->r12_how, m->r12_off, n_exprs)
+           && cfir_ok(m->r11_how, m->r11_off, n_exprs)
+           && cfir_ok(m->r7_how,  m->r7_off,  n_exprs);
+#  elif defined(VGA_s390x) || defined(VGA_mips32) || defined(VGA_mips64)
+   ok = ok && cfir_ok(m->ra_how, m->ra_off, n_exprs)
+           && cfir_ok(m->sp_how, m->sp_off, n_exprs)
+           && cfir_ok(m->fp_how, m->fp_off, n_exprs);
+#  elif defined(VGA_arm64)
+   ok = ok && cfir_ok(m->ra_how,  m->ra_off,  n_exprs)
+           && cfir_ok(m->sp_how,  m->sp_off,  n_exprs)
+           && cfir_ok(m->x30_how, m->x30_off, n_exprs)
+           && cfir_ok(m->x29_how, m->x29_off, n_exprs);
+#  else
+#    error "Unknown arch"
+#  endif
+   return ok;
+#  endif
+}
+
+/* Check the expressions.  ML_(CfiExpr_*) add an expression after its
+   operands, so each must only refer to earlier ones; that also makes
+   sure that evalCfiExpr terminates.  Register numbers are converted
+   to CfiRegs before the tables are finished. */
+static Bool cfi_exprs_ok ( const CfiExpr* e, UWord n )
+{
+   UWord i;
+
+   for (i = 0; i < n; i++) {
+      switch (e[i].tag) {
+         case Cex_Undef:
+         case Cex_Const:
+            break;
+         case Cex_Deref:
+            if (!expr_ix_ok(e[i].Cex.Deref.ixAddr, i))
+               return False;
+            break;
+         case Cex_Unop:
+            if (e[i].Cex.Unop.op < Cunop_Abs
+                || e[i].Cex.Unop.op > Cunop_Not
+                || !expr_ix_ok(e[i].Cex.Unop.ix, i))
+               return False;
+            break;
+         case Cex_Binop:
+            if (e[i].Cex.Binop.op < Cbinop_Add
+                || e[i].Cex.Binop.op > Cbinop_Ne
+                || !expr_ix_ok(e[i].Cex.Binop.ixL, i)
+                || !expr_ix_ok(e[i].Cex.Binop.ixR, i))
+               return False;
+            break;
+         case Cex_CfiReg:
+            if (e[i].Cex.CfiReg.reg <= Creg_INVALID
+                || e[i].Cex.CfiReg.reg > Creg_MIPS_RA)
+               return False;
+            break;
+         default:
+            return False;
+      }
+   }
+   return True;
+}
+
+/* Check that all string, fndn, cfsi_m and expression references are
+   in range, and that the tables are in the order, and have the
+   postconditions, that ML_(canonicaliseTables) and
+   ML_(finish_CFSI_arrays) leave them in. */
+static Bool sections_ok ( const CacheHeader* h, const Sections* s )
+{
+   UWord i, n;
+
+   if ((h->n_strs == 0) != (h->strs_szB == 0))
+      return False;
+   if (h->n_strs > 0 && s->strs[h->strs_szB - 1] != 0)
+      return False;
+   n = 0;
+   for (i = 0; i < h->strs_szB; i++)
+      if (s->strs[i] == 0)
+         n++;
+   if (n != h->n_strs)
+      return False;
+
+   for (i = 0; i < h->n_fndn; i++) {
+      if (s->fndn[i].filename >= h->n_strs
+          || (s->fndn[i].dirname >= h->n_strs
+              && s->fndn[i].dirname != NO_STR))
+         return False;
+   }
+
+   n = 0;
+   for (i = 0; i < h->n_syms; i++) {
+      if (s->syms[i].pri_name >= h->n_strs
+          || s->syms[i].n_sec_names > h->n_sec_names - n)
+         return False;
+      n += s->syms[i].n_sec_names;
+   }
+   if (n != h->n_sec_names)
+      return False;
+   for (i = 0; i < h->n_sec_names; i++)
+      if (s->sec_names[i] >= h->n_strs)
+         return False;
+   for (i = 0; i + 1 < h->n_syms; i++) {
+      const SymAVMAs* a  = &s->syms[i].avmas;
+      const SymAVMAs* a1 = &s->syms[i + 1].avmas;
+      if (s->syms[i].size == 0
+          || a->main >= a1->main
+          || a->main + s->syms[i].size - 1 >= a1->main)
+         return False;
+   }
+
+   for (i = 0; i < h->n_locs; i++)
+      if (s->loc_fndn_ix[i] > h->n_fndn)
+         return False;
+   for (i = 0; i + 1 < h->n_locs; i++) {
+      if (s->locs[i].size == 0
+          || s->locs[i].addr >= s->locs[i + 1].addr
+          || s->locs[i].addr + s->locs[i].size - 1 >= s->locs[i + 1].addr)
+         return False;
+   }
+
+   for (i = 0; i < h->n_inls; i++) {
+      if (s->inls[i].inlinedfn >= h->n_strs
+          || s->inls[i].fndn_ix > h->n_fndn
+          || s->inls[i].lineno > MAX_LINENO
+          || s->inls[i].level > MAX_LEVEL
+          || s->inls[i].addr_lo >= s->inls[i].addr_hi
+          || (i > 0 && s->inls[i - 1].addr_lo > s->inls[i].addr_lo))
+         return False;
+   }
+
+   if ((h->n_cfsi == 0) != (h->n_cfsi_m == 0)
+       || (h->n_cfsi > 0 && h->cfsi_minavma > h->cfsi_maxavma))
+      return False;
+   for (i = 0; i < h->n_cfsi; i++) {
+      if (s->cfsi_m_ix[i] > h->n_cfsi_m
+          || s->cfsi_base[i] < h->cfsi_minavma
+          || s->cfsi_base[i] > h->cfsi_maxavma
+          || (i > 0 && s->cfsi_base[i - 1] >= s->cfsi_base[i]))
+         return False;
+   }
+   for (i = 0; i < h->n_cfsi_m; i++)
+      if (!cfsi_m_ok(&s->cfsi_m[i], h->n_cfsi_exprs))
+         return False;
+   return cfi_exprs_ok(s->cfsi_exprs, h->n_cfsi_exprs);
+}
+
+/* Check that the CFI, relocated by 'delta', only covers code in the
+   object's r-x mappings, as check_CFSI_related_invariants requires. */
+static Bool cfsi_mapped ( const DebugInfo* di, const CacheHeader* h,
+                          const Sections* s, PtrdiffT delta )
+{
+   RangeMap* rm;
+   UWord     i, key_min, key_max, val;
+   Addr      lo, hi;
+   Bool      ok = True;
+
+   if (h->n_cfsi == 0)
+      return True;
+
+   /* 1 for the mapped code, 0 elsewhere */
+   rm = VG_(newRangeMap)(ML_(dinfo_zalloc), "di.diskcache.cm.1",
+                         ML_(dinfo_free), 0);
+   for (i = 0; i < VG_(sizeXA)(di->fsm.maps); i++) {
+      const DebugInfoMapping* map = VG_(indexXA)(di->fsm.maps, i);
+      if (map->rx && map->size > 0)
+         VG_(bindRangeMap)(rm, map->avma, map->avma + map->size - 1, 1);
+   }
+   for (i = 0; i < h->n_cfsi && ok; i++) {
+      if (s->cfsi_m_ix[i] == 0)
+         continue; /* a hole */
+      lo = s->cfsi_base[i] + delta;
+      hi = (i + 1 < h->n_cfsi ? s->cfsi_base[i + 1] - 1
+                              : h->cfsi_maxavma) + delta;
+      if (hi < lo)
+         ok = False;
+      while (ok) {
+         VG_(lookupRangeMap)(&key_min, &key_max, &val, rm, lo);
+         if (val != 1)
+            ok = False;
+         else if (key_max >= hi)
+            break;
+         else
+            lo = key_max + 1;
+      }
+   }
+   VG_(deleteRangeMap)(rm);
+   return ok;
+}
+
+/* Move the checked sections into 'di', relocating them by 'delta'. */
+static void install_sections ( DebugInfo* di, const CacheHeader* h,
+                               const Sections* s, PtrdiffT delta )
+{
+   const HChar** strs;
+   UInt*         fndn_ix;
+   UInt*         cfsi_m_ix;
+   const HChar*  str;
+   UWord         i, j, k;
+
+   /* Strings, in the order they were numbered. */
+   strs = ML_(dinfo_zalloc)("di.diskcache.is.1",
+                            (h->n_strs + 1) * sizeof(HChar*));
+   str = s->strs;
+   for (i = 0; i < h->n_strs; i++) {
+      strs[i] = ML_(addStr)(di, str, -1);
+      str += VG_(strlen)(str) + 1;
+   }
+
+   /* File and directory names.  fndn_ix[] maps the file's fndn_ix
+      values to the new ones; 0 stays 0, "unknown". */
+   fndn_ix = ML_(dinfo_zalloc)("di.diskcache.is.2",
+                               (h->n_fndn + 1) * sizeof(UInt));
+   for (i = 0; i < h->n_fndn; i++) {
+      const CachedFnDn* cf = &s->fndn[i];
+      fndn_ix[i + 1]
+         = ML_(addFnDn)(di, strs[cf->filename],
+                        cf->dirname == NO_STR ? NULL : strs[cf->dirname]);
+   }
+
+   if (h->n_syms > 0) {
+      di->symtab = ML_(dinfo_zalloc)("di.diskcache.is.3",
+                                     h->n_syms * sizeof(DiSym));
+      k = 0;
+      for (i = 0; i < h->n_syms; i++) {
+         const CachedSym* cs  = &s->syms[i];
+         DiSym*           sym = &di->symtab[i];
+         sym->avmas = cs->avmas;
+         sym->avmas.main += delta;
+         if (GET_TOCPTR_AVMA(sym->avmas) != 0) {
+            SET_TOCPTR_AVMA(sym->avmas, GET_TOCPTR_AVMA(sym->avmas) + delta);
+         }
+         if (GET_LOCAL_EP_AVMA(sym->avmas) != 0) {
+            SET_LOCAL_EP_AVMA(sym->avmas,
+                              GET_LOCAL_EP_AVMA(sym->avmas) + delta);
+         }
+         sym->size     = cs->size;
+         sym->pri_name = strs[cs->pri_name];
+         if (cs->n_sec_names > 0) {
+            sym->sec_names
+               = ML_(dinfo_zalloc)("di.diskcache.is.4",
+                                   (cs->n_sec_names + 1) * sizeof(HChar*));
+            for (j = 0; j < cs->n_sec_names; j++)
+               sym->sec_names[j] = strs[s->sec_names[k++]];
+         }
+         sym->isText   = cs->isText;
+         sym->isIFunc  = cs->isIFunc;
+         sym->isGlobal = cs->isGlobal;
+      }
+      di->symtab_used = di->symtab_size = h->n_syms;
+   }
+
+   if (h->n_locs > 0) {
+      di->loctab = ML_(dinfo_zalloc)("di.diskcache.is.5",
+                                     h->n_locs * sizeof(DiLoc));
+      VG_(memcpy)(di->loctab, s->locs, h->n_locs * sizeof(DiLoc));
+      di->sizeof_fndn_ix = ix_size(h->n_fndn);
+      di->loctab_fndn_ix = ML_(dinfo_zalloc)("di.diskcache.is.6",
+                                             h->n_locs * di->sizeof_fndn_ix);
+      for (i = 0; i < h->n_locs; i++) {
+         di->loctab[i].addr += delta;
+         set_ix(di->loctab_fndn_ix, di->sizeof_fndn_ix, i,
+                fndn_ix[s->loc_fndn_ix[i]]);
+      }
+      di->loctab_used = di->loctab_size = h->n_locs;
+   }
+
+   if (h->n_inls > 0) {
+      di->inltab = ML_(dinfo_zalloc)("di.diskcache.is.7",
+                                     h->n_inls * sizeof(DiInlLoc));
+      for (i = 0; i < h->n_inls; i++) {
+         const CachedInl* ci  = &s->inls[i];
+         DiInlLoc*        inl = &di->inltab[i];
+         inl->addr_lo   = ci->addr_lo + delta;
+         inl->addr_hi   = ci->addr_hi + delta;
+         inl->inlinedfn = strs[ci->inlinedfn];
+         inl->fndn_ix   = fndn_ix[ci->fndn_ix];
+         inl->lineno    = ci->lineno;
+         inl->level     = ci->level;
+         if (inl->addr_hi - inl->addr_lo > di->maxinl_codesz)
+            di->maxinl_codesz = inl->addr_hi - inl->addr_lo;
+      }
+      di->inltab_used = di->inltab_size = h->n_inls;
+   }
+
+   /* The CFI, in the form ML_(finish_CFSI_arrays) leaves it in. */
+   if (h->n_cfsi_exprs > 0) {
+      di->cfsi_exprs = VG_(newXA)(ML_(dinfo_zalloc), "di.diskcache.is.8",
+                                  ML_(dinfo_free), sizeof(CfiExpr));
+      VG_(hintSizeXA)(di->cfsi_exprs, h->n_cfsi_exprs);
+      for (i = 0; i < h->n_cfsi_exprs; i++)
+         VG_(addToXA)(di->cfsi_exprs, &s->cfsi_exprs[i]);
+   }
+   if (h->n_cfsi > 0) {
+      cfsi_m_ix = ML_(dinfo_zalloc)("di.diskcache.is.9",
+                                    (h->n_cfsi_m + 1) * sizeof(UInt));
+      di->cfsi_m_pool = VG_(newDedupPA)(1000 * sizeof(DiCfSI_m),
+                                        vg_alignof(DiCfSI_m),
+                                        ML_(dinfo_zalloc),
+                                        "di.storage.DiCfSI_m_pool",
+                                        ML_(dinfo_free));
+      for (i = 0; i < h->n_cfsi_m; i++)
+         cfsi_m_ix[i + 1] = VG_(allocFixedEltDedupPA)(di->cfsi_m_pool,
+                                                      sizeof(DiCfSI_m),
+                                                      &s->cfsi_m[i]);
+      di->sizeof_cfsi_m_ix = ix_size(VG_(sizeDedupPA)(di->cfsi_m_pool));
+      di->cfsi_base = ML_(dinfo_zalloc)("di.diskcache.is.10",
+                                        h->n_cfsi * sizeof(Addr));
+      di->cfsi_m_ix = ML_(dinfo_zalloc)("di.diskcache.is.11",
+                                        h->n_cfsi * di->sizeof_cfsi_m_ix);
+      for (i = 0; i < h->n_cfsi; i++) {
+         di->cfsi_base[i] = s->cfsi_base[i] + delta;
+         set_ix(di->cfsi_m_ix, di->sizeof_cfsi_m_ix, i,
+                cfsi_m_ix[s->cfsi_m_ix[i]]);
+      }
+      di->cfsi_used = di->cfsi_size = h->n_cfsi;
+      di->cfsi_minavma = h->cfsi_minavma + delta;
+      di->cfsi_maxavma = h->cfsi_maxavma + delta;
+      ML_(dinfo_free)(cfsi_m_ix);
+      VG_(freezeDedupPA)(di->cfsi_m_pool, ML_(dinfo_shrink_block));
+   }
+
+   /* Nothing more will be added; see ML_(canonicaliseTables). */
+   if (di->strpool)
+      VG_(freezeDedupPA)(di->strpool, ML_(dinfo_shrink_block));
+   if (di->fndnpool)
+      VG_(freezeDedupPA)(di->fndnpool, ML_(dinfo_shrink_block));
+
+   ML_(dinfo_free)(fndn_ix);
+   ML_(dinfo_free)(strs);
+}
+
+Bool ML_(load_cached_DebugInfo) ( DebugInfo* di, const HChar* cache_file )
+{
+   DiImage*    img;
+   CacheHeader h;
+   Sections    s;
+   DiOffT      off;
+   PtrdiffT    delta = 0;
+   Bool        ok;
+
+   vg_assert(!di->cache_loaded);
+   vg_assert(di->symtab_used == 0 && di->loctab_used == 0
+             && di->inltab_used == 0 && di->cfsi_used == 0);
+
+   img = ML_(img_from_local_file)(cache_file);
+   if (img == NULL)
+      return False;
+
+   VG_(memset)(&s, 0, sizeof(s));
+   ok = ML_(img_real_size)(img) >= sizeof(h);
+   if (ok) {
+      ML_(img_get)(&h, img, 0, sizeof(h));
+      ok = header_ok(&h, ML_(img_real_size)(img), di, &delta);
+   }
+   if (ok) {
+      off = sizeof(h);
+      s.strs        = get_section(img, &off, h.strs_szB);
+      s.fndn        = get_section(img, &off, h.n_fndn * sizeof(CachedFnDn));
+      s.syms        = get_section(img, &off, h.n_syms * sizeof(CachedSym));
+      s.sec_names   = get_section(img, &off, h.n_sec_names * sizeof(UInt));
+      s.locs        = get_section(img, &off, h.n_locs * sizeof(DiLoc));
+      s.loc_fndn_ix = get_section(img, &off, h.n_locs * sizeof(UInt));
+      s.inls        = get_section(img, &off, h.n_inls * sizeof(CachedInl));
+      s.cfsi_base   = get_section(img, &off, h.n_cfsi * sizeof(Addr));
+      s.cfsi_m_ix   = get_section(img, &off, h.n_cfsi * sizeof(UInt));
+      s.cfsi_m      = get_section(img, &off, h.n_cfsi_m * sizeof(DiCfSI_m));
+      s.cfsi_exprs  = get_section(img, &off,
+                                  h.n_cfsi_exprs * sizeof(CfiExpr));
+      vg_assert(off == ML_(img_real_size)(img));
+      ok = sections_ok(&h, &s) && cfsi_mapped(di, &h, &s, delta);
+   }
+   ML_(img_done)(img);
+
+   if (ok) {
+      install_sections(di, &h, &s, delta);
+      di->cache_loaded = True;
+      TRACE_SYMTAB("\n------ Loaded tables from cache file %s ------\n",
+                   cache_file);
+      if (VG_(clo_verbosity) > 1)
+         VG_(message)(Vg_DebugMsg, "   using debug info cache file %s\n",
+                      cache_file);
+   } else if (VG_(clo_verbosity) > 1) {
+      VG_(message)(Vg_DebugMsg, "Warning: ignoring unusable debug info "
+                   "cache file %s\n", cache_file);
+   }
+   free_sections(&s);
+   return ok;
+}
+
+/*--------------------------------------------------------------------*/
+/*--- end                                              diskcache.c ---*/
+/*--------------------------------------------------------------------*/
@@ -41,6 +41,9 @@
 #include "pub_core_libcprint.h"
 #include "pub_core_libcproc.h"     /* VG_(read_millisecond_timer) */
 #include "pub_core_libcfile.h"
+#include "pub_core_aspacemgr.h"    /* VG_(am_mmap_file_float_valgrind) */
+#include "pub_core_mallocfree.h"   /* VG_(out_of_memory_NORETURN) */
+#include "pub_core_debuginfo.h"    /* VG_(lzo_compress) */
 #include "priv_misc.h"             /* dinfo_zalloc/free/strdup */
 #include "priv_image.h"            /* self */
 
@@ -57,6 +60,15 @@
 
 #define COMPRESSED_SLICE_ARRAY_GROW_SIZE 64
 
+/* Local files no bigger than this are mapped into memory in their
+   entirety, and read directly rather than through the cache.  On
+   32-bit hosts address space is too scarce to do that for big files. */
+#if VG_WORDSIZE == 4
+#  define MAP_MAX_SIZE  (256 * 1024 * 1024)
+#else
+#  define MAP_MAX_SIZE  (~(SizeT)0)
+#endif
+
 /* An entry in the cache. */
 typedef
    struct {
@@ -75,6 +87,9 @@ typedef
       SizeT  szD;   // size of decompressed data
       DiOffT offC;  // offset of compressed data
       SizeT  szC;   // size of compressed data
+      // For a mapped image, an anonymous mapping of szD bytes holding
+      // the decompressed data, or NULL if not decompressed yet.
+      UChar* data;
    }
    CSlc;
 
@@ -85,9 +100,15 @@ typedef
       Bool  is_local;
       // The fd for the local file, or sd for a remote server.
       Int   fd;
-      // The name.  In ML_(dinfo_zalloc)'d space.  Used only for printing
-      // error messages; hence it doesn't really matter what this contains.
+      // The name.  In ML_(dinfo_zalloc)'d space.  Used for printing
+      // error messages, and to reopen a parked local file.
       HChar* name;
+      // For a local file, its identity when the image was made, so that
+      // ML_(img_unpark) can tell if the file was replaced meanwhile.
+      ULong dev;
+      ULong ino;
+      ULong mtime;
+      ULong mtime_nsec;
       // The rest of these fields are only valid when using remote files
       // (that is, using a debuginfo server; hence when is_local==False)
       // Session ID allocated to us by the server.  Cannot be zero.
@@ -116,6 +137,14 @@ struct _DiImage {
    UInt  cslc_used;
    // Size of cslc array
    UInt  cslc_size;
+   // Index of the slice most recently read from, for a mapped image
+   UInt  cslc_last;
+
+   // If non-NULL, the local file is mapped here, and all reads are done
+   // directly from the mapping (or from the slices' decompressed data)
+   // rather than through the cache.  In that case the file itself has
+   // been closed, and ces[] is unused.
+   const UChar* map;
 };
 
 
@@ -801,9 +830,62 @@ static UChar get_slowcase ( DiImage* img, DiOffT off )
    return img->ces[i]->data[ off - img->ces[i]->off ];
 }
 
+/* Decompress compressed slice |cslc| of the mapped image |img| into a
+   new anonymous mapping.  The compressed data is read straight out of
+   the file mapping. */
+static void decompress_mapped_cslc ( const DiImage* img, CSlc* cslc )
+{
+   vg_assert(img->map != NULL && cslc->data == NULL);
+   vg_assert(cslc->offC + cslc->szC <= img->real_size);
+   SysRes sres = VG_(am_mmap_anon_float_valgrind)(cslc->szD);
+   if (sr_isError(sres))
+      VG_(out_of_memory_NORETURN)("di.image.decompress_mapped_cslc",
+                                  cslc->szD);
+   cslc->data = (UChar*)(Addr)sr_Res(sres);
+   SizeT len = tinfl_decompress_mem_to_mem(
+                  cslc->data, cslc->szD,
+                  img->map + cslc->offC, cslc->szC,
+                  TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF
+                  | TINFL_FLAG_PARSE_ZLIB_HEADER);
+   vg_assert(len == cslc->szD); // sanity check on data, FIXME
+}
+
+/* For a mapped image, return a pointer to the byte at |off|, which
+   must be above the real size and hence in a compressed slice.  The
+   slice is decompressed on first use.  *nAvail is set to the number
+   of bytes that can be read from the returned pointer. */
+__attribute__((noinline))
+static const UChar* get_mapped_cslc ( DiImage* img, DiOffT off,
+                                      /*OUT*/SizeT* nAvail )
+{
+   CSlc* cslc = NULL;
+   vg_assert(off >= img->real_size && off < img->size);
+   if (img->cslc_last < img->cslc_used) {
+      cslc = &img->cslc[img->cslc_last];
+      if (off - cslc->offD >= cslc->szD)
+         cslc = NULL;
+   }
+   if (cslc == NULL) {
+      cslc = find_cslc(img, off);
+      vg_assert(cslc != NULL);
+      img->cslc_last = cslc - img->cslc;
+   }
+   if (cslc->data == NULL)
+      decompress_mapped_cslc(img, cslc);
+   *nAvail = cslc->offD + cslc->szD - off;
+   return &cslc->data[off - cslc->offD];
+}
+
 // This is called a lot, so do the usual fast/slow split stuff on it. */
 static inline UChar get ( DiImage* img, DiOffT off )
 {
+   /* If the file is mapped, just read it. */
+   if (img->map != NULL) {
+      SizeT nAvail;
+      if (LIKELY(off < img->real_size))
+         return img->map[off];
+      return *get_mapped_cslc(img, off, &nAvail);
+   }
    /* Most likely case is, it's in the ces[0] position. */
    /* ML_(img_from_local_file) requests a read for ces[0] when
       creating the image.  Hence slot zero is always non-NULL, so we
@@ -816,6 +898,58 @@ static inline UChar get ( DiImage* img, DiOffT off )
    return get_slowcase(img, off);
 }
 
+/* Map in the first |size| bytes of the local file open on |fd|, or
+   return NULL if that can't be done. */
+static const UChar* map_local_file ( Int fd, SizeT size )
+{
+   if (size > MAP_MAX_SIZE)
+      return NULL;
+   SysRes sres = VG_(am_mmap_file_float_valgrind)(size, VKI_PROT_READ,
+                                                  fd, 0);
+   if (sr_isError(sres))
+      return NULL;
+   return (const UChar*)(Addr)sr_Res(sres);
+}
+
+/* Undo map_local_file, and drop the decompressed slices too. */
+static void unmap_local_file ( DiImage* img )
+{
+   UInt i;
+   vg_assert(img->map != NULL);
+   for (i = 0; i < img->cslc_used; i++) {
+      if (img->cslc[i].data != NULL) {
+         VG_(am_munmap_valgrind)((Addr)img->cslc[i].data, img->cslc[i].szD);
+         img->cslc[i].data = NULL;
+      }
+   }
+   VG_(am_munmap_valgrind)((Addr)img->map, img->real_size);
+   img->map = NULL;
+}
+
+/* Give |img| access to the local file open on |fd|.  Preferably the
+   file is mapped in, in which case |fd| is no longer needed and is
+   closed.  Otherwise it is read through the cache, and if the cache is
+   empty its zeroth entry is loaded with the first chunk of the file.
+   That's likely to be the first part that's requested anyway, and
+   having it there forces img->ces[0] to always be non-empty, thereby
+   saving us an is-it-empty check on the fast path in get(). */
+static void attach_local_file ( DiImage* img, Int fd )
+{
+   vg_assert(img->source.is_local && img->map == NULL);
+   img->map = map_local_file(fd, img->real_size);
+   if (img->map != NULL) {
+      VG_(close)(fd);
+      img->source.fd = -1;
+      return;
+   }
+   img->source.fd = fd;
+   if (img->ces_used == 0) {
+      UInt entNo = alloc_CEnt(img, CACHE_ENTRY_SIZE, False/*!fromC*/);
+      vg_assert(entNo == 0);
+      set_CEnt(img, 0, 0);
+   }
+}
+
 /* Create an image from a file in the local filesystem.  This is
    relatively straightforward. */
 DiImage* ML_(img_from_local_file)(const HChar* fullpath)
@@ -843,25 +977,23 @@ DiImage* ML_(img_from_local_file)(const HChar* fullpath)
 
    DiImage* img = ML_(dinfo_zalloc)("di.image.ML_iflf.1", sizeof(DiImage));
    img->source.is_local = True;
-   img->source.fd       = sr_Res(fd);
+   img->source.fd       = -1;
    img->size            = size;
    img->real_size       = size;
    img->ces_used        = 0;
    img->source.name     = ML_(dinfo_strdup)("di.image.ML_iflf.2", fullpath);
+   img->source.dev        = stat_buf.dev;
+   img->source.ino        = stat_buf.ino;
+   img->source.mtime      = stat_buf.mtime;
+   img->source.mtime_nsec = stat_buf.mtime_nsec;
    img->cslc            = NULL;
    img->cslc_size       = 0;
    img->cslc_used       = 0;
+   img->cslc_last       = 0;
+   img->map             = NULL;
    /* img->ces is already zeroed out */
-   vg_assert(img->source.fd >= 0);
 
-   /* Force the zeroth entry to be the first chunk of the file.
-      That's likely to be the first part that's requested anyway, and
-      loading it at this point forcing img->cent[0] to always be
-      non-empty, thereby saving us an is-it-empty check on the fast
-      path in get(). */
-   UInt entNo = alloc_CEnt(img, CACHE_ENTRY_SIZE, False/*!fromC*/);
-   vg_assert(entNo == 0);
-   set_CEnt(img, 0, 0);
+   attach_local_file(img, sr_Res(fd));
 
    return img;
 }
@@ -948,8 +1080,7 @@ DiImage* ML_(img_from_di_server)(const HChar* filename,
    /* img->ces is already zeroed out */
    vg_assert(img->source.fd >= 0);
 
-   /* See comment on equivalent bit in ML_(img_from_local_file) for
-      rationale. */
+   /* See comment on attach_local_file for rationale. */
    UInt entNo = alloc_CEnt(img, CACHE_ENTRY_SIZE, False/*!fromC*/);
    vg_assert(entNo == 0);
    set_CEnt(img, 0, 0);
@@ -994,18 +1125,72 @@ DiOffT ML_(img_mark_compressed_part)(DiImage* img, DiOffT offset, SizeT szC,
    img->cslc[img->cslc_used].szC = szC;
    img->cslc[img->cslc_used].offD = img->size;
    img->cslc[img->cslc_used].szD = szD;
+   img->cslc[img->cslc_used].data = NULL;
    img->size += szD;
    img->cslc_used++;
    return ret;
 }
 
+void ML_(img_park)(DiImage* img)
+{
+   UInt i;
+   vg_assert(img != NULL);
+   if (!img->source.is_local)
+      return;
+   if (img->map != NULL) {
+      unmap_local_file(img);
+      return;
+   }
+   if (img->source.fd < 0)
+      return;
+   VG_(close)(img->source.fd);
+   img->source.fd = -1;
+   /* Keep ces[0], as get() relies on it being present. */
+   vg_assert(img->ces_used >= 1 && img->ces_used <= CACHE_N_ENTRIES);
+   for (i = 1; i < img->ces_used; i++) {
+      ML_(dinfo_free)(img->ces[i]);
+      img->ces[i] = NULL;
+   }
+   img->ces_used = 1;
+}
+
+Bool ML_(img_unpark)(DiImage* img)
+{
+   SysRes         fd;
+   struct vg_stat stat_buf;
+
+   vg_assert(img != NULL);
+   if (!img->source.is_local || img->source.fd >= 0 || img->map != NULL)
+      return True;
+   fd = VG_(open)(img->source.name, VKI_O_RDONLY, 0);
+   if (sr_isError(fd))
+      return False;
+   /* The file may have been rebuilt or replaced since it was parked,
+      in which case the slices taken from it are meaningless. */
+   if (VG_(fstat)(sr_Res(fd), &stat_buf) != 0
+       || stat_buf.size       != img->real_size
+       || stat_buf.dev        != img->source.dev
+       || stat_buf.ino        != img->source.ino
+       || stat_buf.mtime      != img->source.mtime
+       || stat_buf.mtime_nsec != img->source.mtime_nsec) {
+      VG_(close)(sr_Res(fd));
+      return False;
+   }
+   attach_local_file(img, sr_Res(fd));
+   return True;
+}
+
 void ML_(img_done)(DiImage* img)
 {
    vg_assert(img != NULL);
    if (img->source.is_local) {
-      /* Close the file; nothing else to do. */
+      /* Unmap or close the file, unless the image is parked; nothing
+         else to do. */
       vg_assert(img->source.session_id == 0);
-      VG_(close)(img->source.fd);
+      if (img->map != NULL)
+         unmap_local_file(img);
+      if (img->source.fd >= 0)
+         VG_(close)(img->source.fd);
    } else {
       /* Close the socket.  The server can detect this and will scrub
          the connection when it happens, so there's no need to tell it
@@ -1077,12 +1262,37 @@ static void ensure_valid(const DiImage* img, DiOffT offset, SizeT size,
 }
 
 
+/* ML_(img_get_some) for a mapped image: copy as much of the range as
+   is contiguous in memory. */
+static SizeT get_some_mapped ( /*OUT*/UChar* dst,
+                               DiImage* img, DiOffT offset, SizeT size )
+{
+   const UChar* src;
+   SizeT nAvail;
+   if (offset < img->real_size) {
+      src    = img->map + offset;
+      nAvail = img->real_size - offset;
+   } else {
+      src = get_mapped_cslc(img, offset, &nAvail);
+   }
+   if (nAvail > size) nAvail = size;
+   VG_(memcpy)(dst, src, nAvail);
+   return nAvail;
+}
+
 void ML_(img_get)(/*OUT*/void* dst,
                   DiImage* img, DiOffT offset, SizeT size)
 {
    vg_assert(img != NULL);
    vg_assert(size > 0);
    ensure_valid(img, offset, size, "ML_(img_get)");
+   if (img->map != NULL) {
+      SizeT nGot = 0;
+      while (nGot < size)
+         nGot += get_some_mapped((UChar*)dst + nGot, img,
+                                 offset + nGot, size - nGot);
+      return;
+   }
    SizeT i;
    for (i = 0; i < size; i++) {
       ((UChar*)dst)[i] = get(img, offset + i);
@@ -1095,6 +1305,8 @@ SizeT ML_(img_get_some)(/*OUT*/void* dst,
    vg_assert(img != NULL);
    vg_assert(size > 0);
    ensure_valid(img, offset, size, "ML_(img_get_some)");
+   if (img->map != NULL)
+      return get_some_mapped(dst, img, offset, size);
    UChar* dstU = (UChar*)dst;
    /* Use |get| in the normal way to get the first byte of the range.
       This guarantees to put the cache entry containing |offset| in
@@ -1317,6 +1529,24 @@ UInt ML_(img_calc_gnu_debuglink_crc32)(DiImage* img)
 ////////////////////////////////////////////////////
 #include "minilzo-inl.c"
 
+/* See pub_tool_debuginfo.h. */
+SizeT VG_(lzo_compress)( UChar* dst, const UChar* src, SizeT src_len )
+{
+   /* The compressor's dictionary; allocated on first use, so that
+      only tools that compress anything pay for it. */
+   static void* wrkmem = NULL;
+   lzo_uint dst_len = VG_LZO_MAX_COMPRESSED(src_len);
+   Int lzo_rc;
+
+   if (wrkmem == NULL)
+      wrkmem = ML_(dinfo_zalloc)("di.image.lzo_compress.1",
+                                 LZO1X_1_MEM_COMPRESS);
+   lzo_rc = lzo1x_1_compress(src, src_len, dst, &dst_len, wrkmem);
+   vg_assert(lzo_rc == LZO_E_OK);
+   vg_assert(dst_len <= VG_LZO_MAX_COMPRESSED(src_len));
+   return dst_len;
+}
+
 /*--------------------------------------------------------------------*/
 /*--- end                                                  image.c ---*/
 /*--------------------------------------------------------------------*/
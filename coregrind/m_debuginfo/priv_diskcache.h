@@ -0,0 +1,76 @@
+/*--------------------------------------------------------------------*/
+/*--- On-disk cache of debuginfo tables.          priv_diskcache.h ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   Copyright (C) 2019 The Valgrind developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#ifndef __PRIV_DISKCACHE_H
+#define __PRIV_DISKCACHE_H
+
+#include "pub_core_basics.h"      // Bool
+#include "pub_core_debuginfo.h"   // DebugInfo
+
+/* With --debuginfo-cache=<dir>, the canonicalised symbol, line number,
+   inlined call and CFI tables of each object that has an ELF build-id
+   are saved in a file in <dir>, and later runs load them from there
+   instead of reading the object's symbol tables, CFI and DWARF info
+   again.  Variable info is not cached, so the cache is not used when
+   it is to be read. */
+
+/* What an object's tables were read from, besides its build-id, which
+   'strip' and the like keep: the DiCache_ flags of the objects and
+   sections found, and the sizes of the main and separate debuginfo
+   objects.  Copies of an object that differ in any of these are
+   cached under different names. */
+#define DiCache_DImg        (1 << 0)  /* a separate debuginfo object */
+#define DiCache_AImg        (1 << 1)  /* an alternate (dwz) object */
+#define DiCache_Symtab      (1 << 2)  /* .symtab */
+#define DiCache_DebugLine   (1 << 3)  /* .debug_line */
+#define DiCache_DebugInfo   (1 << 4)  /* .debug_info */
+#define DiCache_DebugFrame  (1 << 5)  /* .debug_frame */
+
+/* Returns the name of the cache file for the object with build-id
+   'buildid', read from what 'found' (DiCache_ flags), 'm_szB' and
+   'd_szB' (0 if there is no separate debuginfo object) describe, in
+   ML_(dinfo_zalloc)'d space, or NULL if the cache is not in use. */
+extern HChar* ML_(cache_file_name) ( const HChar* buildid, UInt found,
+                                     ULong m_szB, ULong d_szB );
+
+/* Tries to fill in the tables of 'di' from 'cache_file'.  On success,
+   returns True and sets di->cache_loaded; the tables are then complete
+   and canonicalised.  Returns False, leaving 'di' untouched, if there
+   is no usable cache file. */
+extern Bool ML_(load_cached_DebugInfo) ( DebugInfo* di,
+                                         const HChar* cache_file );
+
+/* If di->cache_file is set, saves the (canonicalised) tables of 'di'
+   there, and clears it. */
+extern void ML_(save_cached_DebugInfo) ( DebugInfo* di );
+
+#endif /* ndef __PRIV_DISKCACHE_H */
+
+/*--------------------------------------------------------------------*/
+/*--- end                                         priv_diskcache.h ---*/
+/*--------------------------------------------------------------------*/
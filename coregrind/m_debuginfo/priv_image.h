@@ -58,7 +58,9 @@ typedef  ULong  DiOffT;
 #define DiOffT_INVALID ((DiOffT)(0xFFFFFFFFFFFFFFFFULL))
 
 /* Create an image from a file in the local filesysem.  Returns NULL
-   if it fails, for whatever reason. */
+   if it fails, for whatever reason.  Where possible the file is mapped
+   into memory, so that reading the image costs no more than reading
+   memory; otherwise it is read on demand through a cache. */
 DiImage* ML_(img_from_local_file)(const HChar* fullpath);
 
 /* Create an image by connecting to a Valgrind debuginfo server
@@ -74,6 +76,17 @@ DiImage* ML_(img_from_di_server)(const HChar* filename,
 /* Destroy an existing image. */
 void ML_(img_done)(DiImage*);
 
+/* Park an image that will not be read for a while: unmap or close the
+   file and drop all but the first cache entry, keeping everything else
+   (in particular, slices into it stay valid).  An image from a
+   debuginfo server is left as is.  ML_(img_unpark) must be called
+   before the image is read again; it reopens the file and returns
+   False if that fails or the file is not the one the image was made
+   from (its device, inode, size or mtime differ), in which case the
+   image must only be passed to ML_(img_done). */
+void ML_(img_park)(DiImage* img);
+Bool ML_(img_unpark)(DiImage* img);
+
 /* Virtual size of the image. */
 DiOffT ML_(img_size)(const DiImage* img);
 
@@ -54,6 +54,14 @@ extern Bool ML_(is_elf_object_file)( const void* image, SizeT n_image,
 */
 extern Bool ML_(read_elf_debug_info) ( DebugInfo* di );
 
+/* Read the parts 'what' (DiDefer_ flags) of the debug info of 'di'
+   whose reading ML_(read_elf_debug_info) deferred, and clear them from
+   di->deferred.  The tables read still need to be canonicalised. */
+extern void ML_(read_elf_deferred) ( DebugInfo* di, UInt what );
+
+/* Release what is kept for reading deferred debug info, if anything. */
+extern void ML_(discard_elf_deferred) ( DebugInfo* di );
+
 
 #endif /* ndef __PRIV_READELF_H */
 
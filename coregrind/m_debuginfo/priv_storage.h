@@ -1016,8 +1016,29 @@ struct _DebugInfo {
       This helps performance a lot during ML_(addLineInfo) etc., which can
       easily be invoked hundreds of thousands of times. */
    DebugInfoMapping* last_rx_map;
+
+   /* With --lazy-debuginfo=yes, the reading of the call frame info
+      and of the DWARF line/inline/variable info is postponed until
+      they are first needed.  .deferred holds the DiDefer_ flags of
+      the parts not read yet, and .deferred_info what the reader needs
+      to read them later (it is private to the reader).  Tables that
+      are still deferred are empty, and .strpool and .fndnpool are not
+      frozen as long as DiDefer_DWARF is set. */
+   UInt deferred;
+   struct _DeferredDebugInfo* deferred_info;
+
+   /* With --debuginfo-cache=<dir>: .cache_file is the file the tables
+      are to be saved in once read and canonicalised, and .cache_loaded
+      says that they were instead loaded, already canonicalised, from
+      one.  See priv_diskcache.h. */
+   HChar* cache_file;
+   Bool   cache_loaded;
 };
 
+/* Flags for DebugInfo.deferred. */
+#define DiDefer_CFI   (1 << 0)  /* .eh_frame, .debug_frame, .ARM.exidx */
+#define DiDefer_DWARF (1 << 1)  /* line numbers, inline and var info */
+
 /* --------------------- functions --------------------- */
 
 /* ------ Adding ------ */
@@ -1110,6 +1131,12 @@ extern void ML_(addVar)( struct _DebugInfo* di,
    this after finishing adding entries to these tables. */
 extern void ML_(canonicaliseTables) ( struct _DebugInfo* di );
 
+/* Likewise, but only for the tables filled in by a deferred read of
+   the parts 'what' (DiDefer_ flags).  Call this after the read, once
+   the flags have been cleared from di->deferred. */
+extern void ML_(canonicaliseDeferredTables) ( struct _DebugInfo* di,
+                                              UInt what );
+
 /* Canonicalise the call-frame-info table held by 'di', in preparation
    for use. This is called by ML_(canonicaliseTables) but can also be
    called on it's own to sort just this table. */
@@ -650,6 +650,11 @@ static GExpr* make_singleton_GX ( DiCursor block, ULong nbytes )
    return gx;
 }
 
+/* Build a GExpr from the location list at 'debug_loc_offset' in
+   .debug_loc.  Location lists can be many and long, so this is done in
+   two passes over the list: the first one finds out the size of the
+   GExpr, and the second one fills it in place, copying each location
+   expression in one go. */
 __attribute__((noinline))
 static GExpr* make_general_GX ( const CUConst* cc,
                                 Bool     td3,
@@ -658,9 +663,9 @@ static GExpr* make_general_GX ( const CUConst* cc,
 {
    Addr      base;
    Cursor    loc;
-   XArray*   xa; /* XArray of UChar */
    GExpr*    gx;
-   Word      nbytes;
+   SizeT     nbytes;
+   UChar     *p, *pstart;
 
    vg_assert(sizeof(UWord) == sizeof(Addr));
    if (!ML_(sli_is_valid)(cc->escn_debug_loc) || cc->escn_debug_loc.szB == 0)
@@ -673,16 +678,9 @@ static GExpr* make_general_GX ( const CUConst* cc,
    TRACE_D3("make_general_GX (.debug_loc_offset = %llu, ioff = %llu) {\n",
             debug_loc_offset, get_DiCursor_from_Cursor(&loc).ioff );
 
-   /* Who frees this xa?  It is freed before this fn exits. */
-   xa = VG_(newXA)( ML_(dinfo_zalloc), "di.readdwarf3.mgGX.1", 
-                    ML_(dinfo_free),
-                    sizeof(UChar) );
-
-   { UChar c = 1; /*biasMe*/ VG_(addBytesToXA)( xa, &c, sizeof(c) ); }
-
-   base = 0;
+   /* First pass: size the GExpr, and check the list is well formed. */
+   nbytes = sizeof(UChar) /*biasMe*/ + sizeof(UChar) /*isEnd*/;
    while (True) {
-      Bool  acquire;
       UWord len;
       /* Read a (host-)word pair.  This is something of a hack since
          the word size to read is really dictated by the ELF file;
@@ -691,6 +689,45 @@ static GExpr* make_general_GX ( const CUConst* cc,
       UWord w1 = get_UWord( &loc );
       UWord w2 = get_UWord( &loc );
 
+      if (w1 == 0 && w2 == 0)
+         break; /* end of list */
+
+      if (w1 == -1UL)
+         continue; /* new value for 'base' */
+
+      /* else a location expression follows */
+      if (w1 > w2) {
+         TRACE_D3("negative range is for .debug_loc expr at "
+                  "file offset %llu\n", 
+                  debug_loc_offset);
+         cc->barf( "negative range in .debug_loc section" );
+      }
+
+      len = (UWord)get_UShort( &loc );
+      if (get_remaining_length_Cursor( &loc ) < (Long)len)
+         loc.barf(loc.barfstr);
+      advance_position_of_Cursor( &loc, len );
+
+      /* ignore zero length ranges */
+      if (w1 < w2)
+         nbytes +=   sizeof(UChar)  /*!isEnd*/
+                   + sizeof(UWord)  /*aMin*/ + sizeof(UWord) /*aMax*/
+                   + sizeof(UShort) /*nbytes*/ + len;
+   }
+
+   gx = ML_(dinfo_zalloc)( "di.readdwarf3.mgGX.2", sizeof(GExpr) + nbytes );
+   p = pstart = &gx->payload[0];
+
+   /* Second pass: fill it in. */
+   set_position_of_Cursor( &loc, debug_loc_offset );
+   p = ML_(write_UChar)(p, 1); /*biasMe*/
+
+   base = 0;
+   while (True) {
+      UWord len;
+      UWord w1 = get_UWord( &loc );
+      UWord w2 = get_UWord( &loc );
+
       TRACE_D3("   %08lx %08lx\n", w1, w2);
       if (w1 == 0 && w2 == 0)
          break; /* end of list */
@@ -701,57 +738,38 @@ static GExpr* make_general_GX ( const CUConst* cc,
          continue;
       }
 
-      /* else a location expression follows */
       /* else enumerate [w1+base, w2+base) */
       /* w2 is 1 past end of range, as per D3 defn for "DW_AT_high_pc"
          (sec 2.17.2) */
-      if (w1 > w2) {
-         TRACE_D3("negative range is for .debug_loc expr at "
-                  "file offset %llu\n", 
-                  debug_loc_offset);
-         cc->barf( "negative range in .debug_loc section" );
-      }
+      len = (UWord)get_UShort( &loc );
 
-      /* ignore zero length ranges */
-      acquire = w1 < w2;
-      len     = (UWord)get_UShort( &loc );
-
-      if (acquire) {
-         UWord  w;
-         UShort s;
-         UChar  c;
-         c = 0; /* !isEnd*/
-         VG_(addBytesToXA)( xa, &c, sizeof(c) );
-         w = w1    + base + svma_of_referencing_CU;
-         VG_(addBytesToXA)( xa, &w, sizeof(w) );
-         w = w2 -1 + base + svma_of_referencing_CU;
-         VG_(addBytesToXA)( xa, &w, sizeof(w) );
-         s = (UShort)len;
-         VG_(addBytesToXA)( xa, &s, sizeof(s) );
+      if (w1 < w2) {
+         p = ML_(write_UChar)(p, 0); /*!isEnd*/
+         p = ML_(write_Addr)(p, w1    + base + svma_of_referencing_CU);
+         p = ML_(write_Addr)(p, w2 -1 + base + svma_of_referencing_CU);
+         p = ML_(write_UShort)(p, (UShort)len);
+         if (len > 0)
+            ML_(cur_read_get)(p, get_DiCursor_from_Cursor(&loc), len);
+         p += len;
       }
 
-      while (len > 0) {
-         UChar byte = get_UChar( &loc );
-         TRACE_D3("%02x", (UInt)byte);
-         if (acquire)
-            VG_(addBytesToXA)( xa, &byte, 1 );
-         len--;
+      if (TD3) {
+         UWord i;
+         for (i = 0; i < len; i++)
+            TRACE_D3("%02x", (UInt)ML_(cur_read_UChar)(
+                                 ML_(cur_plus)(get_DiCursor_from_Cursor(&loc),
+                                               i)));
       }
+      advance_position_of_Cursor( &loc, len );
       TRACE_D3("\n");
    }
 
-   { UChar c = 1; /*isEnd*/ VG_(addBytesToXA)( xa, &c, sizeof(c) ); }
-
-   nbytes = VG_(sizeXA)( xa );
-   vg_assert(nbytes >= 1);
+   p = ML_(write_UChar)(p, 1); /*isEnd*/
 
-   gx = ML_(dinfo_zalloc)( "di.readdwarf3.mgGX.2", sizeof(GExpr) + nbytes );
-   VG_(memcpy)( &gx->payload[0], (UChar*)VG_(indexXA)(xa,0), nbytes );
+   vg_assert( (SizeT)(p - pstart) == nbytes );
    vg_assert( &gx->payload[nbytes] 
               == ((UChar*)gx) + sizeof(GExpr) + nbytes );
 
-   VG_(deleteXA)( xa );
-
    TRACE_D3("}\n");
 
    return gx;
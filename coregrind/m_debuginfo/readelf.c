@@ -53,6 +53,7 @@
 #include "priv_readdwarf.h"        /* 'cos ELF contains DWARF */
 #include "priv_readdwarf3.h"
 #include "priv_readexidx.h"
+#include "priv_diskcache.h"
 #include "config.h"
 
 /* --- !!! --- EXTERNAL HEADERS start --- !!! --- */
@@ -1607,6 +1608,209 @@ static HChar* readlink_path (const HChar *path)
   return buf;
 }
 
+/* What is needed to read the call frame info and the DWARF line,
+   inline and variable info of an object, once its sections have been
+   found.  With --lazy-debuginfo=yes, ML_(read_elf_debug_info) hangs a
+   copy of it off the DebugInfo, together with the (parked) images the
+   slices refer to, and ML_(read_elf_deferred) reads these parts when
+   they are first needed. */
+struct _DeferredDebugInfo {
+   DiImage* mimg;
+   DiImage* dimg;
+   DiImage* aimg;
+   DiSlice  ehframe_escn[N_EHFRAME_SECTS];
+   DiSlice  debug_frame_escn;
+   DiSlice  debug_line_escn;
+   DiSlice  debug_info_escn;
+   DiSlice  debug_types_escn;
+   DiSlice  debug_abbv_escn;
+   DiSlice  debug_str_escn;
+   DiSlice  debug_ranges_escn;
+   DiSlice  debug_loc_escn;
+   DiSlice  debug_line_alt_escn;
+   DiSlice  debug_info_alt_escn;
+   DiSlice  debug_abbv_alt_escn;
+   DiSlice  debug_str_alt_escn;
+};
+
+/* Which parts of the debug info described by 'dd' there is anything
+   to read for, as DiDefer_ flags. */
+static UInt deferrable_parts ( const struct _DebugInfo* di,
+                               const struct _DeferredDebugInfo* dd )
+{
+   UInt what = 0;
+   if (di->n_ehframe > 0 || ML_(sli_is_valid)(dd->debug_frame_escn))
+      what |= DiDefer_CFI;
+#  if defined(VGA_arm)
+   if (di->exidx_present)
+      what |= DiDefer_CFI;
+#  endif
+   if (ML_(sli_is_valid)(dd->debug_info_escn) 
+       && ML_(sli_is_valid)(dd->debug_abbv_escn)
+       && ML_(sli_is_valid)(dd->debug_line_escn))
+      what |= DiDefer_DWARF;
+   return what;
+}
+
+/* Read .eh_frame, .debug_frame and (ARM32 only) .exidx. */
+static void read_elf_cfi ( struct _DebugInfo* di,
+                           const struct _DeferredDebugInfo* dd )
+{
+   UInt i;
+
+   /* Do the .eh_frame section(s) first. */
+   vg_assert(di->n_ehframe >= 0 && di->n_ehframe <= N_EHFRAME_SECTS);
+   for (i = 0; i < di->n_ehframe; i++) {
+      /* see Comment_on_EH_FRAME_MULTIPLE_INSTANCES below for why
+         this next assertion should hold. */
+      vg_assert(ML_(sli_is_valid)(dd->ehframe_escn[i]));
+      vg_assert(dd->ehframe_escn[i].szB == di->ehframe_size[i]);
+      ML_(read_callframe_info_dwarf3)( di,
+                                       dd->ehframe_escn[i],
+                                       di->ehframe_avma[i],
+                                       True/*is_ehframe*/ );
+   }
+   if (ML_(sli_is_valid)(dd->debug_frame_escn)) {
+      ML_(read_callframe_info_dwarf3)( di,
+                                       dd->debug_frame_escn,
+                                       0/*assume zero avma*/,
+                                       False/*!is_ehframe*/ );
+   }
+
+#  if defined(VGA_arm)
+   /* ARM32 only: read .exidx/.extab if present.  Note we are
+      reading these directly out of the mapped in (running) image.
+      Also, read these only if no CFI based unwind info was
+      acquired for this file.
+
+      An .exidx section is always required, but the .extab section
+      can be optionally omitted, provided that .exidx does not
+      refer to it.  If the .exidx is erroneous and does refer to
+      .extab even though .extab is missing, the range checks done
+      by GET_EX_U32 in ExtabEntryExtract in readexidx.c should
+      prevent any invalid memory accesses, and cause the .extab to
+      be rejected as invalid.
+
+      FIXME:
+      * check with m_aspacemgr that the entire [exidx_avma, +exidx_size)
+        and [extab_avma, +extab_size) areas are readable, since we're
+        reading this stuff out of the running image (not from a file/socket)
+        and we don't want to segfault.
+      * DebugInfo::exidx_bias and use text_bias instead.
+        I think it's always the same.
+      * remove DebugInfo::{extab_bias, exidx_svma, extab_svma} since
+        they are never used.
+   */
+   if (di->exidx_present
+       && di->cfsi_used == 0
+       && di->text_present && di->text_size > 0) {
+      Addr text_last_svma = di->text_svma + di->text_size - 1;
+      ML_(read_exidx)( di, (UChar*)di->exidx_avma, di->exidx_size,
+                           (UChar*)di->extab_avma, di->extab_size,
+                           text_last_svma,
+                           di->exidx_bias );
+   }
+#  endif /* defined(VGA_arm) */
+}
+
+/* Read the DWARF line number info and, if asked for, the inline and
+   variable info. */
+static void read_elf_dwarf ( struct _DebugInfo* di,
+                             const struct _DeferredDebugInfo* dd )
+{
+   /* jrs 2006-01-01: icc-8.1 has been observed to generate
+      binaries without debug_str sections.  Don't preclude
+      debuginfo reading for that reason, but, in
+      read_unitinfo_dwarf2, do check that debugstr is non-NULL
+      before using it. */
+   if (ML_(sli_is_valid)(dd->debug_info_escn) 
+       && ML_(sli_is_valid)(dd->debug_abbv_escn)
+       && ML_(sli_is_valid)(dd->debug_line_escn)) {
+      /* The old reader: line numbers and unwind info only */
+      ML_(read_debuginfo_dwarf3) ( di,
+                                   dd->debug_info_escn,
+                                   dd->debug_types_escn,
+                                   dd->debug_abbv_escn,
+                                   dd->debug_line_escn,
+                                   dd->debug_str_escn,
+                                   dd->debug_str_alt_escn );
+      /* The new reader: read the DIEs in .debug_info to acquire
+         information on variable types and locations or inline info.
+         But only if the tool asks for it, or the user requests it on
+         the command line. */
+      if (VG_(clo_read_var_info) /* the user or tool asked for it */
+          || VG_(clo_read_inline_info)) {
+         ML_(new_dwarf3_reader)(
+            di, dd->debug_info_escn,     dd->debug_types_escn,
+                dd->debug_abbv_escn,     dd->debug_line_escn,
+                dd->debug_str_escn,      dd->debug_ranges_escn,
+                dd->debug_loc_escn,      dd->debug_info_alt_escn,
+                dd->debug_abbv_alt_escn, dd->debug_line_alt_escn,
+                dd->debug_str_alt_escn
+         );
+      }
+   }
+}
+
+static void park_deferred_images ( struct _DeferredDebugInfo* dd )
+{
+   if (dd->mimg) ML_(img_park)(dd->mimg);
+   if (dd->dimg) ML_(img_park)(dd->dimg);
+   if (dd->aimg) ML_(img_park)(dd->aimg);
+}
+
+static Bool unpark_deferred_images ( struct _DeferredDebugInfo* dd )
+{
+   return (!dd->mimg || ML_(img_unpark)(dd->mimg))
+          && (!dd->dimg || ML_(img_unpark)(dd->dimg))
+          && (!dd->aimg || ML_(img_unpark)(dd->aimg));
+}
+
+void ML_(read_elf_deferred) ( struct _DebugInfo* di, UInt what )
+{
+   struct _DeferredDebugInfo* dd = di->deferred_info;
+
+   vg_assert(dd != NULL);
+   vg_assert((what & ~di->deferred) == 0);
+   /* Clear the flags first, so that nothing done while reading can
+      trigger the same read again. */
+   di->deferred &= ~what;
+
+   if (unpark_deferred_images(dd)) {
+      TRACE_SYMTAB("\n------ Reading deferred debug info (%s%s) "
+                   "for %s ------\n",
+                   what & DiDefer_CFI ? "CFI " : "",
+                   what & DiDefer_DWARF ? "DWARF" : "",
+                   di->fsm.filename);
+      if (what & DiDefer_CFI)
+         read_elf_cfi(di, dd);
+      if (what & DiDefer_DWARF)
+         read_elf_dwarf(di, dd);
+      park_deferred_images(dd);
+   } else if (VG_(clo_verbosity) > 0) {
+      VG_(message)(Vg_UserMsg,
+                   "Warning: cannot read debug info for %s any more; "
+                   "it has changed or disappeared since it was loaded\n",
+                   di->fsm.filename);
+   }
+
+   if (di->deferred == 0)
+      ML_(discard_elf_deferred)(di);
+}
+
+void ML_(discard_elf_deferred) ( struct _DebugInfo* di )
+{
+   struct _DeferredDebugInfo* dd = di->deferred_info;
+
+   if (dd == NULL)
+      return;
+   if (dd->mimg) ML_(img_done)(dd->mimg);
+   if (dd->dimg) ML_(img_done)(dd->dimg);
+   if (dd->aimg) ML_(img_done)(dd->aimg);
+   ML_(dinfo_free)(dd);
+   di->deferred_info = NULL;
+}
+
 /* The central function for reading ELF debug info.  For the
    object/exe specified by the DebugInfo, find ELF sections, then read
    the symbols, line number info, file name info, CFA (stack-unwind
@@ -1659,6 +1863,10 @@ Bool ML_(read_elf_debug_info) ( struct _DebugInfo* di )
    /* Ditto for alternate ELF debuginfo file that we might happen to load. */
    DiImage* aimg = NULL;
 
+   /* The build-id of the main file, if its tables may be cached with
+      --debuginfo-cache.  In ML_(dinfo_zalloc)'d space. */
+   HChar* cache_buildid = NULL;
+
    /* ELF header offset for the main file.  Should be zero since the
       ELF header is at start of file. */
    DiOffT   ehdr_mioff = 0;
@@ -2750,10 +2958,11 @@ Bool ML_(read_elf_debug_info) ( struct _DebugInfo* di )
          }
       }
 
-      if (buildid) {
-         ML_(dinfo_free)(buildid);
-         buildid = NULL; /* paranoia */
-      }
+      /* Keep the build-id for naming the debuginfo cache file, if
+         any.  A debug image found below, without a build-id match, is
+         not cached. */
+      cache_buildid = buildid;
+      buildid = NULL; /* paranoia */
 
       /* As a last-ditch measure, try looking for in the
          --extra-debuginfo-path and/or on the --debuginfo-server, but
@@ -2770,6 +2979,10 @@ Bool ML_(read_elf_debug_info) ( struct _DebugInfo* di )
          either the extra-path or on the server. */
       if (dimg == NULL && VG_(clo_allow_mismatched_debuginfo)) {
          dimg = find_debug_file_ad_hoc( di, di->fsm.filename );
+         if (dimg != NULL && cache_buildid != NULL) {
+            ML_(dinfo_free)(cache_buildid);
+            cache_buildid = NULL;
+         }
       }
 
       /* TOPLEVEL */
@@ -3159,9 +3372,41 @@ Bool ML_(read_elf_debug_info) ( struct _DebugInfo* di )
       vg_assert((ldynsym_escn.szB % sizeof(ElfXX_Sym)) == 0);
 #     endif
 
+      /* TOPLEVEL */
+      /* With --debuginfo-cache=<dir>, try to load the tables read
+         below from the cache file instead.  If there is none, they are
+         read here in full, to be saved there once canonicalised. */
+      Bool from_cache = False;
+      if (di->cache_file) {
+         ML_(dinfo_free)(di->cache_file);
+         di->cache_file = NULL;
+      }
+      if (cache_buildid) {
+         UInt found
+            = (dimg != NULL ? DiCache_DImg : 0)
+              | (aimg != NULL ? DiCache_AImg : 0)
+              | (ML_(sli_is_valid)(symtab_escn) ? DiCache_Symtab : 0)
+              | (ML_(sli_is_valid)(debug_line_escn) ? DiCache_DebugLine : 0)
+              | (ML_(sli_is_valid)(debug_info_escn) ? DiCache_DebugInfo : 0)
+              | (ML_(sli_is_valid)(debug_frame_escn) ? DiCache_DebugFrame
+                                                     : 0);
+         di->cache_file
+            = ML_(cache_file_name)(cache_buildid, found,
+                                   ML_(img_real_size)(mimg),
+                                   dimg ? ML_(img_real_size)(dimg) : 0);
+         ML_(dinfo_free)(cache_buildid);
+         cache_buildid = NULL;
+      }
+      if (di->cache_file != NULL
+          && ML_(load_cached_DebugInfo)(di, di->cache_file)) {
+         ML_(dinfo_free)(di->cache_file);
+         di->cache_file = NULL;
+         from_cache = True;
+      }
+
       /* TOPLEVEL */
       /* Read symbols */
-      {
+      if (!from_cache) {
          void (*read_elf_symtab)(struct _DebugInfo*, const HChar*,
                                  DiSlice*, DiSlice*, DiSlice*, Bool);
          Bool symtab_in_debug;
@@ -3185,57 +3430,50 @@ Bool ML_(read_elf_debug_info) ( struct _DebugInfo* di )
       }
 
       /* TOPLEVEL */
-      /* Read .eh_frame and .debug_frame (call-frame-info) if any.  Do
-         the .eh_frame section(s) first. */
-      vg_assert(di->n_ehframe >= 0 && di->n_ehframe <= N_EHFRAME_SECTS);
-      for (i = 0; i < di->n_ehframe; i++) {
-         /* see Comment_on_EH_FRAME_MULTIPLE_INSTANCES above for why
-            this next assertion should hold. */
-         vg_assert(ML_(sli_is_valid)(ehframe_escn[i]));
-         vg_assert(ehframe_escn[i].szB == di->ehframe_size[i]);
-         ML_(read_callframe_info_dwarf3)( di,
-                                          ehframe_escn[i],
-                                          di->ehframe_avma[i],
-                                          True/*is_ehframe*/ );
-      }
-      if (ML_(sli_is_valid)(debug_frame_escn)) {
-         ML_(read_callframe_info_dwarf3)( di,
-                                          debug_frame_escn,
-                                          0/*assume zero avma*/,
-                                          False/*!is_ehframe*/ );
-      }
-
-      /* TOPLEVEL */
-      /* jrs 2006-01-01: icc-8.1 has been observed to generate
-         binaries without debug_str sections.  Don't preclude
-         debuginfo reading for that reason, but, in
-         read_unitinfo_dwarf2, do check that debugstr is non-NULL
-         before using it. */
-      if (ML_(sli_is_valid)(debug_info_escn) 
-          && ML_(sli_is_valid)(debug_abbv_escn)
-          && ML_(sli_is_valid)(debug_line_escn)) {
-         /* The old reader: line numbers and unwind info only */
-         ML_(read_debuginfo_dwarf3) ( di,
-                                      debug_info_escn,
-                                      debug_types_escn,
-                                      debug_abbv_escn,
-                                      debug_line_escn,
-                                      debug_str_escn,
-                                      debug_str_alt_escn );
-         /* The new reader: read the DIEs in .debug_info to acquire
-            information on variable types and locations or inline info.
-            But only if the tool asks for it, or the user requests it on
-            the command line. */
-         if (VG_(clo_read_var_info) /* the user or tool asked for it */
-             || VG_(clo_read_inline_info)) {
-            ML_(new_dwarf3_reader)(
-               di, debug_info_escn,     debug_types_escn,
-                   debug_abbv_escn,     debug_line_escn,
-                   debug_str_escn,      debug_ranges_escn,
-                   debug_loc_escn,      debug_info_alt_escn,
-                   debug_abbv_alt_escn, debug_line_alt_escn,
-                   debug_str_alt_escn
-            );
+      /* Read the call frame info (.eh_frame, .debug_frame, .exidx) and
+         the DWARF line, inline and variable info, if any.  With
+         --lazy-debuginfo=yes, this is put off until first needed, and
+         the images are handed over to the DebugInfo for that.  It is
+         not, if the tables are to be saved in the debuginfo cache. */
+      if (!from_cache) {
+         struct _DeferredDebugInfo dd;
+         UInt what;
+
+         dd.mimg                = mimg;
+         dd.dimg                = dimg;
+         dd.aimg                = aimg;
+         for (i = 0; i < N_EHFRAME_SECTS; i++)
+            dd.ehframe_escn[i]  = ehframe_escn[i];
+         dd.debug_frame_escn    = debug_frame_escn;
+         dd.debug_line_escn     = debug_line_escn;
+         dd.debug_info_escn     = debug_info_escn;
+         dd.debug_types_escn    = debug_types_escn;
+         dd.debug_abbv_escn     = debug_abbv_escn;
+         dd.debug_str_escn      = debug_str_escn;
+         dd.debug_ranges_escn   = debug_ranges_escn;
+         dd.debug_loc_escn      = debug_loc_escn;
+         dd.debug_line_alt_escn = debug_line_alt_escn;
+         dd.debug_info_alt_escn = debug_info_alt_escn;
+         dd.debug_abbv_alt_escn = debug_abbv_alt_escn;
+         dd.debug_str_alt_escn  = debug_str_alt_escn;
+
+         what = deferrable_parts(di, &dd);
+         if (VG_(clo_lazy_debuginfo) && what != 0
+             && di->cache_file == NULL) {
+            TRACE_SYMTAB("\n------ Deferring %s%s------\n",
+                         what & DiDefer_CFI ? "CFI " : "",
+                         what & DiDefer_DWARF ? "DWARF " : "");
+            vg_assert(di->deferred_info == NULL);
+            di->deferred = what;
+            di->deferred_info
+               = ML_(dinfo_zalloc)("di.readelf.rediDeferred.1", sizeof(dd));
+            *di->deferred_info = dd;
+            park_deferred_images(di->deferred_info);
+            /* The images now belong to di->deferred_info. */
+            mimg = dimg = aimg = NULL;
+         } else {
+            read_elf_cfi(di, &dd);
+            read_elf_dwarf(di, &dd);
          }
       }
 
@@ -3247,42 +3485,6 @@ Bool ML_(read_elf_debug_info) ( struct _DebugInfo* di )
       //                                    dwarf1l_img, dwarf1l_sz );
       //}
 
-#     if defined(VGA_arm)
-      /* TOPLEVEL */
-      /* ARM32 only: read .exidx/.extab if present.  Note we are
-         reading these directly out of the mapped in (running) image.
-         Also, read these only if no CFI based unwind info was
-         acquired for this file.
-
-         An .exidx section is always required, but the .extab section
-         can be optionally omitted, provided that .exidx does not
-         refer to it.  If the .exidx is erroneous and does refer to
-         .extab even though .extab is missing, the range checks done
-         by GET_EX_U32 in ExtabEntryExtract in readexidx.c should
-         prevent any invalid memory accesses, and cause the .extab to
-         be rejected as invalid.
-
-         FIXME:
-         * check with m_aspacemgr that the entire [exidx_avma, +exidx_size)
-           and [extab_avma, +extab_size) areas are readable, since we're
-           reading this stuff out of the running image (not from a file/socket)
-           and we don't want to segfault.
-         * DebugInfo::exidx_bias and use text_bias instead.
-           I think it's always the same.
-         * remove DebugInfo::{extab_bias, exidx_svma, extab_svma} since
-           they are never used.
-      */
-      if (di->exidx_present
-          && di->cfsi_used == 0
-          && di->text_present && di->text_size > 0) {
-         Addr text_last_svma = di->text_svma + di->text_size - 1;
-         ML_(read_exidx)( di, (UChar*)di->exidx_avma, di->exidx_size,
-                              (UChar*)di->extab_avma, di->extab_size,
-                              text_last_svma,
-                              di->exidx_bias );
-      }
-#     endif /* defined(VGA_arm) */
-
    } /* "Find interesting sections, read the symbol table(s), read any debug
         information" (a local scope) */
 
@@ -3324,6 +3526,7 @@ Bool ML_(read_elf_debug_info) ( struct _DebugInfo* di )
       if (mimg) ML_(img_done)(mimg);
       if (dimg) ML_(img_done)(dimg);
       if (aimg) ML_(img_done)(aimg);
+      if (cache_buildid) ML_(dinfo_free)(cache_buildid);
 
       if (svma_ranges) VG_(deleteXA)(svma_ranges);
 
@@ -2336,12 +2336,34 @@ void ML_(canonicaliseTables) ( struct _DebugInfo* di )
    if (di->cfsi_m_pool)
       VG_(freezeDedupPA) (di->cfsi_m_pool, ML_(dinfo_shrink_block));
    canonicaliseVarInfo ( di );
+   /* A deferred DWARF read will still add strings and filenames. */
+   if (di->deferred & DiDefer_DWARF)
+      return;
    if (di->strpool)
       VG_(freezeDedupPA) (di->strpool, ML_(dinfo_shrink_block));
    if (di->fndnpool)
       VG_(freezeDedupPA) (di->fndnpool, ML_(dinfo_shrink_block));
 }
 
+void ML_(canonicaliseDeferredTables) ( struct _DebugInfo* di, UInt what )
+{
+   vg_assert((di->deferred & what) == 0);
+   if (what & DiDefer_CFI) {
+      ML_(canonicaliseCFI) ( di );
+      if (di->cfsi_m_pool)
+         VG_(freezeDedupPA) (di->cfsi_m_pool, ML_(dinfo_shrink_block));
+   }
+   if (what & DiDefer_DWARF) {
+      canonicaliseLoctab ( di );
+      canonicaliseInltab ( di );
+      canonicaliseVarInfo ( di );
+      if (di->strpool)
+         VG_(freezeDedupPA) (di->strpool, ML_(dinfo_shrink_block));
+      if (di->fndnpool)
+         VG_(freezeDedupPA) (di->fndnpool, ML_(dinfo_shrink_block));
+   }
+}
+
 
 /*------------------------------------------------------------*/
 /*--- Searching the tables                                 ---*/
@@ -187,6 +187,10 @@ static void usage_NORETURN ( Bool debug_help )
 "                              and use it to print better error messages in\n"
 "                              tools that make use of it (Memcheck, Helgrind,\n"
 "                              DRD) [no]\n"
+"    --lazy-debuginfo=no|yes   read unwind, line, inline and variable info\n"
+"                              of each object only when first needed [no]\n"
+"    --debuginfo-cache=<dir>   cache the debug info read in <dir>, and reuse\n"
+"                              it in later runs [none]\n"
 "    --vgdb-poll=<number>      gdbserver poll max every <number> basic blocks [%d] \n"
 "    --vgdb-shadow-registers=no|yes   let gdb see the shadow registers [no]\n"
 "    --vgdb-prefix=<prefix>    prefix for vgdb FIFOs [%s]\n"
@@ -689,6 +693,7 @@ void main_process_cmd_line_options( void )
                                VG_(clo_progress_interval), 0, 3600) {}
       else if VG_BOOL_CLO(arg, "--read-inline-info", VG_(clo_read_inline_info)) {}
       else if VG_BOOL_CLO(arg, "--read-var-info",    VG_(clo_read_var_info)) {}
+      else if VG_BOOL_CLO(arg, "--lazy-debuginfo",   VG_(clo_lazy_debuginfo)) {}
 
       else if VG_INT_CLO (arg, "--dump-error",       VG_(clo_dump_error))   {}
       else if VG_INT_CLO (arg, "--input-fd",         VG_(clo_input_fd))     {}
@@ -794,6 +799,9 @@ void main_process_cmd_line_options( void )
       else if VG_STR_CLO(arg, "--debuginfo-server",
                               VG_(clo_debuginfo_server)) {}
 
+      else if VG_STR_CLO(arg, "--debuginfo-cache",
+                              VG_(clo_debuginfo_cache)) {}
+
       else if VG_BOOL_CLO(arg, "--allow-mismatched-debuginfo",
                                VG_(clo_allow_mismatched_debuginfo)) {}
 
@@ -514,6 +514,9 @@ static ULong n_in_sc_count = 0;
 static ULong n_dump_count = 0;
 static ULong n_dump_osize = 0;
 static ULong n_sectors_recycled = 0;
+/* Number of chained jumps left in place when recycling a sector,
+   because both ends of the jump were in that sector. */
+static ULong n_unchain_skipped = 0;
 
 /* Number/osize of translations discarded due to requests to do so. */
 static ULong n_disc_count = 0;
@@ -995,11 +998,20 @@ static void unchain_one ( VexArch arch_host, VexEndness endness_host,
 
 /* The specified block is about to be deleted.  Update the preds and
    succs of its associated blocks accordingly.  This includes undoing
-   any chained jumps to this block. */
+   any chained jumps to this block.
+
+   If 'whole_sector' is True, the entire sector here_sNo is being
+   recycled.  In that case, edges between two blocks of that sector
+   are simply dropped: the code containing the patched jump is about
+   to be thrown away, so there is no point in unpatching it, nor in
+   removing the edge from the other block's admin info, since that
+   other block will itself be erased shortly.  Only edges crossing
+   the sector boundary need to be undone. */
 static
 void unchain_in_preparation_for_deletion ( VexArch arch_host,
                                            VexEndness endness_host,
-                                           SECno here_sNo, TTEno here_tteNo )
+                                           SECno here_sNo, TTEno here_tteNo,
+                                           Bool whole_sector )
 {
    if (DEBUG_TRANSTAB)
       VG_(printf)("QQQ unchain_in_prep %u.%u...\n", here_sNo, here_tteNo);
@@ -1016,6 +1028,10 @@ void unchain_in_preparation_for_deletion ( VexArch arch_host,
    n = InEdgeArr__size(&here_tteC->in_edges);
    for (i = 0; i < n; i++) {
       InEdge* ie = InEdgeArr__index(&here_tteC->in_edges, i);
+      if (whole_sector && ie->from_sNo == here_sNo) {
+         n_unchain_skipped++;
+         continue;
+      }
       // Undo the chaining.
       UChar* here_slow_EP = (UChar*)here_tteC->tcptr;
       UChar* here_fast_EP = here_slow_EP + evCheckSzB;
@@ -1039,6 +1055,8 @@ void unchain_in_preparation_for_deletion ( VexArch arch_host,
    n = OutEdgeArr__size(&here_tteC->out_edges);
    for (i = 0; i < n; i++) {
       OutEdge* oe = OutEdgeArr__index(&here_tteC->out_edges, i);
+      if (whole_sector && oe->to_sNo == here_sNo)
+         continue;
       // Find the corresponding entry in the "to" node's in_edges,
       // and remove it.
       TTEntryC* to_tteC = index_tteC(oe->to_sNo, oe->to_tteNo);
@@ -1669,7 +1687,8 @@ static void initialiseSector ( SECno sno )
                               sec->ttC[ei].entry, vge_tmp );
             }
             unchain_in_preparation_for_deletion(arch_host,
-                                                endness_host, sno, ei);
+                                                endness_host, sno, ei,
+                                                True/*whole_sector*/);
          } else {
             vg_assert(sec->ttC[ei].n_tte2ec == 0);
          }
@@ -2039,7 +2058,8 @@ static void delete_tte ( /*OUT*/Addr* ga_deleted,
    *ga_deleted = tteH->vge_base[0];
 
    /* Unchain .. */
-   unchain_in_preparation_for_deletion(arch_host, endness_host, secNo, tteno);
+   unchain_in_preparation_for_deletion(arch_host, endness_host, secNo, tteno,
+                                       False/*!whole_sector*/);
 
    /* Deal with the ec-to-tte links first. */
    for (i = 0; i < tteC->n_tte2ec; i++) {
@@ -2695,8 +2715,9 @@ void VG_(print_tt_tc_stats) ( void )
                 n_in_tsize / (n_in_count ? n_in_count : 1));
    VG_(message)(Vg_DebugMsg,
                 " transtab: dumped     %'llu (%'llu -> ?" "?) "
-                "(sectors recycled %'llu)\n",
-                n_dump_count, n_dump_osize, n_sectors_recycled );
+                "(sectors recycled %'llu, unchains skipped %'llu)\n",
+                n_dump_count, n_dump_osize, n_sectors_recycled,
+                n_unchain_skipped );
    VG_(message)(Vg_DebugMsg,
                 " transtab: discarded  %'llu (%'llu -> ?" "?)\n",
                 n_disc_count, n_disc_osize );
@@ -156,6 +156,10 @@ extern const HChar* VG_(clo_extra_debuginfo_path);
    "d.d.d.d:d", where d is one or more digits. */
 extern const HChar* VG_(clo_debuginfo_server);
 
+/* Directory in which to cache the debuginfo tables read for each
+   object, to be loaded from there by later runs, or NULL. */
+extern const HChar* VG_(clo_debuginfo_cache);
+
 /* Do we allow reading debuginfo from debuginfo objects that don't
    match (in some sense) the main object?  This is dangerous, so the
    default is NO (False).  In any case it applies only to objects
@@ -250,6 +254,8 @@ extern Bool VG_(clo_sym_offsets);
 extern Bool VG_(clo_read_inline_info);
 /* Read DWARF3 variable info even if tool doesn't ask for it? */
 extern Bool VG_(clo_read_var_info);
+/* Put off reading CFI and DWARF line/inline/var info until needed? */
+extern Bool VG_(clo_lazy_debuginfo);
 /* Which prefix to strip from full source file paths, if any. */
 extern const HChar* VG_(clo_prefix_to_strip);
 
@@ -48,6 +48,9 @@ static ULong s_bitmap_creation_count;
 static ULong s_bitmap_merge_count;
 static ULong s_bitmap2_merge_count;
 
+ULong DRD_(g_bm_cache_lookups);
+ULong DRD_(g_bm_cache_misses);
+
 
 /* Function definitions. */
 
@@ -99,6 +102,9 @@ void DRD_(bm_init)(struct bitmap* const bm)
     * match any valid address: the upper (ADDR_LSB_BITS + ADDR_IGNORED_BITS)
     * bits of a1 are always zero for a valid cache entry.
     */
+   bm->cache        = bm->cache0;
+   bm->cache_mask   = DRD_BITMAP_N_CACHE_ELEM - 1;
+   bm->cache_misses = 0;
    for (i = 0; i < DRD_BITMAP_N_CACHE_ELEM; i++)
    {
       bm->cache[i].a1  = ~(UWord)1;
@@ -112,9 +118,41 @@ void DRD_(bm_init)(struct bitmap* const bm)
 /** Free the memory allocated by DRD_(bm_init)(). */
 void DRD_(bm_cleanup)(struct bitmap* const bm)
 {
+   if (bm->cache != bm->cache0)
+      VG_(free)(bm->cache);
    VG_(OSetGen_Destroy)(bm->oset);
 }
 
+/**
+ * Double the number of elements of the second-level bitmap cache of bm, and
+ * move the cached elements to their position in the larger cache.
+ */
+void DRD_(bm_cache_grow)(struct bitmap* const bm)
+{
+   struct bm_cache_elem* const old_cache = bm->cache;
+   const UWord old_n = bm->cache_mask + 1;
+   UWord i;
+
+   tl_assert(2 * old_n <= DRD_BITMAP_MAX_CACHE_ELEM);
+
+   bm->cache = VG_(malloc)("drd.bitmap.bcg.1",
+                           2 * old_n * sizeof(bm->cache[0]));
+   bm->cache_mask = 2 * old_n - 1;
+   bm->cache_misses = 0;
+   for (i = 0; i < 2 * old_n; i++)
+   {
+      bm->cache[i].a1  = ~(UWord)1;
+      bm->cache[i].bm2 = 0;
+   }
+   for (i = 0; i < old_n; i++)
+   {
+      if (old_cache[i].a1 != ~(UWord)1)
+         bm_update_cache(bm, old_cache[i].a1, old_cache[i].bm2);
+   }
+   if (old_cache != bm->cache0)
+      VG_(free)(old_cache);
+}
+
 /**
  * Record an access of type access_type at addresses a .. a + size - 1 in
  * bitmap bm.
@@ -350,15 +388,14 @@ Bool DRD_(bm_has_any_load_g)(struct bitmap* const bm)
    for ( ; (bm2 = VG_(OSetGen_Next)(bm->oset)) != NULL; ) {
       Addr b_start;
       Addr b_end;
-      UWord b0;
       const struct bitmap1* const p1 = &bm2->bm1;
 
       b_start = make_address(bm2->addr, 0);
       b_end = make_address(bm2->addr + 1, 0);
 
-      for (b0 = address_lsb(b_start); b0 <= address_lsb(b_end - 1); b0++)
-         if (bm0_is_set(p1->bm0_r, b0))
-            return True;
+      if (bm0_is_any_set_between(p1->bm0_r, address_lsb(b_start),
+                                 address_lsb(b_end - 1)))
+         return True;
    }
    return False;
 }
@@ -384,7 +421,6 @@ DRD_(bm_has_any_load)(struct bitmap* const bm, const Addr a1, const Addr a2)
       {
          Addr b_start;
          Addr b_end;
-         UWord b0;
          const struct bitmap1* const p1 = &bm2->bm1;
 
          if (make_address(bm2->addr, 0) < a1)
@@ -404,12 +440,10 @@ DRD_(bm_has_any_load)(struct bitmap* const bm, const Addr a1, const Addr a2)
          tl_assert(b_start < b_end);
          tl_assert(address_lsb(b_start) <= address_lsb(b_end - 1));
 
-         for (b0 = address_lsb(b_start); b0 <= address_lsb(b_end - 1); b0++)
+         if (bm0_is_any_set_between(p1->bm0_r, address_lsb(b_start),
+                                    address_lsb(b_end - 1)))
          {
-            if (bm0_is_set(p1->bm0_r, b0))
-            {
-               return True;
-            }
+            return True;
          }
       }
    }
@@ -437,7 +471,6 @@ Bool DRD_(bm_has_any_store)(struct bitmap* const bm,
       {
          Addr b_start;
          Addr b_end;
-         UWord b0;
          const struct bitmap1* const p1 = &bm2->bm1;
 
          if (make_address(bm2->addr, 0) < a1)
@@ -457,12 +490,10 @@ Bool DRD_(bm_has_any_store)(struct bitmap* const bm,
          tl_assert(b_start < b_end);
          tl_assert(address_lsb(b_start) <= address_lsb(b_end - 1));
 
-         for (b0 = address_lsb(b_start); b0 <= address_lsb(b_end - 1); b0++)
+         if (bm0_is_any_set_between(p1->bm0_w, address_lsb(b_start),
+                                    address_lsb(b_end - 1)))
          {
-            if (bm0_is_set(p1->bm0_w, b0))
-            {
-               return True;
-            }
+            return True;
          }
       }
    }
@@ -492,7 +523,6 @@ Bool DRD_(bm_has_any_access)(struct bitmap* const bm,
       {
          Addr b_start;
          Addr b_end;
-         UWord b0;
          const struct bitmap1* const p1 = &bm2->bm1;
 
          if (make_address(bm2->addr, 0) < a1)
@@ -512,16 +542,12 @@ Bool DRD_(bm_has_any_access)(struct bitmap* const bm,
          tl_assert(b_start < b_end);
          tl_assert(address_lsb(b_start) <= address_lsb(b_end - 1));
 
-         for (b0 = address_lsb(b_start); b0 <= address_lsb(b_end - 1); b0++)
+         if (bm0_is_any_set_between(p1->bm0_r, address_lsb(b_start),
+                                    address_lsb(b_end - 1))
+             || bm0_is_any_set_between(p1->bm0_w, address_lsb(b_start),
+                                       address_lsb(b_end - 1)))
          {
-            /*
-             * Note: the statement below uses a binary or instead of a logical
-             * or on purpose.
-             */
-            if (bm0_is_set(p1->bm0_r, b0) | bm0_is_set(p1->bm0_w, b0))
-            {
-               return True;
-            }
+            return True;
          }
       }
    }
@@ -825,7 +851,6 @@ Bool DRD_(bm_has_conflict_with)(struct bitmap* const bm,
       {
          Addr b_start;
          Addr b_end;
-         UWord b0;
          const struct bitmap1* const p1 = &bm2->bm1;
 
          if (make_address(bm2->addr, 0) < a1)
@@ -845,24 +870,17 @@ Bool DRD_(bm_has_conflict_with)(struct bitmap* const bm,
          tl_assert(b_start < b_end);
          tl_assert(address_lsb(b_start) <= address_lsb(b_end - 1));
 
-         for (b0 = address_lsb(b_start); b0 <= address_lsb(b_end - 1); b0++)
+         tl_assert(access_type == eLoad || access_type == eStore);
+         if (bm0_is_any_set_between(p1->bm0_w, address_lsb(b_start),
+                                    address_lsb(b_end - 1)))
          {
-            if (access_type == eLoad)
-            {
-               if (bm0_is_set(p1->bm0_w, b0))
-               {
-                  return True;
-               }
-            }
-            else
-            {
-               tl_assert(access_type == eStore);
-               if (bm0_is_set(p1->bm0_r, b0)
-                   | bm0_is_set(p1->bm0_w, b0))
-               {
-                  return True;
-               }
-            }
+            return True;
+         }
+         if (access_type == eStore
+             && bm0_is_any_set_between(p1->bm0_r, address_lsb(b_start),
+                                       address_lsb(b_end - 1)))
+         {
+            return True;
          }
       }
    }
@@ -1187,7 +1205,17 @@ int DRD_(bm_has_races)(struct bitmap* const lhs, struct bitmap* const rhs)
 
       for (k = 0; k < BITMAP1_UWORD_COUNT; k++)
       {
+         /*
+          * Bits that have been stored by one side and accessed by the other
+          * side. Only look at individual bits if this UWord has any.
+          */
+         const UWord race_bits
+            = (bm1l->bm0_w[k] & (bm1r->bm0_r[k] | bm1r->bm0_w[k]))
+            | (bm1r->bm0_w[k] & (bm1l->bm0_r[k] | bm1l->bm0_w[k]));
          unsigned b;
+
+         if (race_bits == 0)
+            continue;
          for (b = 0; b < BITS_PER_UWORD; b++)
          {
             UWord const access_mask
@@ -1242,6 +1270,12 @@ static void bm2_print(const struct bitmap2* const bm2)
    }
 }
 
+/** Return the number of second-level bitmaps in bm. */
+UWord DRD_(bm_get_bitmap2_count)(struct bitmap* const bm)
+{
+   return VG_(OSetGen_Size)(bm->oset);
+}
+
 ULong DRD_(bm_get_bitmap_creation_count)(void)
 {
    return s_bitmap_creation_count;
@@ -1257,6 +1291,16 @@ ULong DRD_(bm_get_bitmap2_merge_count)(void)
    return s_bitmap2_merge_count;
 }
 
+ULong DRD_(bm_get_cache_lookup_count)(void)
+{
+   return DRD_(g_bm_cache_lookups);
+}
+
+ULong DRD_(bm_get_cache_miss_count)(void)
+{
+   return DRD_(g_bm_cache_misses);
+}
+
 /** Compute *bm2l |= *bm2r. */
 static
 void bm2_merge(struct bitmap2* const bm2l, const struct bitmap2* const bm2r)
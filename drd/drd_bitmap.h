@@ -323,6 +323,37 @@ static __inline__ UWord bm0_is_any_set(const UWord* bm0,
    return (bm0[uword_msb(a)] & ((((UWord)1 << size) - 1) << uword_lsb(a)));
 }
 
+/**
+ * Return true if a bit corresponding to any of the addresses in range
+ * [ a1 << ADDR_IGNORED_BITS .. a2 << ADDR_IGNORED_BITS ] is set in bm0.
+ * Unlike bm0_is_any_set() the range may span multiple UWords; these are
+ * tested one UWord at a time instead of one bit at a time.
+ */
+static __inline__ Bool bm0_is_any_set_between(const UWord* bm0,
+                                              const UWord a1, const UWord a2)
+{
+   const UWord k1 = uword_msb(a1);
+   const UWord k2 = uword_msb(a2);
+   const UWord lo_mask = ~(UWord)0 << uword_lsb(a1);
+   const UWord hi_mask = ~(UWord)0 >> (BITS_PER_UWORD - 1 - uword_lsb(a2));
+   UWord k;
+
+#ifdef ENABLE_DRD_CONSISTENCY_CHECKS
+   tl_assert(a1 <= a2);
+   tl_assert(address_msb(make_address(0, a2)) == 0);
+#endif
+   if (k1 == k2)
+      return (bm0[k1] & lo_mask & hi_mask) != 0;
+   if (bm0[k1] & lo_mask)
+      return True;
+   for (k = k1 + 1; k < k2; k++)
+   {
+      if (bm0[k])
+         return True;
+   }
+   return (bm0[k2] & hi_mask) != 0;
+}
+
 
 
 /*********************************************************************/
@@ -345,111 +376,49 @@ struct bitmap2* bm2_insert(struct bitmap* const bm, const UWord a1);
 
 
 
+/* Second-level bitmap cache lookup counters, for --drd-stats=yes. */
+extern ULong DRD_(g_bm_cache_lookups);
+extern ULong DRD_(g_bm_cache_misses);
+
+void DRD_(bm_cache_grow)(struct bitmap* const bm);
+
 /**
- * Rotate elements cache[0..n-1] such that the element at position n-1 is
- * moved to position 0. This allows to speed up future cache lookups.
+ * Index in bm->cache[] of the cache element for a1. Mixing in higher address
+ * bits keeps e.g. stack and heap second-level bitmaps apart.
  */
 static __inline__
-void bm_cache_rotate(struct bm_cache_elem cache[], const int n)
-{
-#if 0
-   struct bm_cache_elem t;
-
-   tl_assert(2 <= n && n <= 8);
-
-   t = cache[0];
-   if (n > 1)
-      cache[0] = cache[1];
-   if (n > 2)
-      cache[1] = cache[2];
-   if (n > 3)
-      cache[2] = cache[3];
-   if (n > 4)
-      cache[3] = cache[4];
-   if (n > 5)
-      cache[4] = cache[5];
-   if (n > 6)
-      cache[5] = cache[6];
-   if (n > 7)
-      cache[6] = cache[7];
-   cache[n - 1] = t;
-#endif
+UWord bm_cache_index(const struct bitmap* const bm, const UWord a1)
+{
+   return (a1 ^ (a1 >> 8)) & bm->cache_mask;
 }
 
 static __inline__
 Bool bm_cache_lookup(struct bitmap* const bm, const UWord a1,
                      struct bitmap2** bm2)
 {
+   const struct bm_cache_elem* const e = &bm->cache[bm_cache_index(bm, a1)];
+
 #ifdef ENABLE_DRD_CONSISTENCY_CHECKS
    tl_assert(bm);
    tl_assert(bm2);
 #endif
 
-#if DRD_BITMAP_N_CACHE_ELEM > 8
-#error Please update the code below.
-#endif
-#if DRD_BITMAP_N_CACHE_ELEM >= 1
-   if (a1 == bm->cache[0].a1)
-   {
-      *bm2 = bm->cache[0].bm2;
-      return True;
-   }
-#endif
-#if DRD_BITMAP_N_CACHE_ELEM >= 2
-   if (a1 == bm->cache[1].a1)
+   DRD_(g_bm_cache_lookups)++;
+   if (LIKELY(a1 == e->a1))
    {
-      *bm2 = bm->cache[1].bm2;
+      *bm2 = e->bm2;
       return True;
    }
-#endif
-#if DRD_BITMAP_N_CACHE_ELEM >= 3
-   if (a1 == bm->cache[2].a1)
-   {
-      *bm2 = bm->cache[2].bm2;
-      bm_cache_rotate(bm->cache, 3);
-      return True;
-   }
-#endif
-#if DRD_BITMAP_N_CACHE_ELEM >= 4
-   if (a1 == bm->cache[3].a1)
-   {
-      *bm2 = bm->cache[3].bm2;
-      bm_cache_rotate(bm->cache, 4);
-      return True;
-   }
-#endif
-#if DRD_BITMAP_N_CACHE_ELEM >= 5
-   if (a1 == bm->cache[4].a1)
-   {
-      *bm2 = bm->cache[4].bm2;
-      bm_cache_rotate(bm->cache, 5);
-      return True;
-   }
-#endif
-#if DRD_BITMAP_N_CACHE_ELEM >= 6
-   if (a1 == bm->cache[5].a1)
-   {
-      *bm2 = bm->cache[5].bm2;
-      bm_cache_rotate(bm->cache, 6);
-      return True;
-   }
-#endif
-#if DRD_BITMAP_N_CACHE_ELEM >= 7
-   if (a1 == bm->cache[6].a1)
-   {
-      *bm2 = bm->cache[6].bm2;
-      bm_cache_rotate(bm->cache, 7);
-      return True;
-   }
-#endif
-#if DRD_BITMAP_N_CACHE_ELEM >= 8
-   if (a1 == bm->cache[7].a1)
+   /*
+    * Grow the cache of bitmaps that miss often, e.g. the conflict set of a
+    * program that accesses many pages concurrently.
+    */
+   DRD_(g_bm_cache_misses)++;
+   if (UNLIKELY(++bm->cache_misses >= 64 * (bm->cache_mask + 1))
+       && bm->cache_mask + 1 < DRD_BITMAP_MAX_CACHE_ELEM)
    {
-      *bm2 = bm->cache[7].bm2;
-      bm_cache_rotate(bm->cache, 8);
-      return True;
+      DRD_(bm_cache_grow)(bm);
    }
-#endif
    *bm2 = 0;
    return False;
 }
@@ -459,36 +428,14 @@ void bm_update_cache(struct bitmap* const bm,
                      const UWord a1,
                      struct bitmap2* const bm2)
 {
+   struct bm_cache_elem* const e = &bm->cache[bm_cache_index(bm, a1)];
+
 #ifdef ENABLE_DRD_CONSISTENCY_CHECKS
    tl_assert(bm);
 #endif
 
-#if DRD_BITMAP_N_CACHE_ELEM > 8
-#error Please update the code below.
-#endif
-#if DRD_BITMAP_N_CACHE_ELEM >= 8
-   bm->cache[7] = bm->cache[6];
-#endif
-#if DRD_BITMAP_N_CACHE_ELEM >= 7
-   bm->cache[6] = bm->cache[5];
-#endif
-#if DRD_BITMAP_N_CACHE_ELEM >= 6
-   bm->cache[5] = bm->cache[4];
-#endif
-#if DRD_BITMAP_N_CACHE_ELEM >= 5
-   bm->cache[4] = bm->cache[3];
-#endif
-#if DRD_BITMAP_N_CACHE_ELEM >= 4
-   bm->cache[3] = bm->cache[2];
-#endif
-#if DRD_BITMAP_N_CACHE_ELEM >= 3
-   bm->cache[2] = bm->cache[1];
-#endif
-#if DRD_BITMAP_N_CACHE_ELEM >= 2
-   bm->cache[1] = bm->cache[0];
-#endif
-   bm->cache[0].a1  = a1;
-   bm->cache[0].bm2 = bm2;
+   e->a1  = a1;
+   e->bm2 = bm2;
 }
 
 /**
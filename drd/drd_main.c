@@ -767,6 +767,7 @@ static void DRD_(fini)(Int exitcode)
       ULong pu_seg_cr = DRD_(thread_get_update_conflict_set_new_sg_count)();
       ULong pu_mtx_cv = DRD_(thread_get_update_conflict_set_sync_count)();
       ULong pu_join   = DRD_(thread_get_update_conflict_set_join_count)();
+      ULong pu_switch = DRD_(thread_get_update_conflict_set_switch_count)();
 
       VG_(message)(Vg_UserMsg,
                    "   thread: %llu context switches.\n",
@@ -783,11 +784,15 @@ static void DRD_(fini)(Int exitcode)
                    pu_mtx_cv);
       VG_(message)(Vg_UserMsg,
                    "           %llu because of barrier/rwlock operations and\n",
-		   pu - pu_seg_cr - pu_mtx_cv - pu_join);
+		   pu - pu_seg_cr - pu_mtx_cv - pu_join - pu_switch);
       VG_(message)(Vg_UserMsg,
                    "           %llu partial updates because of thread join"
-                   " operations.\n",
+                   " operations and\n",
                    pu_join);
+      VG_(message)(Vg_UserMsg,
+                   "           %llu partial updates because of context"
+                   " switches.\n",
+                   pu_switch);
       VG_(message)(Vg_UserMsg,
                    " segments: created %llu segments, max %llu alive,\n",
                    DRD_(sg_get_segments_created_count)(),
@@ -808,6 +813,16 @@ static void DRD_(fini)(Int exitcode)
                    " and %llu level two bitmaps were allocated.\n",
                    DRD_(bm_get_bitmap_creation_count)(),
                    DRD_(bm_get_bitmap2_creation_count)());
+      {
+         const ULong lookups = DRD_(bm_get_cache_lookup_count)();
+         const ULong misses  = DRD_(bm_get_cache_miss_count)();
+         VG_(message)(Vg_UserMsg,
+                      "           %llu level two bitmap lookups, %llu.%llu%%"
+                      " cache hits.\n",
+                      lookups,
+                      lookups ? (lookups - misses) * 100 / lookups : 0,
+                      lookups ? (lookups - misses) * 1000 / lookups % 10 : 0);
+      }
       VG_(message)(Vg_UserMsg,
                    "    mutex: %llu non-recursive lock/unlock events.\n",
                    DRD_(get_mutex_lock_count)());
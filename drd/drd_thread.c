@@ -49,6 +49,8 @@ static void thread_append_segment(const DrdThreadId tid, Segment* const sg);
 static void thread_discard_segment(const DrdThreadId tid, Segment* const sg);
 static void thread_compute_conflict_set(struct bitmap** conflict_set,
                                         const DrdThreadId tid);
+static void thread_switch_conflict_set(const DrdThreadId old_tid,
+                                       const DrdThreadId new_tid);
 static Bool thread_conflict_set_up_to_date(const DrdThreadId tid);
 
 
@@ -61,12 +63,19 @@ static ULong    s_update_conflict_set_count;
 static ULong    s_update_conflict_set_new_sg_count;
 static ULong    s_update_conflict_set_sync_count;
 static ULong    s_update_conflict_set_join_count;
+static ULong    s_update_conflict_set_switch_count;
 static ULong    s_conflict_set_bitmap_creation_count;
 static ULong    s_conflict_set_bitmap2_creation_count;
 static ThreadId s_vg_running_tid  = VG_INVALID_THREADID;
 DrdThreadId     DRD_(g_drd_running_tid) = DRD_INVALID_THREADID;
 ThreadInfo*     DRD_(g_threadinfo);
 struct bitmap*  DRD_(g_conflict_set);
+/*
+ * Thread for which DRD_(g_conflict_set) has been computed, or
+ * DRD_INVALID_THREADID if it has to be computed from scratch upon the next
+ * context switch.
+ */
+static DrdThreadId s_conflict_set_tid = DRD_INVALID_THREADID;
 Bool DRD_(verify_conflict_set);
 static Bool     s_trace_context_switches = False;
 static Bool     s_trace_conflict_set = False;
@@ -535,6 +544,11 @@ void DRD_(thread_delete)(const DrdThreadId tid, const Bool detached)
       tl_assert(!DRD_(g_threadinfo)[tid].detached_posix_thread);
    DRD_(g_threadinfo)[tid].sg_first = NULL;
    DRD_(g_threadinfo)[tid].sg_last = NULL;
+   /*
+    * The conflict set may still contain accesses of the segments that have
+    * just been discarded, so recompute it upon the next context switch.
+    */
+   s_conflict_set_tid = DRD_INVALID_THREADID;
 
    tl_assert(!DRD_(IsValidDrdThreadId)(tid));
 }
@@ -585,6 +599,7 @@ void DRD_(drd_thread_atfork_child)(const ThreadId tid)
 
    DRD_(bm_cleanup)(DRD_(g_conflict_set));
    DRD_(bm_init)(DRD_(g_conflict_set));
+   s_conflict_set_tid = DRD_INVALID_THREADID;
 }
 
 /** Called just before pthread_cancel(). */
@@ -764,7 +779,8 @@ void DRD_(thread_set_vg_running_tid)(const ThreadId vg_tid)
 
 /**
  * Update s_vg_running_tid, DRD_(g_drd_running_tid) and recalculate the
- * conflict set.
+ * conflict set. If the conflict set is still that of the thread that was
+ * running, it is updated incrementally instead of being recomputed.
  */
 void DRD_(thread_set_running_tid)(const ThreadId vg_tid,
                                   const DrdThreadId drd_tid)
@@ -774,6 +790,8 @@ void DRD_(thread_set_running_tid)(const ThreadId vg_tid,
 
    if (vg_tid != s_vg_running_tid)
    {
+      const DrdThreadId prev_tid = DRD_(g_drd_running_tid);
+
       if (s_trace_context_switches
           && DRD_(g_drd_running_tid) != DRD_INVALID_THREADID)
       {
@@ -785,7 +803,20 @@ void DRD_(thread_set_running_tid)(const ThreadId vg_tid,
       }
       s_vg_running_tid = vg_tid;
       DRD_(g_drd_running_tid) = drd_tid;
-      thread_compute_conflict_set(&DRD_(g_conflict_set), drd_tid);
+      if (prev_tid == s_conflict_set_tid
+          && prev_tid != DRD_INVALID_THREADID
+          && prev_tid != drd_tid
+          && DRD_(IsValidDrdThreadId)(prev_tid)
+          && DRD_(g_threadinfo)[prev_tid].sg_last
+          && DRD_(g_threadinfo)[drd_tid].sg_last)
+      {
+         thread_switch_conflict_set(prev_tid, drd_tid);
+      }
+      else
+      {
+         thread_compute_conflict_set(&DRD_(g_conflict_set), drd_tid);
+      }
+      s_conflict_set_tid = drd_tid;
       s_context_switch_count++;
    }
 
@@ -1659,6 +1690,138 @@ void DRD_(thread_update_conflict_set)(const DrdThreadId tid,
    tl_assert(thread_conflict_set_up_to_date(DRD_(g_drd_running_tid)));
 }
 
+/**
+ * Return True if segment q of thread j is in the conflict set of thread tid,
+ * that is if j differs from tid and if the vector clock of q is unordered
+ * with vc, the vector clock of thread tid.
+ */
+static __inline__
+Bool thread_sg_in_conflict_set(const Segment* const q, const DrdThreadId j,
+                               const DrdThreadId tid,
+                               const VectorClock* const vc)
+{
+   return j != tid && !DRD_(vc_lte)(&q->vc, vc) && !DRD_(vc_lte)(vc, &q->vc);
+}
+
+/**
+ * Turn the conflict set of thread old_tid into that of thread new_tid upon a
+ * context switch. Only the second-level bitmaps touched by segments that are
+ * in one of both conflict sets but not in the other are recomputed. If these
+ * segments account for a large part of the new conflict set, recomputing it
+ * from scratch is cheaper, and that is what happens instead.
+ */
+static void thread_switch_conflict_set(const DrdThreadId old_tid,
+                                       const DrdThreadId new_tid)
+{
+   const VectorClock* const old_vc = DRD_(thread_get_vc)(old_tid);
+   const VectorClock* const new_vc = DRD_(thread_get_vc)(new_tid);
+   UWord changed_bm2_count = 0;
+   UWord new_bm2_count = 0;
+   unsigned j;
+
+   tl_assert(old_tid != new_tid);
+   tl_assert(new_tid == DRD_(g_drd_running_tid));
+   tl_assert(DRD_(g_conflict_set));
+
+   /*
+    * Note: segments that are ordered before both vector clocks are in neither
+    * conflict set, and so are all segments preceding them.
+    */
+   for (j = 0; j < DRD_N_THREADS; j++) {
+      if (DRD_(IsValidDrdThreadId)(j)) {
+         Segment* q;
+         for (q = DRD_(g_threadinfo)[j].sg_last;
+              q && !(DRD_(vc_lte)(&q->vc, old_vc)
+                     && DRD_(vc_lte)(&q->vc, new_vc));
+              q = q->thr_prev) {
+            const Bool in_new
+               = thread_sg_in_conflict_set(q, j, new_tid, new_vc);
+            const UWord n = DRD_(bm_get_bitmap2_count)(DRD_(sg_bm)(q));
+
+            if (in_new)
+               new_bm2_count += n;
+            if (in_new != thread_sg_in_conflict_set(q, j, old_tid, old_vc))
+               changed_bm2_count += n;
+         }
+      }
+   }
+
+   if (2 * changed_bm2_count > new_bm2_count) {
+      thread_compute_conflict_set(&DRD_(g_conflict_set), new_tid);
+      return;
+   }
+
+   if (s_trace_conflict_set) {
+      HChar* str;
+
+      str = DRD_(vc_aprint)(new_vc);
+      VG_(message)(Vg_DebugMsg,
+                   "switching conflict set from thread %u to thread %u"
+                   " with vc %s\n", old_tid, new_tid, str);
+      VG_(free)(str);
+   }
+
+   DRD_(bm_unmark)(DRD_(g_conflict_set));
+
+   for (j = 0; j < DRD_N_THREADS; j++) {
+      if (DRD_(IsValidDrdThreadId)(j)) {
+         Segment* q;
+         for (q = DRD_(g_threadinfo)[j].sg_last;
+              q && !(DRD_(vc_lte)(&q->vc, old_vc)
+                     && DRD_(vc_lte)(&q->vc, new_vc));
+              q = q->thr_prev) {
+            const Bool included_in_old_conflict_set
+               = thread_sg_in_conflict_set(q, j, old_tid, old_vc);
+            const Bool included_in_new_conflict_set
+               = thread_sg_in_conflict_set(q, j, new_tid, new_vc);
+
+            if (UNLIKELY(s_trace_conflict_set)) {
+               HChar* str;
+
+               str = DRD_(vc_aprint)(&q->vc);
+               VG_(message)(Vg_DebugMsg,
+                            "conflict set: [%u] %s segment %s\n", j,
+                            included_in_old_conflict_set
+                            != included_in_new_conflict_set
+                            ? "merging" : "ignoring", str);
+               VG_(free)(str);
+            }
+            if (included_in_old_conflict_set != included_in_new_conflict_set)
+               DRD_(bm_mark)(DRD_(g_conflict_set), DRD_(sg_bm)(q));
+         }
+      }
+   }
+
+   DRD_(bm_clear_marked)(DRD_(g_conflict_set));
+
+   for (j = 0; j < DRD_N_THREADS; j++) {
+      if (j != new_tid && DRD_(IsValidDrdThreadId)(j)) {
+         Segment* q;
+         for (q = DRD_(g_threadinfo)[j].sg_last;
+              q && !DRD_(vc_lte)(&q->vc, new_vc);
+              q = q->thr_prev) {
+            if (!DRD_(vc_lte)(new_vc, &q->vc))
+               DRD_(bm_merge2_marked)(DRD_(g_conflict_set), DRD_(sg_bm)(q));
+         }
+      }
+   }
+
+   DRD_(bm_remove_cleared_marked)(DRD_(g_conflict_set));
+
+   s_update_conflict_set_count++;
+   s_update_conflict_set_switch_count++;
+
+   if (s_trace_conflict_set_bm)
+   {
+      VG_(message)(Vg_DebugMsg, "[%u] switched conflict set:\n", new_tid);
+      DRD_(bm_print)(DRD_(g_conflict_set));
+      VG_(message)(Vg_DebugMsg, "[%u] end of switched conflict set.\n",
+                   new_tid);
+   }
+
+   tl_assert(thread_conflict_set_up_to_date(new_tid));
+}
+
 /** Report the number of context switches performed. */
 ULong DRD_(thread_get_context_switch_count)(void)
 {
@@ -1711,6 +1874,15 @@ ULong DRD_(thread_get_update_conflict_set_join_count)(void)
    return s_update_conflict_set_join_count;
 }
 
+/**
+ * Return how many times the conflict set has been updated partially
+ * because of context switches.
+ */
+ULong DRD_(thread_get_update_conflict_set_switch_count)(void)
+{
+   return s_update_conflict_set_switch_count;
+}
+
 /**
  * Return the number of first-level bitmaps that have been created during
  * conflict set updates.
@@ -63,13 +63,21 @@ struct bm_cache_elem
    struct bitmap2* bm2;
 };
 
-#define DRD_BITMAP_N_CACHE_ELEM 4
+/*
+ * Initial and maximum number of elements in the direct-mapped cache of
+ * second-level bitmaps of a bitmap. Both must be powers of two.
+ */
+#define DRD_BITMAP_N_CACHE_ELEM   8
+#define DRD_BITMAP_MAX_CACHE_ELEM 256
 
 /* Complete bitmap. */
 struct bitmap
 {
-   struct bm_cache_elem cache[DRD_BITMAP_N_CACHE_ELEM];
-   OSet*                oset;
+   struct bm_cache_elem* cache;        /* cache_mask + 1 elements. */
+   UWord                 cache_mask;
+   UWord                 cache_misses; /* Since the last resize. */
+   struct bm_cache_elem  cache0[DRD_BITMAP_N_CACHE_ELEM];
+   OSet*                 oset;
 };
 
 
@@ -146,8 +154,11 @@ void DRD_(bm_report_races)(ThreadId const tid1, ThreadId const tid2,
                            struct bitmap* const bm1,
                            struct bitmap* const bm2);
 void DRD_(bm_print)(struct bitmap* bm);
+UWord DRD_(bm_get_bitmap2_count)(struct bitmap* const bm);
 ULong DRD_(bm_get_bitmap_creation_count)(void);
 ULong DRD_(bm_get_bitmap2_creation_count)(void);
 ULong DRD_(bm_get_bitmap2_merge_count)(void);
+ULong DRD_(bm_get_cache_lookup_count)(void);
+ULong DRD_(bm_get_cache_miss_count)(void);
 
 #endif /* __PUB_DRD_BITMAP_H */
@@ -109,6 +109,16 @@ extern Bool  HG_(clo_delta_stacktrace);
    amd 10 million.  Default is 1 million. */
 extern UWord HG_(clo_conflict_cache_size);
 
+/* For full history level, determines how the conflicting accesses
+   are stored.
+   0: "map": a hash table keyed by address, with exact LRU discarding.
+      Remembers one access per address, thread, size and writeness.
+   1: "ring": each thread appends its accesses to chunks of records,
+      the oldest chunk being recycled when the cache is full.  Much
+      cheaper per access, and uses less memory per entry, but all
+      the chunks must be searched when a race is reported. */
+extern UWord HG_(clo_history_store);
+
 /* Sanity check level.  This is an or-ing of
    SCE_{THREADS,LOCKS,BIGRANGE,ACCESS,LAOG}. */
 extern UWord HG_(clo_sanity_flags);
@@ -136,6 +146,15 @@ extern UWord HG_(clo_vts_pruning);
    the stack, which speeds things up a bit.  Default: True. */
 extern Bool HG_(clo_check_stack_refs); 
 
+/* When True, memory references are only race-checked for a sample of
+   the executions of each superblock.  A superblock is checked at each
+   of its first executions, then less and less often, down to once
+   every HG_(clo_race_sampling_period) executions.  Synchronisation
+   events are always tracked, so this can miss races but does not
+   report false ones.  Default: False. */
+extern Bool  HG_(clo_race_sampling);
+extern UWord HG_(clo_race_sampling_period);
+
 #endif /* ! __HG_BASICS_H */
 
 /*--------------------------------------------------------------------*/
@@ -4486,6 +4486,112 @@ static IRExpr* mk_And1 ( IRSB* sbOut, IRExpr* arg1, IRExpr* arg2 )
    return mkexpr(res);
 }
 
+/* Race sampling (--race-sampling=yes), in the spirit of LiteRace.
+   Each superblock has a sampling period, initially 1: every execution
+   of the superblock has its memory accesses checked.  The period is
+   doubled every SAMPLE_BURST checked executions, up to
+   HG_(clo_race_sampling_period).  Cold code is thus always checked,
+   and hot code only once in a while.  Whether an execution is checked
+   is decided at the start of the superblock, by decrementing a
+   countdown, and the memory access helpers are guarded by the result.
+   The states are kept per guest address rather than per translation,
+   so that a discarded and retranslated superblock stays hot. */
+
+#define SAMPLE_BURST 16
+
+typedef
+   struct _SBSample {
+      struct _SBSample* next;
+      Addr  guest_addr; // key: address of the superblock's first insn
+      UInt  countdown;  // nr of executions to skip before the next check
+      UInt  period;     // current sampling period
+      UInt  nchecked;   // nr of checked executions at this period
+   }
+   SBSample;
+
+static VgHashTable* sb_samples = NULL; /* of SBSample */
+static UInt  sample_seed = 0;
+static ULong stats__sampled_checks = 0;
+
+static VG_REGPARM(1)
+void evh__sample_checked ( SBSample* s )
+{
+   stats__sampled_checks++;
+   if (s->period < HG_(clo_race_sampling_period)
+       && ++s->nchecked == SAMPLE_BURST) {
+      s->nchecked = 0;
+      s->period *= 2;
+      if (s->period > HG_(clo_race_sampling_period))
+         s->period = HG_(clo_race_sampling_period);
+   }
+   /* Randomise the distance to the next check a bit, so that we don't
+      keep missing the same executions, e.g. those done by one of two
+      threads running the same loop in lock step. */
+   s->countdown = s->period / 2 + VG_(random)( &sample_seed ) % s->period;
+}
+
+/* Adds to sbOut the code deciding whether this execution of the
+   superblock starting at guest_addr is to be checked, and returns an
+   Ity_I1 atom holding the decision. */
+static IRExpr* mk_sample_guard ( IRSB* sbOut, Addr guest_addr )
+{
+   SBSample* s = VG_(HT_lookup)( sb_samples, guest_addr );
+   IRTemp    cnt     = newIRTemp(sbOut->tyenv, Ity_I32);
+   IRTemp    cnt1    = newIRTemp(sbOut->tyenv, Ity_I32);
+   IRTemp    checked = newIRTemp(sbOut->tyenv, Ity_I1);
+   IRDirty*  di;
+
+   if (!s) {
+      s = HG_(zalloc)( "hg.mk_sample_guard.1", sizeof(SBSample) );
+      s->guest_addr = guest_addr;
+      s->countdown  = 0;
+      s->period     = 1;
+      VG_(HT_add_node)( sb_samples, s );
+   }
+
+#  if defined(VG_BIGENDIAN)
+   const IREndness end = Iend_BE;
+#  else
+   const IREndness end = Iend_LE;
+#  endif
+   addStmtToIRSB(sbOut,
+                 assign(cnt, IRExpr_Load(end, Ity_I32,
+                                         mkIRExpr_HWord((HWord)&s->countdown))));
+   addStmtToIRSB(sbOut,
+                 assign(checked, binop(Iop_CmpEQ32, mkexpr(cnt), mkU32(0))));
+   addStmtToIRSB(sbOut,
+                 assign(cnt1, binop(Iop_Sub32, mkexpr(cnt), mkU32(1))));
+   addStmtToIRSB(sbOut,
+                 IRStmt_Store(end, mkIRExpr_HWord((HWord)&s->countdown),
+                              mkexpr(cnt1)));
+
+   /* On a checked execution, let the helper compute the next countdown. */
+   di = unsafeIRDirty_0_N( 1, "evh__sample_checked",
+                           VG_(fnptr_to_fnentry)( &evh__sample_checked ),
+                           mkIRExprVec_1( mkIRExpr_HWord((HWord)s) ) );
+   di->guard = mkexpr(checked);
+   di->mFx   = Ifx_Modify;
+   di->mAddr = mkIRExpr_HWord((HWord)&s->countdown);
+   di->mSize = sizeof(s->countdown);
+   addStmtToIRSB(sbOut, IRStmt_Dirty(di));
+
+   return mkexpr(checked);
+}
+
+/* Returns the guard to use for a memory access guarded by 'guard'
+   (NULL => True): if sampling, that is 'guard' and'ed with the sampling
+   decision for the superblock, which is computed in *sampled on the
+   first call for a superblock. */
+static IRExpr* mk_access_guard ( IRSB* sbOut, IRExpr** sampled,
+                                 Addr guest_addr, IRExpr* guard )
+{
+   if (!HG_(clo_race_sampling))
+      return guard;
+   if (!*sampled)
+      *sampled = mk_sample_guard( sbOut, guest_addr );
+   return guard ? mk_And1( sbOut, guard, *sampled ) : *sampled;
+}
+
 static void instrument_mem_access ( IRSB*   sbOut, 
                                     IRExpr* addr,
                                     Int     szB,
@@ -4727,6 +4833,8 @@ IRSB* hg_instrument ( VgCallbackClosure* closure,
    IRStmt* st;
    Bool    inLDSO = False;
    Addr    inLDSOmask4K = 1; /* mismatches on first check */
+   IRExpr* sampled = NULL; /* with --race-sampling, is this execution
+                              checked?  Computed when first needed. */
 
    // Set to True when SP must be fixed up when taking a stack trace for the
    // mem accesses in the rest of the instruction
@@ -4860,7 +4968,7 @@ IRSB* hg_instrument ( VgCallbackClosure* closure,
                      * sizeofIRType(typeOfIRExpr(bbIn->tyenv, cas->dataLo)),
                   False/*!isStore*/, fixupSP_needed,
                   hWordTy_szB, goff_SP, goff_SP_s1,
-                  NULL/*no-guard*/
+                  mk_access_guard( bbOut, &sampled, vge->base[0], NULL )
                );
             }
             break;
@@ -4881,7 +4989,7 @@ IRSB* hg_instrument ( VgCallbackClosure* closure,
                      sizeofIRType(dataTy),
                      False/*!isStore*/, fixupSP_needed,
                      hWordTy_szB, goff_SP, goff_SP_s1,
-                     NULL/*no-guard*/
+                     mk_access_guard( bbOut, &sampled, vge->base[0], NULL )
                   );
                }
             } else {
@@ -4899,7 +5007,7 @@ IRSB* hg_instrument ( VgCallbackClosure* closure,
                   sizeofIRType(typeOfIRExpr(bbIn->tyenv, st->Ist.Store.data)),
                   True/*isStore*/, fixupSP_needed,
                   hWordTy_szB, goff_SP, goff_SP_s1,
-                  NULL/*no-guard*/
+                  mk_access_guard( bbOut, &sampled, vge->base[0], NULL )
                );
             }
             break;
@@ -4913,7 +5021,9 @@ IRSB* hg_instrument ( VgCallbackClosure* closure,
             instrument_mem_access( bbOut, addr, sizeofIRType(type),
                                    True/*isStore*/, fixupSP_needed,
                                    hWordTy_szB,
-                                   goff_SP, goff_SP_s1, sg->guard );
+                                   goff_SP, goff_SP_s1,
+                                   mk_access_guard( bbOut, &sampled,
+                                                    vge->base[0], sg->guard ) );
             break;
          }
 
@@ -4927,7 +5037,9 @@ IRSB* hg_instrument ( VgCallbackClosure* closure,
             instrument_mem_access( bbOut, addr, sizeofIRType(type),
                                    False/*!isStore*/, fixupSP_needed,
                                    hWordTy_szB,
-                                   goff_SP, goff_SP_s1, lg->guard );
+                                   goff_SP, goff_SP_s1,
+                                   mk_access_guard( bbOut, &sampled,
+                                                    vge->base[0], lg->guard ) );
             break;
          }
 
@@ -4941,7 +5053,7 @@ IRSB* hg_instrument ( VgCallbackClosure* closure,
                      sizeofIRType(data->Iex.Load.ty),
                      False/*!isStore*/, fixupSP_needed,
                      hWordTy_szB, goff_SP, goff_SP_s1,
-                     NULL/*no-guard*/
+                     mk_access_guard( bbOut, &sampled, vge->base[0], NULL )
                   );
                }
             }
@@ -4963,7 +5075,7 @@ IRSB* hg_instrument ( VgCallbackClosure* closure,
                         bbOut, d->mAddr, dataSize,
                         False/*!isStore*/, fixupSP_needed,
                         hWordTy_szB, goff_SP, goff_SP_s1,
-                        NULL/*no-guard*/
+                        mk_access_guard( bbOut, &sampled, vge->base[0], NULL )
                      );
                   }
                }
@@ -4973,7 +5085,7 @@ IRSB* hg_instrument ( VgCallbackClosure* closure,
                         bbOut, d->mAddr, dataSize,
                         True/*isStore*/, fixupSP_needed,
                         hWordTy_szB, goff_SP, goff_SP_s1,
-                        NULL/*no-guard*/
+                        mk_access_guard( bbOut, &sampled, vge->base[0], NULL )
                      );
                   }
                }
@@ -5744,6 +5856,11 @@ static Bool hg_process_cmd_line_option ( const HChar* arg )
    else if VG_BINT_CLO(arg, "--conflict-cache-size",
                        HG_(clo_conflict_cache_size), 10*1000, 150*1000*1000) {}
 
+   else if VG_XACT_CLO(arg, "--history-store=map",
+                            HG_(clo_history_store), 0);
+   else if VG_XACT_CLO(arg, "--history-store=ring",
+                            HG_(clo_history_store), 1);
+
    /* "stuvwx" --> stuvwx (binary) */
    else if VG_STR_CLO(arg, "--hg-sanity-flags", tmp_str) {
       Int j;
@@ -5777,6 +5894,10 @@ static Bool hg_process_cmd_line_option ( const HChar* arg )
 
    else if VG_BOOL_CLO(arg, "--check-stack-refs",
                             HG_(clo_check_stack_refs)) {}
+   else if VG_BOOL_CLO(arg, "--race-sampling",
+                            HG_(clo_race_sampling)) {}
+   else if VG_BINT_CLO(arg, "--race-sampling-period",
+                       HG_(clo_race_sampling_period), 1, 1000*1000) {}
    else if VG_BOOL_CLO(arg, "--ignore-thread-creation",
                             HG_(clo_ignore_thread_creation)) {}
 
@@ -5800,8 +5921,14 @@ static void hg_print_usage ( void )
 "        yes : derive a stacktrace from the previous stacktrace\n"
 "          if there was no call/return or similar instruction\n"
 "    --conflict-cache-size=N   size of 'full' history cache [2000000]\n"
+"    --history-store=map|ring  how the 'full' history cache is kept [map]\n"
+"       map:    one entry per address and thread, exact LRU discarding\n"
+"       ring:   per-thread chunks of recent accesses (faster, smaller)\n"
 "    --check-stack-refs=no|yes race-check reads and writes on the\n"
 "                              main stack and thread stacks? [yes]\n"
+"    --race-sampling=no|yes    race-check only a sample of the executions\n"
+"                              of hot code? [no]\n"
+"    --race-sampling-period=N  check hot code once every N executions [1000]\n"
 "    --ignore-thread-creation=yes|no Ignore activities during thread\n"
 "                              creation [%s]\n",
 HG_(clo_ignore_thread_creation) ? "yes" : "no"
@@ -5889,6 +6016,10 @@ static void hg_print_stats (void)
                stats__lockN_releases
               );
    VG_(printf)("   sanity checks: %'8lu\n", stats__sanity_checks);
+   if (HG_(clo_race_sampling))
+      VG_(printf)("   race sampling: %'8llu checked executions of "
+                  "%'u superblocks\n",
+                  stats__sampled_checks, VG_(HT_count_nodes)(sb_samples));
 
    VG_(printf)("\n");
    libhb_shutdown(True); // This in fact only print stats.
@@ -5976,6 +6107,9 @@ static void hg_post_clo_init ( void )
    if (HG_(clo_track_lockorders))
       laog__init();
 
+   if (HG_(clo_race_sampling))
+      sb_samples = VG_(HT_construct)( "hg_post_clo_init.1 (sb_samples)" );
+
    initialise_data_structures(hbthr_root);
    if (VG_(clo_xtree_memory) == Vg_XTMemory_Full)
       // Activate full xtree memory profiling.
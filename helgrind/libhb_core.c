@@ -347,6 +347,11 @@ struct _Thr {
       If SP_S1 is != 0, then the cached rcec is valid. The valid cached rcec
       can be used to generate a new RCEC by changing just the last frame. */
 
+   /* With --history-store=ring, the chunk of access records this thread
+      is currently appending to, or NULL if it has none (yet, or because
+      the chunk was recycled). */
+   struct _HChunk* hchunk;
+
    /* The ULongs (scalar Kws) in this accumulate in strictly
       increasing order, without duplicates.  This is important because
       we need to be able to find a given scalar Kw in this array
@@ -605,6 +610,17 @@ typedef
    }
    Cache;
 
+/* The entry a line is cached in.  The bits above the ones that select
+   the entry directly are folded in, so that data at the same offset in
+   regions that are a multiple of 4MB apart (typically, the stacks and
+   malloc arenas of different threads) does not all compete for the
+   same entries.  Within any 4MB aligned region, distinct lines still
+   get distinct entries. */
+static inline UWord scache_wix ( Addr a ) {
+   UWord hi = (UWord)(a >> (N_LINE_BITS + N_WAY_BITS));
+   return ((a >> N_LINE_BITS) ^ (hi * 0x9E3779B1U)) & (N_WAY_NENT - 1);
+}
+
 static inline Bool is_valid_scache_tag ( Addr tag ) {
    /* a valid tag should be naturally aligned to the start of
       a CacheLine. */
@@ -662,6 +678,9 @@ static UWord stats__cline_16to8pulldown  = 0; // # calls to pulldown_to_8
 static UWord stats__vts__tick            = 0; // # calls to VTS__tick
 static UWord stats__vts__join            = 0; // # calls to VTS__join
 static UWord stats__vts__cmpLEQ          = 0; // # calls to VTS__cmpLEQ
+static UWord stats__vts__cmpLEQ_bsearch  = 0; // # of those w/ binary search
+static ULong stats__vts__cmpLEQ_seen     = 0; // # ScalarTSs examined
+static ULong stats__vts__cmpLEQ_sizes    = 0; // # ScalarTSs in operands
 static UWord stats__vts__cmp_structural  = 0; // # calls to VTS__cmp_structural
 static UWord stats__vts_tab_GC           = 0; // # nr of vts_tab GC
 static UWord stats__vts_pruning          = 0; // # nr of vts pruning
@@ -1685,18 +1704,22 @@ static void shmem__invalidate_scache_range (Addr ga, SizeT szB)
    tl_assert (0 == (szB & (N_LINE_ARANGE - 1)));
    
 
-   Word ga_ix = (ga >> N_LINE_BITS) & (N_WAY_NENT - 1);
-   Word nwix = szB / N_LINE_ARANGE;
+   Word nlines = szB / N_LINE_ARANGE;
 
-   if (nwix > N_WAY_NENT)
-      nwix = N_WAY_NENT; // no need to check several times the same entry.
-
-   for (wix = 0; wix < nwix; wix++) {
-      if (address_in_range(cache_shmem.tags0[ga_ix], ga, szB))
-         cache_shmem.tags0[ga_ix] = 1/*INVALID*/;
-      ga_ix++;
-      if (UNLIKELY(ga_ix == N_WAY_NENT))
-         ga_ix = 0;
+   if (nlines > N_WAY_NENT) {
+      // Cheaper to check every entry once.
+      for (wix = 0; wix < N_WAY_NENT; wix++) {
+         if (address_in_range(cache_shmem.tags0[wix], ga, szB))
+            cache_shmem.tags0[wix] = 1/*INVALID*/;
+      }
+   } else {
+      Word i;
+      for (i = 0; i < nlines; i++) {
+         Addr tag = ga + i * N_LINE_ARANGE;
+         wix = scache_wix(tag);
+         if (cache_shmem.tags0[wix] == tag)
+            cache_shmem.tags0[wix] = 1/*INVALID*/;
+      }
    }
 }
 
@@ -1752,7 +1775,7 @@ static inline CacheLine* get_cacheline ( Addr a )
    /* tag is 'a' with the in-line offset masked out, 
       eg a[31]..a[4] 0000 */
    Addr       tag = a & ~(N_LINE_ARANGE - 1);
-   UWord      wix = (a >> N_LINE_BITS) & (N_WAY_NENT - 1);
+   UWord      wix = scache_wix(a);
    stats__cache_totrefs++;
    if (LIKELY(tag == cache_shmem.tags0[wix])) {
       return &cache_shmem.lyns0[wix];
@@ -1770,7 +1793,7 @@ static __attribute__((noinline))
    CacheLine* cl;
    Addr*      tag_old_p;
    Addr       tag = a & ~(N_LINE_ARANGE - 1);
-   UWord      wix = (a >> N_LINE_BITS) & (N_WAY_NENT - 1);
+   UWord      wix = scache_wix(a);
 
    tl_assert(tag != cache_shmem.tags0[wix]);
 
@@ -2497,11 +2520,20 @@ static void VTS__join ( /*OUT*/VTS* out, VTS* a, VTS* b )
    they are, or the first ThrID for which they are not (no valid ThrID
    has the value zero).  This rather strange convention is used
    because sometimes we want to know the actual index at which they
-   first differ. */
+   first differ.
+
+   Only the ThrIDs mentioned in 'a' can make the answer False, since a
+   ThrID that is only in 'b' is compared against an implicit zero in
+   'a'.  So this walks 'a', finding each of its ThrIDs in 'b'.  When
+   'a' is much shorter than 'b' (a thread which has synchronised with
+   many others, compared against a recent access), the ThrIDs are
+   found by binary search in the rest of 'b' rather than by stepping
+   through it, making the cost O(|a| log |b|) instead of
+   O(|a| + |b|). */
 static UInt/*ThrID*/ VTS__cmpLEQ ( VTS* a, VTS* b )
 {
-   Word  ia, ib, useda, usedb;
-   ULong tyma, tymb;
+   UInt  ia, ib, useda, usedb;
+   Bool  bsearch;
 
    stats__vts__cmpLEQ++;
 
@@ -2509,71 +2541,43 @@ static UInt/*ThrID*/ VTS__cmpLEQ ( VTS* a, VTS* b )
    tl_assert(b);
    useda = a->usedTS;
    usedb = b->usedTS;
-
-   ia = ib = 0;
-
-   while (1) {
-
-      /* This logic is to enumerate doubles (tyma, tymb) drawn
-         from a and b in order, and tyma/b are the relevant
-         scalar timestamps, taking into account implicit zeroes. */
-      ThrID thrid;
-
-      tl_assert(ia >= 0 && ia <= useda);
-      tl_assert(ib >= 0 && ib <= usedb);
-
-      if        (ia == useda && ib == usedb) {
-         /* both empty - done */
-         break;
-
-      } else if (ia == useda && ib != usedb) {
-         /* a empty, use up b */
-         ScalarTS* tmpb = &b->ts[ib];
-         tyma  = 0;
-         tymb  = tmpb->tym;
-         thrid = tmpb->thrid;
-         ib++;
-
-      } else if (ia != useda && ib == usedb) {
-         /* b empty, use up a */
-         ScalarTS* tmpa = &a->ts[ia];
-         tyma  = tmpa->tym;
-         thrid = tmpa->thrid;
-         tymb  = 0;
-         ia++;
-
-      } else {
-         /* both not empty; extract lowest-ThrID'd triple */
-         ScalarTS* tmpa = &a->ts[ia];
-         ScalarTS* tmpb = &b->ts[ib];
-         if (tmpa->thrid < tmpb->thrid) {
-            /* a has the lowest unconsidered ThrID */
-            tyma  = tmpa->tym;
-            thrid = tmpa->thrid;
-            tymb  = 0;
-            ia++;
+   bsearch = 8 * useda < usedb;
+   if (bsearch)
+      stats__vts__cmpLEQ_bsearch++;
+   stats__vts__cmpLEQ_sizes += useda + usedb;
+
+   ib = 0;
+   for (ia = 0; ia < useda; ia++) {
+      ScalarTS* tmpa  = &a->ts[ia];
+      ThrID     thrid = tmpa->thrid;
+      ULong     tymb  = 0;
+
+      /* Advance ib to the first entry in b whose ThrID is >= thrid. */
+      if (bsearch) {
+         UInt lo = ib, hi = usedb;
+         while (lo < hi) {
+            UInt mid = lo + (hi - lo) / 2;
+            stats__vts__cmpLEQ_seen++;
+            if (b->ts[mid].thrid < thrid)
+               lo = mid + 1;
+            else
+               hi = mid;
          }
-         else
-         if (tmpa->thrid > tmpb->thrid) {
-            /* b has the lowest unconsidered ThrID */
-            tyma  = 0;
-            tymb  = tmpb->tym;
-            thrid = tmpb->thrid;
-            ib++;
-         } else {
-            /* they both next mention the same ThrID */
-            tl_assert(tmpa->thrid == tmpb->thrid);
-            tyma  = tmpa->tym;
-            thrid = tmpa->thrid;
-            tymb  = tmpb->tym;
-            ia++;
+         ib = lo;
+      } else {
+         while (ib < usedb && b->ts[ib].thrid < thrid) {
+            stats__vts__cmpLEQ_seen++;
             ib++;
          }
       }
+      stats__vts__cmpLEQ_seen++;
 
-      /* having laboriously determined (tyma, tymb), do something
-         useful with it. */
-      if (tyma > tymb) {
+      if (ib < usedb && b->ts[ib].thrid == thrid) {
+         tymb = b->ts[ib].tym;
+         ib++;
+      }
+
+      if (tmpa->tym > tymb) {
          /* not LEQ at this index.  Quit, since the answer is
             determined already. */
          tl_assert(thrid >= 1024);
@@ -2611,9 +2615,13 @@ Word VTS__cmp_structural ( VTS* a, VTS* b )
    if (LIKELY(useda == usedb)) {
       ScalarTS *tmpa = NULL, *tmpb = NULL;
       stats__vts__cmp_structural_slow++;
-      /* Same length vectors.  Find the first difference, if any, as
-         fast as possible. */
-      for (i = 0; i < useda; i++) {
+      /* Same length vectors.  Find the last difference, if any, as
+         fast as possible.  Scan from the end, since that is where the
+         ThrIDs of the most recently created threads are, which are
+         the ones still running and ticking their entries.  With many
+         threads, vectors mostly differ there and share long
+         prefixes of entries for threads that are long gone. */
+      for (i = useda - 1; i >= 0; i--) {
          tmpa = &ctsa[i];
          tmpb = &ctsb[i];
          if (LIKELY(tmpa->tym == tmpb->tym
@@ -2622,7 +2630,7 @@ Word VTS__cmp_structural ( VTS* a, VTS* b )
          else
             break;
       }
-      if (UNLIKELY(i == useda)) {
+      if (UNLIKELY(i < 0)) {
          /* They're identical. */
          return 0;
       } else {
@@ -3398,6 +3406,7 @@ static ULong stats__cmpLEQ_queries = 0;
 static ULong stats__cmpLEQ_misses  = 0;
 static ULong stats__join2_queries  = 0;
 static ULong stats__join2_misses   = 0;
+static ULong stats__join2_dominated = 0;
 
 static inline UInt ROL32 ( UInt w, Int n ) {
    w = (w << n) | (w >> (32-n));
@@ -3503,9 +3512,21 @@ static VtsID VtsID__join2_WRK ( VtsID vi1, VtsID vi2 ) {
    ////--
    vts1 = VtsID__to_VTS(vi1);
    vts2 = VtsID__to_VTS(vi2);
-   temp_max_sized_VTS->usedTS = 0;
-   VTS__join(temp_max_sized_VTS, vts1,vts2);
-   res = vts_tab__find__or__clone_and_add(temp_max_sized_VTS);
+   /* If one arg is LEQ the other, that other is the join, and we need
+      neither build the join nor look it up in vts_set.  This is
+      common: eg a thread acquiring a lock which it released last, or
+      which carries nothing the thread has not already seen. */
+   if (VTS__cmpLEQ(vts1, vts2) == 0) {
+      stats__join2_dominated++;
+      res = vi2;
+   } else if (VTS__cmpLEQ(vts2, vts1) == 0) {
+      stats__join2_dominated++;
+      res = vi1;
+   } else {
+      temp_max_sized_VTS->usedTS = 0;
+      VTS__join(temp_max_sized_VTS, vts1,vts2);
+      res = vts_tab__find__or__clone_and_add(temp_max_sized_VTS);
+   }
    ////++
    join2_cache[hash].vi1 = vi1;
    join2_cache[hash].vi2 = vi2;
@@ -4260,6 +4281,9 @@ static inline SVal Ptr2SVal (void* ptr)
       of course decrement the reference count on the RCEC it
       refers to, in order that entries from (1) eventually get
       discarded too.
+
+   With --history-store=ring, (2) is replaced by per-thread chunks of
+   access records, see Part (2') below.
 */
 
 static UWord stats__evm__lookup_found = 0;
@@ -4891,6 +4915,187 @@ static inline Word cmp_nonempty_intervals ( Addr a1, SizeT n1,
 
 static UWord event_map_stamp = 0; // Used to stamp each OldRef when touched.
 
+
+///////////////////////////////////////////////////////
+//// Part (2'):
+///  With --history-store=ring, (2) is replaced by per-thread chunks of
+///  access records.  Each thread appends the accesses it does to the
+///  chunk it currently owns; there is no lookup, no hashing and no list
+///  manipulation per access.  When a thread's chunk is full it gets a
+///  new one.  At most VG_(clo_conflict_cache_size) / N_HCHUNK_RECS chunks
+///  are allocated: after that, the chunk that was handed out the longest
+///  time ago is recycled, whichever thread it belongs to.  So the
+///  memory used is bounded by the conflict cache size, and the history
+///  is discarded approximately in FIFO order.
+///  Contrary to (2), an address accessed repeatedly is recorded
+///  repeatedly, so for the same size, the ring remembers the history of
+///  fewer distinct addresses.  The price is paid when a race is
+///  reported: all chunks of the other threads are then searched.  The
+///  address range covered by a chunk is used to skip most of them.
+
+#define N_HCHUNK_RECS 256
+
+typedef
+   struct {
+      UWord ga;    // address accessed
+      UWord stamp; // event_map_stamp at the time of the access
+      Thr_n_RCEC acc;
+   }
+   HistRec;
+
+typedef
+   struct _HChunk {
+      struct _HChunk* next; // chunk handed out after this one
+      ThrID thrid;          // thread owning (appending to) this chunk
+      UInt  nrecs;          // nr of used elements in recs
+      Addr  lo;             // all recs[i] are accessing [lo, hi[
+      Addr  hi;
+      HistRec recs[N_HCHUNK_RECS];
+   }
+   HChunk;
+
+/* The chunks in the order in which they were handed out to a thread. */
+static HChunk* hchunk_oldest = NULL;
+static HChunk* hchunk_newest = NULL;
+static UWord   hchunk_n      = 0; /* # chunks allocated */
+static UWord   hchunk_max    = 0; /* max # chunks, set by event_map_init */
+
+static UWord stats__hchunk_recycled   = 0;
+static UWord stats__hchunk_lookups    = 0;
+static UWord stats__hchunk_searched   = 0; // chunks searched by lookups
+static ULong stats__hchunk_recs_seen  = 0; // recs examined by lookups
+
+/* Gives a new empty chunk to thr, allocating one if the limit is not
+   reached yet, otherwise recycling the oldest one. */
+static HChunk* HChunk__new_for ( Thr* thr )
+{
+   HChunk* ch;
+   UInt    i;
+
+   if (hchunk_n < hchunk_max) {
+      ch = HG_(zalloc)( "libhb.HChunk__new_for.1", sizeof(HChunk) );
+      hchunk_n++;
+   } else {
+      Thr* owner;
+
+      ch = hchunk_oldest;
+      tl_assert(ch);
+      hchunk_oldest = ch->next;
+      if (hchunk_oldest == NULL)
+         hchunk_newest = NULL;
+      owner = Thr__from_ThrID(ch->thrid);
+      if (owner->hchunk == ch)
+         owner->hchunk = NULL;
+      for (i = 0; i < ch->nrecs; i++)
+         ctxt__rcdec( ch->recs[i].acc.rcec );
+      stats__hchunk_recycled++;
+   }
+
+   ch->next  = NULL;
+   ch->thrid = thr->thrid;
+   ch->nrecs = 0;
+   ch->lo    = ~(Addr)0;
+   ch->hi    = 0;
+   if (hchunk_newest)
+      hchunk_newest->next = ch;
+   else
+      hchunk_oldest = ch;
+   hchunk_newest = ch;
+
+   thr->hchunk = ch;
+   return ch;
+}
+
+static inline void HChunk__append ( Thr* thr, Addr a, SizeT szB, Bool isW,
+                                    RCEC* rcec, WordSetID locksHeldW )
+{
+   HChunk*  ch = thr->hchunk;
+   HistRec* rec;
+
+   if (UNLIKELY(ch == NULL || ch->nrecs == N_HCHUNK_RECS))
+      ch = HChunk__new_for( thr );
+
+   rec = &ch->recs[ch->nrecs++];
+   rec->ga    = a;
+   rec->stamp = event_map_stamp;
+   rec->acc.tsw = (TSW) {.thrid  = thr->thrid,
+                         .szB    = szB,
+                         .isW    = (UInt)(isW & 1)};
+   rec->acc.locksHeldW = locksHeldW;
+   rec->acc.rcec       = rcec;
+   ctxt__rcinc(rcec);
+
+   if (a < ch->lo)
+      ch->lo = a;
+   if (a + szB > ch->hi)
+      ch->hi = a + szB;
+}
+
+/* Rank of a conflicting access at cand_a, for a race on a: the access
+   at a itself is preferred, then the ones starting below a (lowest
+   address first), then the ones starting above a.  This is the order
+   in which libhb_event_map_lookup searches the OldRef hashtable. */
+static inline UWord cand_rank ( Addr a, Addr cand_a )
+{
+   if (cand_a == a)
+      return 0;
+   if (cand_a < a)
+      return 8 - (a - cand_a);
+   return 7 + (cand_a - a);
+}
+
+/* Returns the most recent access by another thread than thrid
+   conflicting with [a, a+szB[/isW, or NULL if there is none. */
+static const HistRec* HChunk__lookup ( ThrID thrid, Addr a, SizeT szB,
+                                       Bool isW )
+{
+   const HChunk*  ch;
+   const HistRec* best = NULL;
+   UWord          best_rank = 0;
+   UInt           i;
+
+   stats__hchunk_lookups++;
+   for (ch = hchunk_oldest; ch; ch = ch->next) {
+      if (ch->thrid == thrid || ch->nrecs == 0)
+         continue;
+      if (cmp_nonempty_intervals(a, szB, ch->lo, ch->hi - ch->lo) != 0)
+         continue;
+      stats__hchunk_searched++;
+      stats__hchunk_recs_seen += ch->nrecs;
+      for (i = 0; i < ch->nrecs; i++) {
+         const HistRec* rec = &ch->recs[i];
+         UWord rank;
+         if ((!rec->acc.tsw.isW) && (!isW))
+            continue;
+         if (cmp_nonempty_intervals(a, szB, rec->ga, rec->acc.tsw.szB) != 0)
+            continue;
+         rank = cand_rank(a, rec->ga);
+         if (!best
+             || rank < best_rank
+             || (rank == best_rank
+                 && (best->stamp - event_map_stamp)
+                       < (rec->stamp - event_map_stamp))) {
+            best = rec;
+            best_rank = rank;
+         }
+      }
+   }
+   return best;
+}
+
+static Int cmp_HistRec_stamps ( const void* v1, const void* v2 )
+{
+   const HistRec* r1 = *(const HistRec* const *)v1;
+   const HistRec* r2 = *(const HistRec* const *)v2;
+   UWord s1 = r1->stamp - event_map_stamp;
+   UWord s2 = r2->stamp - event_map_stamp;
+
+   if (s1 < s2) return -1;
+   if (s1 > s2) return  1;
+   return 0;
+}
+
+
 static void event_map_bind ( Addr a, SizeT szB, Bool isW, Thr* thr )
 {
    OldRef  example;
@@ -4905,6 +5110,12 @@ static void event_map_bind ( Addr a, SizeT szB, Bool isW, Thr* thr )
 
    rcec = get_RCEC( thr );
 
+   if (HG_(clo_history_store) == 1) {
+      HChunk__append( thr, a, szB, isW, rcec, locksHeldW );
+      event_map_stamp++;
+      return;
+   }
+
    /* Look in the oldrefHT to see if we already have a record for this
       address/thr/sz/isW. */
    example.ga = a;
@@ -4960,6 +5171,31 @@ static void event_map_bind ( Addr a, SizeT szB, Bool isW, Thr* thr )
 }
 
 
+/* Helper for libhb_event_map_lookup: set the OUT parameters from acc. */
+static void set_conflicting_access ( /*OUT*/ExeContext** resEC,
+                                     /*OUT*/Thr**        resThr,
+                                     /*OUT*/SizeT*       resSzB,
+                                     /*OUT*/Bool*        resIsW,
+                                     /*OUT*/WordSetID*   locksHeldW,
+                                     const Thr_n_RCEC* acc )
+{
+   Int n, maxNFrames;
+   RCEC* rcec = acc->rcec;
+   tl_assert(acc->tsw.thrid);
+   tl_assert(rcec);
+   tl_assert(rcec->magic == RCEC_MAGIC);
+   /* Count how many non-zero frames we have. */
+   maxNFrames = min_UInt(N_FRAMES, VG_(clo_backtrace_size));
+   for (n = 0; n < maxNFrames; n++) {
+      if (0 == rcec->frames[n]) break;
+   }
+   *resEC      = VG_(make_ExeContext_from_StackTrace)(rcec->frames, n);
+   *resThr     = Thr__from_ThrID(acc->tsw.thrid);
+   *resSzB     = acc->tsw.szB;
+   *resIsW     = acc->tsw.isW;
+   *locksHeldW = acc->locksHeldW;
+}
+
 /* Extract info from the conflicting-access machinery.
    Returns the most recent conflicting access with thr/[a, a+szB[/isW. */
 Bool libhb_event_map_lookup ( /*OUT*/ExeContext** resEC,
@@ -4985,6 +5221,18 @@ Bool libhb_event_map_lookup ( /*OUT*/ExeContext** resEC,
 
    ThrID thrid = thr->thrid;
 
+   if (HG_(clo_history_store) == 1) {
+      const HistRec* rec = HChunk__lookup( thrid, a, szB, isW );
+      if (rec) {
+         set_conflicting_access( resEC, resThr, resSzB, resIsW, locksHeldW,
+                                 &rec->acc );
+         stats__evm__lookup_found++;
+         return True;
+      }
+      stats__evm__lookup_notfound++;
+      return False;
+   }
+
    toCheck[nToCheck++] = a;
    for (i = -7; i < (Word)szB; i++) {
       if (i != 0)
@@ -5039,23 +5287,9 @@ Bool libhb_event_map_lookup ( /*OUT*/ExeContext** resEC,
 
       if (ref) {
          /* return with success */
-         Int n, maxNFrames;
-         RCEC*     ref_rcec = ref->acc.rcec;
-         tl_assert(ref->acc.tsw.thrid);
-         tl_assert(ref_rcec);
-         tl_assert(ref_rcec->magic == RCEC_MAGIC);
          tl_assert(ref_szB >= 1);
-         /* Count how many non-zero frames we have. */
-         maxNFrames = min_UInt(N_FRAMES, VG_(clo_backtrace_size));
-         for (n = 0; n < maxNFrames; n++) {
-            if (0 == ref_rcec->frames[n]) break;
-         }
-         *resEC      = VG_(make_ExeContext_from_StackTrace)(ref_rcec->frames,
-                                                            n);
-         *resThr     = Thr__from_ThrID(ref->acc.tsw.thrid);
-         *resSzB     = ref_szB;
-         *resIsW     = ref->acc.tsw.isW;
-         *locksHeldW = ref->acc.locksHeldW;
+         set_conflicting_access( resEC, resThr, resSzB, resIsW, locksHeldW,
+                                 &ref->acc );
          stats__evm__lookup_found++;
          return True;
       }
@@ -5069,28 +5303,61 @@ Bool libhb_event_map_lookup ( /*OUT*/ExeContext** resEC,
 }
 
 
+static void report_access ( const Thr_n_RCEC* acc, Addr ga, Access_t fn )
+{
+   RCEC* rcec = acc->rcec;
+   Int n;
+
+   for (n = 0; n < N_FRAMES; n++) {
+      if (0 == rcec->frames[n]) {
+         break;
+      }
+   }
+   (*fn)(rcec->frames, n,
+         Thr__from_ThrID(acc->tsw.thrid),
+         ga,
+         acc->tsw.szB,
+         acc->tsw.isW,
+         acc->locksHeldW);
+}
+
 void libhb_event_map_access_history ( Addr a, SizeT szB, Access_t fn )
 {
    OldRef *ref = lru.next;
    SizeT ref_szB;
-   Int n;
-      
-   while (ref != &mru) {
-      ref_szB = ref->acc.tsw.szB;
-      if (cmp_nonempty_intervals(a, szB, ref->ga, ref_szB) == 0) {
-         RCEC* ref_rcec = ref->acc.rcec;
-         for (n = 0; n < N_FRAMES; n++) {
-            if (0 == ref_rcec->frames[n]) {
-               break;
-            }
+
+   if (HG_(clo_history_store) == 1) {
+      /* Report the accesses from oldest to newest, as done for the
+         OldRefs.  The chunks of the different threads interleave in
+         time, so sort the matching records. */
+      XArray* recs = VG_(newXA)( HG_(zalloc), "libhb.event_map_access_history",
+                                 HG_(free), sizeof(HistRec*) );
+      const HChunk* ch;
+      Word i;
+      VG_(setCmpFnXA)( recs, cmp_HistRec_stamps );
+      for (ch = hchunk_oldest; ch; ch = ch->next) {
+         if (ch->nrecs == 0
+             || cmp_nonempty_intervals(a, szB, ch->lo, ch->hi - ch->lo) != 0)
+            continue;
+         for (i = 0; i < ch->nrecs; i++) {
+            const HistRec* rec = &ch->recs[i];
+            if (cmp_nonempty_intervals(a, szB, rec->ga, rec->acc.tsw.szB) == 0)
+               VG_(addToXA)( recs, &rec );
          }
-         (*fn)(ref_rcec->frames, n,
-               Thr__from_ThrID(ref->acc.tsw.thrid),
-               ref->ga,
-               ref_szB,
-               ref->acc.tsw.isW,
-               ref->acc.locksHeldW);
       }
+      VG_(sortXA)( recs );
+      for (i = 0; i < VG_(sizeXA)( recs ); i++) {
+         const HistRec* rec = *(const HistRec**)VG_(indexXA)( recs, i );
+         report_access( &rec->acc, rec->ga, fn );
+      }
+      VG_(deleteXA)( recs );
+      return;
+   }
+
+   while (ref != &mru) {
+      ref_szB = ref->acc.tsw.szB;
+      if (cmp_nonempty_intervals(a, szB, ref->ga, ref_szB) == 0)
+         report_access( &ref->acc, ref->ga, fn );
       tl_assert (ref->next == &mru
                  || ((ref->stamp - event_map_stamp)
                         < ref->next->stamp - event_map_stamp));
@@ -5142,13 +5409,18 @@ static void event_map_init ( void )
                            .locksHeldW = 0, 
                            .rcec = NULL};
    lru.acc = mru.acc;
+
+   /* Access record chunks, for --history-store=ring */
+   hchunk_max = HG_(clo_conflict_cache_size) / N_HCHUNK_RECS;
 }
 
 static void event_map__check_reference_counts ( void )
 {
    RCEC*   rcec;
    OldRef* oldref;
+   HChunk* ch;
    Word    i;
+   UInt    j;
    UWord   nEnts = 0;
 
    /* Set the 'check' reference counts to zero.  Also, optionally
@@ -5179,6 +5451,13 @@ static void event_map__check_reference_counts ( void )
       oldref->acc.rcec->rcX++;
       oldref = VG_(HT_Next)( oldrefHT );
    }
+   for (ch = hchunk_oldest; ch; ch = ch->next) {
+      for (j = 0; j < ch->nrecs; j++) {
+         tl_assert (ch->recs[j].acc.tsw.thrid == ch->thrid);
+         tl_assert (ch->recs[j].acc.rcec->magic == RCEC_MAGIC);
+         ch->recs[j].acc.rcec->rcX++;
+      }
+   }
 
    /* compare check ref counts with actual */
    for (i = 0; i < N_RCEC_TAB; i++) {
@@ -6101,7 +6380,7 @@ static void zsm_sset_range ( Addr a, SizeT len, SVal svNew )
       /* tag is 'a' with the in-line offset masked out, 
          eg a[31]..a[4] 0000 */
       Addr       tag = a & ~(N_LINE_ARANGE - 1);
-      UWord      wix = (a >> N_LINE_BITS) & (N_WAY_NENT - 1);
+      UWord      wix = scache_wix(a);
       if (LIKELY(tag == cache_shmem.tags0[wix])) {
          n_New_in_cache++;
       } else {
@@ -6149,7 +6428,7 @@ static void zsm_sset_range ( Addr a, SizeT len, SVal svNew )
             break;
          tl_assert(get_cacheline_offset(aligned_start) == 0);
          tag = aligned_start & ~(N_LINE_ARANGE - 1);
-         wix = (aligned_start >> N_LINE_BITS) & (N_WAY_NENT - 1);
+         wix = scache_wix(aligned_start);
          if (tag == cache_shmem.tags0[wix]) {
             UWord i;
             for (i = 0; i < N_LINE_ARANGE / 8; i++)
@@ -6713,12 +6992,18 @@ void libhb_shutdown ( Bool show_stats )
                   stats__msmcwrite, stats__msmcwrite_change);
       VG_(printf)("   libhb: %'13llu cmpLEQ queries (%'llu misses)\n",
                   stats__cmpLEQ_queries, stats__cmpLEQ_misses);
-      VG_(printf)("   libhb: %'13llu join2  queries (%'llu misses)\n",
-                  stats__join2_queries, stats__join2_misses);
+      VG_(printf)("   libhb: %'13llu join2  queries (%'llu misses,"
+                  " %'llu dominated)\n",
+                  stats__join2_queries, stats__join2_misses,
+                  stats__join2_dominated);
 
       VG_(printf)("%s","\n");
       VG_(printf)("   libhb: VTSops: tick %'lu,  join %'lu,  cmpLEQ %'lu\n",
                   stats__vts__tick, stats__vts__join,  stats__vts__cmpLEQ );
+      VG_(printf)("   libhb: VTSops: cmpLEQ %'lu binary searches,"
+                  " %'llu of %'llu ScalarTSs examined\n",
+                  stats__vts__cmpLEQ_bsearch, stats__vts__cmpLEQ_seen,
+                  stats__vts__cmpLEQ_sizes );
       VG_(printf)("   libhb: VTSops: cmp_structural %'lu (%'lu slow)\n",
                   stats__vts__cmp_structural, stats__vts__cmp_structural_slow);
       VG_(printf)("   libhb: VTSset: find__or__clone_and_add %'lu"
@@ -6776,6 +7061,16 @@ void libhb_shutdown ( Bool show_stats )
       VG_(printf)( "   libhb: oldrefHTN %lu (%'d bytes)\n",
                    oldrefHTN, (int)(oldrefHTN * sizeof(OldRef)));
       tl_assert (oldrefHTN == VG_(HT_count_nodes) (oldrefHT));
+      if (HG_(clo_history_store) == 1) {
+         VG_(printf)( "   libhb: hchunks %lu of %lu (%'lu bytes),"
+                      " %'lu recycled\n",
+                      hchunk_n, hchunk_max, hchunk_n * sizeof(HChunk),
+                      stats__hchunk_recycled);
+         VG_(printf)( "   libhb: hchunk lookups %lu searched %'lu chunks,"
+                      " %'llu recs\n",
+                      stats__hchunk_lookups, stats__hchunk_searched,
+                      stats__hchunk_recs_seen);
+      }
       VG_(printf)( "   libhb: oldref lookup found=%lu notfound=%lu\n",
                    stats__evm__lookup_found, stats__evm__lookup_notfound);
       if (VG_(clo_verbosity) > 1)
@@ -7299,7 +7594,7 @@ UWord libhb_srange_get_abits (Addr a, UChar *abits, SizeT len)
       SVal       sv = SVal_INVALID;
       Addr       b = a + i;
       Addr       tag = b & ~(N_LINE_ARANGE - 1);
-      UWord      wix = (b >> N_LINE_BITS) & (N_WAY_NENT - 1);
+      UWord      wix = scache_wix(b);
       UWord      cloff = get_cacheline_offset(b);
 
       /* Note: we do not use get_cacheline(b) to avoid creating cachelines
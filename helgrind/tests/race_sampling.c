@@ -0,0 +1,57 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* A race in a hot loop, for --race-sampling.  Two threads increment
+   'racy' many times with no locking, and then 'locked' many times
+   holding a lock.  The race on 'racy' must be reported though most
+   executions of the loop are not checked, and there must be no false
+   report about 'locked' or the threads' own counters. */
+
+#define N 100000
+
+volatile int racy = 0;
+volatile int locked = 0;
+pthread_mutex_t mx = PTHREAD_MUTEX_INITIALIZER;
+
+void* worker ( void* arg )
+{
+   volatile int* mine = arg;
+   int i;
+
+   for (i = 0; i < N; i++) {
+      /* Unprotected relative to the other thread */
+      racy++;
+      (*mine)++;
+   }
+   for (i = 0; i < N; i++) {
+      pthread_mutex_lock(&mx);
+      locked++;
+      pthread_mutex_unlock(&mx);
+      (*mine)++;
+   }
+   return NULL;
+}
+
+int main ( void )
+{
+   pthread_t child[2];
+   int* counts = calloc(2, sizeof(int));
+   int i;
+
+   for (i = 0; i < 2; i++) {
+      if (pthread_create(&child[i], NULL, worker, &counts[i])) {
+         perror("pthread_create");
+         exit(1);
+      }
+   }
+   for (i = 0; i < 2; i++) {
+      if (pthread_join(child[i], NULL)) {
+         perror("pthread join");
+         exit(1);
+      }
+   }
+   printf("%d %d\n", locked, counts[0] + counts[1]);
+   free(counts);
+   return 0;
+}
@@ -316,6 +316,14 @@ const HChar* VG_(pp_SectKind)( VgSectKind kind );
    the address space manager mapped files. */
 VgSectKind VG_(DebugInfo_sect_kind)( /*OUT*/const HChar** objname, Addr a);
 
+/* Compresses the 'src_len' bytes at 'src' into 'dst' with LZO1X-1, the
+   compressor the debuginfo server uses, and returns the compressed
+   length.  'dst' must have room for VG_LZO_MAX_COMPRESSED(src_len) bytes.
+   Tools can use it to shrink big output files; the result can be
+   decompressed with the minilzo library's lzo1x_decompress_safe(). */
+#define VG_LZO_MAX_COMPRESSED(len)  ((len) + (len) / 16 + 64 + 3)
+SizeT VG_(lzo_compress)( UChar* dst, const UChar* src, SizeT src_len );
+
 
 #endif   // __PUB_TOOL_DEBUGINFO_H
 
@@ -149,6 +149,9 @@ void MC_(xtmemory_report) ( const HChar* filename, Bool fini );
 void MC_(print_malloc_stats) ( void );
 /* nr of free operations done */
 SizeT MC_(get_cmalloc_n_frees) ( void );
+/* changes every time the set of heap blocks (or the address or size of
+   one of them) changes */
+ULong MC_(get_chunks_gen) ( void );
 
 void* MC_(malloc)               ( ThreadId tid, SizeT n );
 void* MC_(__builtin_new)        ( ThreadId tid, SizeT n );
@@ -738,6 +741,12 @@ typedef
    operations.  Default: EdcAUTO */
 extern ExpensiveDefinednessChecks MC_(clo_expensive_definedness_checks);
 
+/* Should shadow memory for addresses above the range of the primary
+   map be found with a radix table rather than the auxiliary primary
+   map (--high-shadow=radix)?  Only matters on 64-bit hosts.
+   Default: NO */
+extern Bool MC_(clo_high_shadow_radix);
+
 /* Do we have a range of stack offsets to ignore?  Default: NO */
 extern Bool MC_(clo_ignore_range_below_sp);
 extern UInt MC_(clo_ignore_range_below_sp__first_offset);
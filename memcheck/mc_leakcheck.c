@@ -459,6 +459,13 @@ static MC_Chunk** lc_chunks;
 // How many chunks we're dealing with.
 static Int        lc_n_chunks;
 static SizeT lc_chunks_n_frees_marker;
+// The address range spanned by lc_chunks: every block lies within
+// [lc_chunks_min .. lc_chunks_max).  Used to reject most non-pointers
+// cheaply in lc_is_a_chunk_ptr.  Empty (0 .. 0) if there are no chunks.
+static Addr       lc_chunks_min;
+static Addr       lc_chunks_max;
+// Value of MC_(get_chunks_gen)() when lc_chunks was built.
+static ULong      lc_chunks_gen;
 // This has the same number of entries as lc_chunks, and each entry
 // in lc_chunks corresponds with the entry here (ie. lc_chunks[i] and
 // lc_extras[i] describe the same block).
@@ -530,6 +537,11 @@ lc_is_a_chunk_ptr(Addr ptr, Int* pch_no, MC_Chunk** pch, LC_Extra** pex)
    MC_Chunk* ch;
    LC_Extra* ex;
 
+   // Quickest filter: most scanned words are not pointers at all, and
+   // can be rejected without asking aspacemgr.
+   if (ptr < lc_chunks_min || ptr >= lc_chunks_max)
+      return False;
+
    // Quick filter. Note: implemented with am, not with get_vabits2
    // as ptr might be random data pointing anywhere. On 64 bit
    // platforms, getting va bits for random data can be quite costly
@@ -1994,49 +2006,12 @@ static MC_Mempool *find_mp_of_chunk (MC_Chunk* mc_search)
 /*--- Top-level entry point.                               ---*/
 /*------------------------------------------------------------*/
 
-void MC_(detect_memory_leaks) ( ThreadId tid, LeakCheckParams* lcp)
+// Sort lc_chunks, check that the blocks don't overlap (discarding
+// malloc() blocks that hold a MALLOCLIKE block), and compute
+// lc_chunks_min/lc_chunks_max.
+static void sort_and_check_lc_chunks ( void )
 {
    Int i, j;
-   
-   tl_assert(lcp->mode != LC_Off);
-
-   // Verify some assertions which are used in lc_scan_memory.
-   tl_assert((VKI_PAGE_SIZE % sizeof(Addr)) == 0);
-   tl_assert((SM_SIZE % sizeof(Addr)) == 0);
-   // Above two assertions are critical, while below assertion
-   // ensures that the optimisation in the loop is done in the
-   // correct order : the loop checks for (big) SM chunk skipping
-   // before checking for (smaller) page skipping.
-   tl_assert((SM_SIZE % VKI_PAGE_SIZE) == 0);
-
-   MC_(leak_search_gen)++;
-   MC_(detect_memory_leaks_last_delta_mode) = lcp->deltamode;
-   detect_memory_leaks_last_heuristics = lcp->heuristics;
-
-   // Get the chunks, stop if there were none.
-   if (lc_chunks) {
-      VG_(free)(lc_chunks);
-      lc_chunks = NULL;
-   }
-   lc_chunks = find_active_chunks(&lc_n_chunks);
-   lc_chunks_n_frees_marker = MC_(get_cmalloc_n_frees)();
-   if (lc_n_chunks == 0) {
-      tl_assert(lc_chunks == NULL);
-      if (lr_table != NULL) {
-         // forget the previous recorded LossRecords as next leak search
-         // can in any case just create new leaks.
-         // Maybe it would be better to rather call print_result ?
-         // (at least when leak decreases are requested)
-         // This will then output all LossRecords with a size decreasing to 0
-         VG_(OSetGen_Destroy) (lr_table);
-         lr_table = NULL;
-      }
-      if (VG_(clo_verbosity) >= 1 && !VG_(clo_xml)) {
-         VG_(umsg)("All heap blocks were freed -- no leaks are possible\n");
-         VG_(umsg)("\n");
-      }
-      return;
-   }
 
    // Sort the array so blocks are in ascending order in memory.
    VG_(ssort)(lc_chunks, lc_n_chunks, sizeof(VgHashNode*), compare_MC_Chunks);
@@ -2145,6 +2120,77 @@ void MC_(detect_memory_leaks) ( ThreadId tid, LeakCheckParams* lcp)
       }
    }
 
+   // Compute the range spanned by the chunks.  Zero-sized blocks are
+   // treated as having size 1, as in find_chunk_for.
+   lc_chunks_min = lc_chunks[0]->data;
+   for (i = 0; i < lc_n_chunks; i++) {
+      Addr end = lc_chunks[i]->data + lc_chunks[i]->szB
+                 + (lc_chunks[i]->szB == 0 ? 1 : 0);
+      if (end > lc_chunks_max)
+         lc_chunks_max = end;
+   }
+}
+
+void MC_(detect_memory_leaks) ( ThreadId tid, LeakCheckParams* lcp)
+{
+   Int i;
+   
+   tl_assert(lcp->mode != LC_Off);
+
+   // Verify some assertions which are used in lc_scan_memory.
+   tl_assert((VKI_PAGE_SIZE % sizeof(Addr)) == 0);
+   tl_assert((SM_SIZE % sizeof(Addr)) == 0);
+   // Above two assertions are critical, while below assertion
+   // ensures that the optimisation in the loop is done in the
+   // correct order : the loop checks for (big) SM chunk skipping
+   // before checking for (smaller) page skipping.
+   tl_assert((SM_SIZE % VKI_PAGE_SIZE) == 0);
+
+   MC_(leak_search_gen)++;
+   MC_(detect_memory_leaks_last_delta_mode) = lcp->deltamode;
+   detect_memory_leaks_last_heuristics = lcp->heuristics;
+
+   // If no block has been allocated, freed or changed since the previous
+   // leak search, the sorted and checked lc_chunks built then is still
+   // good.  This makes repeated leak searches (e.g. periodic leak_check
+   // monitor commands) cheaper on big heaps.
+   if (lc_chunks && lc_chunks_gen == MC_(get_chunks_gen)()) {
+      tl_assert(lc_n_chunks > 0);
+      if (VG_(clo_verbosity) > 1 && !VG_(clo_xml))
+         VG_(umsg)("Reusing the block list of the previous leak search\n");
+      goto chunks_ready;
+   }
+
+   // Get the chunks, stop if there were none.
+   if (lc_chunks) {
+      VG_(free)(lc_chunks);
+      lc_chunks = NULL;
+   }
+   lc_chunks = find_active_chunks(&lc_n_chunks);
+   lc_chunks_n_frees_marker = MC_(get_cmalloc_n_frees)();
+   lc_chunks_gen = MC_(get_chunks_gen)();
+   lc_chunks_min = lc_chunks_max = 0;
+   if (lc_n_chunks == 0) {
+      tl_assert(lc_chunks == NULL);
+      if (lr_table != NULL) {
+         // forget the previous recorded LossRecords as next leak search
+         // can in any case just create new leaks.
+         // Maybe it would be better to rather call print_result ?
+         // (at least when leak decreases are requested)
+         // This will then output all LossRecords with a size decreasing to 0
+         VG_(OSetGen_Destroy) (lr_table);
+         lr_table = NULL;
+      }
+      if (VG_(clo_verbosity) >= 1 && !VG_(clo_xml)) {
+         VG_(umsg)("All heap blocks were freed -- no leaks are possible\n");
+         VG_(umsg)("\n");
+      }
+      return;
+   }
+
+   sort_and_check_lc_chunks();
+
+  chunks_ready:
    // Initialise lc_extras.
    if (lc_extras) {
       VG_(free)(lc_extras);
@@ -336,6 +336,8 @@ static ULong n_auxmap_L1_cmps      = 0;
    be handed to auxmap_L2. And the number of nodes inserted. */
 static ULong n_auxmap_L2_searches  = 0;
 static ULong n_auxmap_L2_nodes     = 0;
+/* # of radix_L2 nodes allocated (--high-shadow=radix only). */
+static ULong n_radix_L2_nodes      = 0;
 
 static Int   n_sanity_cheap     = 0;
 static Int   n_sanity_expensive = 0;
@@ -605,6 +607,125 @@ static AuxMapEnt* find_or_alloc_in_auxmap ( Addr a )
    return nyu;
 }
 
+/* --------------- Radix table for high addresses --------------- */
+
+/* With --high-shadow=radix (64-bit hosts only), the secondaries for
+   addresses above MAX_PRIMARY_ADDRESS and below 2^48 are found with a
+   two-level table rather than the auxiliary primary map, so that every
+   such lookup is O(1) no matter how many 64k chunks are in use.
+   radix_L1 is indexed by bits 47:32 of the address and points to
+   radix_L2 nodes, each of which is indexed by bits 31:16 and holds
+   the SecMap pointers for one 4GB region.  radix_L1 (512KB) is
+   allocated at startup and radix_L2 nodes (512KB each) as needed.
+   Addresses at or above 2^48 still go to the auxiliary map.
+
+   radix_L1 is NULL unless --high-shadow=radix is in effect. */
+
+#if VG_WORDSIZE == 8
+
+#define RADIX_L1_BITS 16
+#define RADIX_L2_BITS 16
+#define N_RADIX_L1    (((UWord)1) << RADIX_L1_BITS)
+#define N_RADIX_L2    (((UWord)1) << RADIX_L2_BITS)
+#define MAX_RADIX_ADDRESS \
+   ((Addr)((((Addr)1) << (16 + RADIX_L2_BITS + RADIX_L1_BITS)) - 1))
+
+STATIC_ASSERT(MAX_PRIMARY_ADDRESS < MAX_RADIX_ADDRESS);
+/* A radix_L2 node must not straddle MAX_PRIMARY_ADDRESS. */
+STATIC_ASSERT(((MAX_PRIMARY_ADDRESS + 1) & ((((Addr)1) << 32) - 1)) == 0);
+
+static SecMap*** radix_L1 = NULL;
+
+static void init_radix_L1 ( void )
+{
+   UWord i;
+   tl_assert(radix_L1 == NULL);
+   /* Nothing may have been put into the auxmap yet, else it would
+      be hidden by the radix table. */
+   tl_assert(n_auxmap_L2_nodes == 0);
+   radix_L1 = VG_(am_shadow_alloc)(N_RADIX_L1 * sizeof(SecMap**));
+   if (radix_L1 == NULL)
+      VG_(out_of_memory_NORETURN)( "memcheck:allocate radix_L1",
+                                   N_RADIX_L1 * sizeof(SecMap**) );
+   for (i = 0; i < N_RADIX_L1; i++)
+      radix_L1[i] = NULL;
+}
+
+static SecMap** alloc_radix_L2 ( void )
+{
+   UWord    i;
+   SecMap** node = VG_(am_shadow_alloc)(N_RADIX_L2 * sizeof(SecMap*));
+   if (node == NULL)
+      VG_(out_of_memory_NORETURN)( "memcheck:allocate radix_L2",
+                                   N_RADIX_L2 * sizeof(SecMap*) );
+   for (i = 0; i < N_RADIX_L2; i++)
+      node[i] = &sm_distinguished[SM_DIST_NOACCESS];
+   n_radix_L2_nodes++;
+   return node;
+}
+
+static INLINE Bool is_radix_addr ( Addr a )
+{
+   return radix_L1 != NULL && a <= MAX_RADIX_ADDRESS;
+}
+
+static INLINE SecMap** find_or_alloc_in_radix ( Addr a )
+{
+   SecMap*** l1 = &radix_L1[a >> (16 + RADIX_L2_BITS)];
+   tl_assert(a > MAX_PRIMARY_ADDRESS && a <= MAX_RADIX_ADDRESS);
+   if (UNLIKELY(*l1 == NULL))
+      *l1 = alloc_radix_L2();
+   return &(*l1)[(a >> 16) & (N_RADIX_L2 - 1)];
+}
+
+static SecMap* maybe_find_in_radix ( Addr a )
+{
+   SecMap** l2 = radix_L1[a >> (16 + RADIX_L2_BITS)];
+   tl_assert(a > MAX_PRIMARY_ADDRESS && a <= MAX_RADIX_ADDRESS);
+   return l2 ? l2[(a >> 16) & (N_RADIX_L2 - 1)] : NULL;
+}
+
+/* Check representation invariants; if OK return NULL; else a
+   descriptive bit of text.  Also return the number of
+   non-distinguished secondary maps referred to from the table. */
+static const HChar* check_radix_sanity ( Word* n_secmaps_found )
+{
+   UWord i, j, nodes = 0;
+   *n_secmaps_found = 0;
+   if (radix_L1 == NULL)
+      return n_radix_L2_nodes == 0 ? NULL : "radix_L2 nodes without L1";
+   for (i = 0; i < N_RADIX_L1; i++) {
+      if (radix_L1[i] == NULL)
+         continue;
+      if ((((Addr)i) << (16 + RADIX_L2_BITS)) <= MAX_PRIMARY_ADDRESS)
+         return "radix_L1 entry covers the primary map";
+      nodes++;
+      for (j = 0; j < N_RADIX_L2; j++) {
+         if (radix_L1[i][j] == NULL)
+            return "NULL SecMap in radix_L2";
+         if (!is_distinguished_sm(radix_L1[i][j]))
+            (*n_secmaps_found)++;
+      }
+   }
+   if (nodes != n_radix_L2_nodes)
+      return "disagreement on number of radix_L2 nodes";
+   return NULL; /* ok */
+}
+
+#else /* VG_WORDSIZE == 4 */
+
+/* The primary map covers the whole address space. */
+static INLINE Bool     is_radix_addr ( Addr a )          { return False; }
+static INLINE SecMap** find_or_alloc_in_radix ( Addr a ) { tl_assert(0); }
+static INLINE SecMap*  maybe_find_in_radix ( Addr a )    { tl_assert(0); }
+static const HChar* check_radix_sanity ( Word* n_secmaps_found )
+{
+   *n_secmaps_found = 0;
+   return NULL;
+}
+
+#endif
+
 /* --------------- SecMap fundamentals --------------- */
 
 // In all these, 'low' means it's definitely in the main primary map,
@@ -627,7 +748,10 @@ static INLINE SecMap** get_secmap_low_ptr ( Addr a )
 
 static INLINE SecMap** get_secmap_high_ptr ( Addr a )
 {
-   AuxMapEnt* am = find_or_alloc_in_auxmap(a);
+   AuxMapEnt* am;
+   if (is_radix_addr(a))
+      return find_or_alloc_in_radix(a);
+   am = find_or_alloc_in_auxmap(a);
    return &am->sm;
 }
 
@@ -698,6 +822,8 @@ static SecMap* maybe_get_secmap_for ( Addr a )
 {
    if (a <= MAX_PRIMARY_ADDRESS) {
       return get_secmap_for_reading_low(a);
+   } else if (is_radix_addr(a)) {
+      return maybe_find_in_radix(a);
    } else {
       AuxMapEnt* am = maybe_find_in_auxmap(a);
       return am ? am->sm : NULL;
@@ -2020,29 +2146,56 @@ void MC_(copy_address_range_state) ( Addr src, Addr dst, SizeT len )
 
    if (nooverlap && aligned) {
 
-      /* Vectorised fast case, when no overlap and suitably aligned */
-      /* vector loop */
+      /* Vectorised fast case, when no overlap and suitably aligned.
+         Rather than doing two secondary map lookups per 4 bytes, deal
+         with the range in runs that stay within a single source and a
+         single destination secondary, and copy the vabits8 bytes of
+         each run directly. */
       i = 0;
       while (len >= 4) {
-         vabits8 = get_vabits8_for_aligned_word32( src+i );
-         set_vabits8_for_aligned_word32( dst+i, vabits8 );
-         if (LIKELY(VA_BITS8_DEFINED == vabits8 
-                            || VA_BITS8_UNDEFINED == vabits8 
-                            || VA_BITS8_NOACCESS == vabits8)) {
-            /* do nothing */
-         } else {
-            /* have to copy secondary map info */
-            if (VA_BITS2_PARTDEFINED == get_vabits2( src+i+0 ))
-               set_sec_vbits8( dst+i+0, get_sec_vbits8( src+i+0 ) );
-            if (VA_BITS2_PARTDEFINED == get_vabits2( src+i+1 ))
-               set_sec_vbits8( dst+i+1, get_sec_vbits8( src+i+1 ) );
-            if (VA_BITS2_PARTDEFINED == get_vabits2( src+i+2 ))
-               set_sec_vbits8( dst+i+2, get_sec_vbits8( src+i+2 ) );
-            if (VA_BITS2_PARTDEFINED == get_vabits2( src+i+3 ))
-               set_sec_vbits8( dst+i+3, get_sec_vbits8( src+i+3 ) );
+         SecMap* src_sm;
+         SecMap* dst_sm;
+         UWord   src_off, dst_off, k, n;
+         SizeT   src_left = SM_SIZE - ((src+i) & SM_MASK);
+         SizeT   dst_left = SM_SIZE - ((dst+i) & SM_MASK);
+         n = len;
+         if (n > src_left) n = src_left;
+         if (n > dst_left) n = dst_left;
+         n /= 4;
+         tl_assert(n > 0);
+         src_sm = get_secmap_for_reading( src+i );
+         if (src_sm == get_secmap_for_reading( dst+i )
+             && is_distinguished_sm(src_sm)) {
+            /* Both are the same distinguished map; nothing to do. */
+            i   += 4*n;
+            len -= 4*n;
+            continue;
+         }
+         dst_sm  = get_secmap_for_writing( dst+i );
+         /* Re-fetch, in case the write lookup replaced it. */
+         src_sm  = get_secmap_for_reading( src+i );
+         src_off = SM_OFF(src+i);
+         dst_off = SM_OFF(dst+i);
+         for (k = 0; k < n; k++) {
+            vabits8 = src_sm->vabits8[src_off+k];
+            dst_sm->vabits8[dst_off+k] = vabits8;
+            if (LIKELY(VA_BITS8_DEFINED == vabits8 
+                               || VA_BITS8_UNDEFINED == vabits8 
+                               || VA_BITS8_NOACCESS == vabits8)) {
+               /* do nothing */
+            } else {
+               /* have to copy secondary map info */
+               Addr s4 = src+i+4*k;
+               Addr d4 = dst+i+4*k;
+               for (j = 0; j < 4; j++) {
+                  if (VA_BITS2_PARTDEFINED
+                      == extract_vabits2_from_vabits8( s4+j, vabits8 ))
+                     set_sec_vbits8( d4+j, get_sec_vbits8( s4+j ) );
+               }
+            }
          }
-         i += 4;
-         len -= 4;
+         i   += 4*n;
+         len -= 4*n;
       }
       /* fixup loop */
       while (len >= 1) {
@@ -2158,10 +2311,14 @@ void MC_(copy_address_range_state) ( Addr src, Addr dst, SizeT len )
    Shadowing registers and memory
    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-   Memory is shadowed using a two level cache structure (ocacheL1 and
-   ocacheL2).  Memory references are first directed to ocacheL1.  This
-   is a traditional 2-way set associative cache with 32-byte lines and
-   approximate LRU replacement within each set.
+   Memory is shadowed using a map (ocache_map) organised like the
+   primary map for V bits: it is indexed by the top bits of the
+   address, and each entry points to a leaf holding the origin tags for
+   one 64KB chunk of address space, in 32-byte lines.  Leaves are only
+   allocated when an origin is first stored in their chunk; a NULL
+   entry means that every byte in the chunk has no origin.  The rare
+   addresses above the range covered by ocache_map have their leaves
+   kept in an OSet (ocache_high).
 
    A naive implementation would require storing one 32 bit otag for
    each byte of memory covered, a 4:1 space overhead.  Instead, there
@@ -2173,16 +2330,11 @@ void MC_(copy_address_range_state) ( Addr src, Addr dst, SizeT len )
    imprecision, but how much of a problem it really is remains to be
    seen.
 
-   A cache line that contains all zeroes ("no origins") contains no
-   useful information, and can be ejected from the L1 cache "for
-   free", in the sense that a read miss on the L1 causes a line of
-   zeroes to be installed.  However, ejecting a line containing
-   nonzeroes risks losing origin information permanently.  In order to
-   prevent such lossage, ejected nonzero lines are placed in a
-   secondary cache (ocacheL2), which is an OSet (AVL tree) of cache
-   lines.  This can grow arbitrarily large, and so should ensure that
-   Memcheck runs out of memory in preference to losing useful origin
-   info due to cache size limitations.
+   Origin tags are never lost to capacity limits: Memcheck runs out of
+   memory rather than forgetting useful origin info.  (Earlier versions
+   used a fixed-size set associative cache backed by an OSet of
+   ejected lines; that was slow once the working set outgrew the
+   cache.)
 
    Shadowing registers is a bit tricky, because the shadow values are
    32 bits, regardless of the size of the register.  That gives a
@@ -2360,9 +2512,9 @@ void MC_(copy_address_range_state) ( Addr src, Addr dst, SizeT len )
      information.  Interestingly, a line containing all zeroes can be
      evicted "free" from the cache, since it contains no useful
      information, so there is scope perhaps for some cleverer cache
-     management schemes.  (*** NOTE, with the introduction of the
-     second level origin tag cache, ocacheL2, this is no longer a
-     problem. ***)
+     management schemes.  (*** NOTE, now that origin tags are kept
+     in a map covering all of memory rather than a cache, this is no
+     longer a problem. ***)
 
    * The origin cache only stores one otag per 32-bits of address
      space, plus 4 bits indicating which of the 4 bytes has that tag
@@ -2397,18 +2549,13 @@ void MC_(copy_address_range_state) ( Addr src, Addr dst, SizeT len )
    practice.
 */
 
-static UWord stats_ocacheL1_find           = 0;
-static UWord stats_ocacheL1_found_at_1     = 0;
-static UWord stats_ocacheL1_found_at_N     = 0;
-static UWord stats_ocacheL1_misses         = 0;
-static UWord stats_ocacheL1_lossage        = 0;
-static UWord stats_ocacheL1_movefwds       = 0;
+static UWord stats_ocache_finds            = 0;
+static UWord stats_ocache_finds_empty      = 0;
+static UWord stats_ocache_finds_high       = 0;
+static UWord stats_ocache_n_leaves         = 0;
+static UWord stats_ocache_n_leaves_high    = 0;
 
-static UWord stats__ocacheL2_refs          = 0;
-static UWord stats__ocacheL2_misses        = 0;
-static UWord stats__ocacheL2_n_nodes_max   = 0;
-
-/* Cache of 32-bit values, one every 32 bits of address space */
+/* Origin tags, one every 32 bits of address space */
 
 #define OC_BITS_PER_LINE 5
 #define OC_W32S_PER_LINE (1 << (OC_BITS_PER_LINE - 2))
@@ -2416,276 +2563,168 @@ static UWord stats__ocacheL2_n_nodes_max   = 0;
 static INLINE UWord oc_line_offset ( Addr a ) {
    return (a >> 2) & (OC_W32S_PER_LINE - 1);
 }
-static INLINE Bool is_valid_oc_tag ( Addr tag ) {
-   return 0 == (tag & ((1 << OC_BITS_PER_LINE) - 1));
-}
-
-#define OC_LINES_PER_SET 2
-
-#define OC_N_SET_BITS    20
-#define OC_N_SETS        (1 << OC_N_SET_BITS)
-
-/* These settings give:
-   64 bit host: ocache:  100,663,296 sizeB    67,108,864 useful
-   32 bit host: ocache:   92,274,688 sizeB    67,108,864 useful
-*/
-
-#define OC_MOVE_FORWARDS_EVERY_BITS 7
-
 
 typedef
    struct {
-      Addr  tag;
       UInt  w32[OC_W32S_PER_LINE];
       UChar descr[OC_W32S_PER_LINE];
    }
    OCacheLine;
 
-/* Classify and also sanity-check 'line'.  Return 'e' (empty) if not
-   in use, 'n' (nonzero) if it contains at least one valid origin tag,
-   and 'z' if all the represented tags are zero. */
-static UChar classify_OCacheLine ( OCacheLine* line )
-{
-   UWord i;
-   if (line->tag == 1/*invalid*/)
-      return 'e'; /* EMPTY */
-   tl_assert(is_valid_oc_tag(line->tag));
-   for (i = 0; i < OC_W32S_PER_LINE; i++) {
-      tl_assert(0 == ((~0xF) & line->descr[i]));
-      if (line->w32[i] > 0 && line->descr[i] > 0)
-         return 'n'; /* NONZERO - contains useful info */
-   }
-   return 'z'; /* ZERO - no useful info */
-}
+/* A leaf holds the lines for one 64KB aligned chunk of address space,
+   as a SecMap does for the V bits.  That is 80KB of origin tags for
+   each 64KB chunk in which an origin has ever been stored. */
+
+#define OC_BITS_PER_LEAF  16
+#define OC_LINES_PER_LEAF (1 << (OC_BITS_PER_LEAF - OC_BITS_PER_LINE))
 
 typedef
    struct {
-      OCacheLine line[OC_LINES_PER_SET];
+      OCacheLine line[OC_LINES_PER_LEAF];
    }
-   OCacheSet;
+   OCacheLeaf;
+
+/* ocache_map[a >> 16] is the leaf for a, or NULL if no origin has ever
+   been stored in a's chunk.  It covers the same addresses as
+   primary_map.  It is allocated as fresh (hence zeroed) shadow memory,
+   so the parts of it covering unused address space never get paged
+   in. */
+
+#define N_OCACHE_MAP N_PRIMARY_MAP
+
+static OCacheLeaf** ocache_map = NULL;
+
+/* Leaves for addresses above MAX_PRIMARY_ADDRESS live in an OSet, the
+   same way auxmap_L2 holds their SecMaps.  These are rare enough that
+   remembering the most recently used one is all the caching they
+   get. */
 
 typedef
    struct {
-      OCacheSet set[OC_N_SETS];
+      Addr        base;
+      OCacheLeaf* leaf;
    }
-   OCache;
+   OCacheHighNode;
+
+static OSet*       ocache_high           = NULL;
+static Addr        ocache_high_last_base = 1; /* invalid */
+static OCacheLeaf* ocache_high_last_leaf = NULL;
 
-static OCache* ocacheL1 = NULL;
-static UWord   ocacheL1_event_ctr = 0;
+/* What loads see where no leaf exists.  Never written. */
+static OCacheLine  oc_zero_line;
 
-static void init_ocacheL2 ( void ); /* fwds */
 static void init_OCache ( void )
 {
-   UWord line, set;
    tl_assert(MC_(clo_mc_level) >= 3);
-   tl_assert(ocacheL1 == NULL);
-   ocacheL1 = VG_(am_shadow_alloc)(sizeof(OCache));
-   if (ocacheL1 == NULL) {
-      VG_(out_of_memory_NORETURN)( "memcheck:allocating ocacheL1", 
-                                   sizeof(OCache) );
-   }
-   tl_assert(ocacheL1 != NULL);
-   for (set = 0; set < OC_N_SETS; set++) {
-      for (line = 0; line < OC_LINES_PER_SET; line++) {
-         ocacheL1->set[set].line[line].tag = 1/*invalid*/;
-      }
-   }
-   init_ocacheL2();
+   tl_assert(ocache_map == NULL);
+   tl_assert(ocache_high == NULL);
+   tl_assert(sizeof(OCacheLine) == 5 * OC_W32S_PER_LINE);
+   ocache_map = VG_(am_shadow_alloc)(N_OCACHE_MAP * sizeof(OCacheLeaf*));
+   if (ocache_map == NULL) {
+      VG_(out_of_memory_NORETURN)( "memcheck:allocating ocache_map",
+                                   N_OCACHE_MAP * sizeof(OCacheLeaf*) );
+   }
+   ocache_high
+      = VG_(OSetGen_Create)( offsetof(OCacheHighNode,base),
+                             NULL, /* fast cmp */
+                             VG_(malloc), "mc.ioH", VG_(free) );
 }
 
-static void moveLineForwards ( OCacheSet* set, UWord lineno )
+static OCacheLeaf* alloc_OCacheLeaf ( void )
 {
-   OCacheLine tmp;
-   stats_ocacheL1_movefwds++;
-   tl_assert(lineno > 0 && lineno < OC_LINES_PER_SET);
-   tmp = set->line[lineno-1];
-   set->line[lineno-1] = set->line[lineno];
-   set->line[lineno] = tmp;
+   OCacheLeaf* leaf = VG_(am_shadow_alloc)(sizeof(OCacheLeaf));
+   if (leaf == NULL)
+      VG_(out_of_memory_NORETURN)( "memcheck:allocating OCacheLeaf",
+                                   sizeof(OCacheLeaf) );
+   return leaf;
 }
 
-static void zeroise_OCacheLine ( OCacheLine* line, Addr tag ) {
-   UWord i;
-   for (i = 0; i < OC_W32S_PER_LINE; i++) {
-      line->w32[i] = 0; /* NO ORIGIN */
-      line->descr[i] = 0; /* REALLY REALLY NO ORIGIN! */
-   }
-   line->tag = tag;
-}
-
-//////////////////////////////////////////////////////////////
-//// OCache backing store
+/* Find the leaf for a > MAX_PRIMARY_ADDRESS.  If there is none, return
+   NULL, or make one if 'alloc' is True. */
+__attribute__((noinline))
+static OCacheLeaf* find_high_OCacheLeaf ( Addr a, Bool alloc )
+{
+   OCacheHighNode* node;
+   Addr base = a & ~(Addr)((1 << OC_BITS_PER_LEAF) - 1);
 
-static OSet* ocacheL2 = NULL;
+   stats_ocache_finds_high++;
+   if (base == ocache_high_last_base)
+      return ocache_high_last_leaf;
 
-static void* ocacheL2_malloc ( const HChar* cc, SizeT szB ) {
-   return VG_(malloc)(cc, szB);
-}
-static void ocacheL2_free ( void* v ) {
-   VG_(free)( v );
+   node = VG_(OSetGen_Lookup)( ocache_high, &base );
+   if (node == NULL) {
+      if (!alloc)
+         return NULL;
+      node = VG_(OSetGen_AllocNode)( ocache_high, sizeof(OCacheHighNode) );
+      node->base = base;
+      node->leaf = alloc_OCacheLeaf();
+      VG_(OSetGen_Insert)( ocache_high, node );
+      stats_ocache_n_leaves_high++;
+   }
+   ocache_high_last_base = base;
+   ocache_high_last_leaf = node->leaf;
+   return node->leaf;
 }
 
-/* Stats: # nodes currently in tree */
-static UWord stats__ocacheL2_n_nodes = 0;
-
-static void init_ocacheL2 ( void )
+__attribute__((noinline))
+static OCacheLeaf* alloc_OCacheLeaf_for ( Addr a )
 {
-   tl_assert(!ocacheL2);
-   tl_assert(sizeof(Word) == sizeof(Addr)); /* since OCacheLine.tag :: Addr */
-   tl_assert(0 == offsetof(OCacheLine,tag));
-   ocacheL2 
-      = VG_(OSetGen_Create)( offsetof(OCacheLine,tag), 
-                             NULL, /* fast cmp */
-                             ocacheL2_malloc, "mc.ioL2", ocacheL2_free);
-   stats__ocacheL2_n_nodes = 0;
+   if (a > MAX_PRIMARY_ADDRESS)
+      return find_high_OCacheLeaf( a, True );
+   tl_assert(ocache_map[a >> OC_BITS_PER_LEAF] == NULL);
+   ocache_map[a >> OC_BITS_PER_LEAF] = alloc_OCacheLeaf();
+   stats_ocache_n_leaves++;
+   return ocache_map[a >> OC_BITS_PER_LEAF];
 }
 
-/* Find line with the given tag in the tree, or NULL if not found. */
-static OCacheLine* ocacheL2_find_tag ( Addr tag )
+static INLINE OCacheLeaf* maybe_find_OCacheLeaf ( Addr a )
 {
-   OCacheLine* line;
-   tl_assert(is_valid_oc_tag(tag));
-   stats__ocacheL2_refs++;
-   line = VG_(OSetGen_Lookup)( ocacheL2, &tag );
-   return line;
+   stats_ocache_finds++;
+   if (LIKELY(a <= MAX_PRIMARY_ADDRESS))
+      return ocache_map[a >> OC_BITS_PER_LEAF];
+   return find_high_OCacheLeaf( a, False );
 }
 
-/* Delete the line with the given tag from the tree, if it is present, and
-   free up the associated memory. */
-static void ocacheL2_del_tag ( Addr tag )
+static INLINE OCacheLine* line_in_OCacheLeaf ( OCacheLeaf* leaf, Addr a )
 {
-   OCacheLine* line;
-   tl_assert(is_valid_oc_tag(tag));
-   stats__ocacheL2_refs++;
-   line = VG_(OSetGen_Remove)( ocacheL2, &tag );
-   if (line) {
-      VG_(OSetGen_FreeNode)(ocacheL2, line);
-      tl_assert(stats__ocacheL2_n_nodes > 0);
-      stats__ocacheL2_n_nodes--;
-   }
+   return &leaf->line[(a >> OC_BITS_PER_LINE) & (OC_LINES_PER_LEAF - 1)];
 }
 
-/* Add a copy of the given line to the tree.  It must not already be
-   present. */
-static void ocacheL2_add_line ( OCacheLine* line )
+/* The line for a, for reading origins.  Never NULL. */
+static INLINE OCacheLine* find_OCacheLine_for_reading ( Addr a )
 {
-   OCacheLine* copy;
-   tl_assert(is_valid_oc_tag(line->tag));
-   copy = VG_(OSetGen_AllocNode)( ocacheL2, sizeof(OCacheLine) );
-   *copy = *line;
-   stats__ocacheL2_refs++;
-   VG_(OSetGen_Insert)( ocacheL2, copy );
-   stats__ocacheL2_n_nodes++;
-   if (stats__ocacheL2_n_nodes > stats__ocacheL2_n_nodes_max)
-      stats__ocacheL2_n_nodes_max = stats__ocacheL2_n_nodes;
-}
-
-////
-//////////////////////////////////////////////////////////////
-
-__attribute__((noinline))
-static OCacheLine* find_OCacheLine_SLOW ( Addr a )
-{
-   OCacheLine *victim, *inL2;
-   UChar c;
-   UWord line;
-   UWord setno   = (a >> OC_BITS_PER_LINE) & (OC_N_SETS - 1);
-   UWord tagmask = ~((1 << OC_BITS_PER_LINE) - 1);
-   UWord tag     = a & tagmask;
-   tl_assert(setno >= 0 && setno < OC_N_SETS);
-
-   /* we already tried line == 0; skip therefore. */
-   for (line = 1; line < OC_LINES_PER_SET; line++) {
-      if (ocacheL1->set[setno].line[line].tag == tag) {
-         if (line == 1) {
-            stats_ocacheL1_found_at_1++;
-         } else {
-            stats_ocacheL1_found_at_N++;
-         }
-         if (UNLIKELY(0 == (ocacheL1_event_ctr++ 
-                            & ((1<<OC_MOVE_FORWARDS_EVERY_BITS)-1)))) {
-            moveLineForwards( &ocacheL1->set[setno], line );
-            line--;
-         }
-         return &ocacheL1->set[setno].line[line];
-      }
+   OCacheLeaf* leaf = maybe_find_OCacheLeaf( a );
+   if (UNLIKELY(leaf == NULL)) {
+      stats_ocache_finds_empty++;
+      return &oc_zero_line;
    }
-
-   /* A miss.  Use the last slot.  Implicitly this means we're
-      ejecting the line in the last slot. */
-   stats_ocacheL1_misses++;
-   tl_assert(line == OC_LINES_PER_SET);
-   line--;
-   tl_assert(line > 0);
-
-   /* First, move the to-be-ejected line to the L2 cache. */
-   victim = &ocacheL1->set[setno].line[line];
-   c = classify_OCacheLine(victim);
-   switch (c) {
-      case 'e':
-         /* the line is empty (has invalid tag); ignore it. */
-         break;
-      case 'z':
-         /* line contains zeroes.  We must ensure the backing store is
-            updated accordingly, either by copying the line there
-            verbatim, or by ensuring it isn't present there.  We
-            chosse the latter on the basis that it reduces the size of
-            the backing store. */
-         ocacheL2_del_tag( victim->tag );
-         break;
-      case 'n':
-         /* line contains at least one real, useful origin.  Copy it
-            to the backing store. */
-         stats_ocacheL1_lossage++;
-         inL2 = ocacheL2_find_tag( victim->tag );
-         if (inL2) {
-            *inL2 = *victim;
-         } else {
-            ocacheL2_add_line( victim );
-         }
-         break;
-      default:
-         tl_assert(0);
-   }
-
-   /* Now we must reload the L1 cache from the backing tree, if
-      possible. */
-   tl_assert(tag != victim->tag); /* stay sane */
-   inL2 = ocacheL2_find_tag( tag );
-   if (inL2) {
-      /* We're in luck.  It's in the L2. */
-      ocacheL1->set[setno].line[line] = *inL2;
-   } else {
-      /* Missed at both levels of the cache hierarchy.  We have to
-         declare it as full of zeroes (unknown origins). */
-      stats__ocacheL2_misses++;
-      zeroise_OCacheLine( &ocacheL1->set[setno].line[line], tag );
-   }
-
-   /* Move it one forwards */
-   moveLineForwards( &ocacheL1->set[setno], line );
-   line--;
-
-   return &ocacheL1->set[setno].line[line];
+   return line_in_OCacheLeaf( leaf, a );
 }
 
-static INLINE OCacheLine* find_OCacheLine ( Addr a )
+/* The line for a, for clearing origins.  NULL if there are no origins
+   around a to clear. */
+static INLINE OCacheLine* maybe_find_OCacheLine ( Addr a )
 {
-   UWord setno   = (a >> OC_BITS_PER_LINE) & (OC_N_SETS - 1);
-   UWord tagmask = ~((1 << OC_BITS_PER_LINE) - 1);
-   UWord tag     = a & tagmask;
-
-   stats_ocacheL1_find++;
-
-   if (OC_ENABLE_ASSERTIONS) {
-      tl_assert(setno >= 0 && setno < OC_N_SETS);
-      tl_assert(0 == (tag & (4 * OC_W32S_PER_LINE - 1)));
+   OCacheLeaf* leaf = maybe_find_OCacheLeaf( a );
+   if (UNLIKELY(leaf == NULL)) {
+      stats_ocache_finds_empty++;
+      return NULL;
    }
+   return line_in_OCacheLeaf( leaf, a );
+}
 
-   if (LIKELY(ocacheL1->set[setno].line[0].tag == tag)) {
-      return &ocacheL1->set[setno].line[0];
-   }
+/* The leaf for a, for storing origins; makes one if needed. */
+static INLINE OCacheLeaf* find_OCacheLeaf_for_writing ( Addr a )
+{
+   OCacheLeaf* leaf = maybe_find_OCacheLeaf( a );
+   if (UNLIKELY(leaf == NULL))
+      leaf = alloc_OCacheLeaf_for( a );
+   return leaf;
+}
 
-   return find_OCacheLine_SLOW( a );
+static INLINE OCacheLine* find_OCacheLine_for_writing ( Addr a )
+{
+   return line_in_OCacheLeaf( find_OCacheLeaf_for_writing( a ), a );
 }
 
 static INLINE void set_aligned_word64_Origin_to_undef ( Addr a, UInt otag )
@@ -2698,7 +2737,7 @@ static INLINE void set_aligned_word64_Origin_to_undef ( Addr a, UInt otag )
         tl_assert(lineoff >= 0 
                   && lineoff < OC_W32S_PER_LINE -1/*'cos 8-aligned*/);
      }
-     line = find_OCacheLine( a );
+     line = find_OCacheLine_for_writing( a );
      line->descr[lineoff+0] = 0xF;
      line->descr[lineoff+1] = 0xF;
      line->w32[lineoff+0]   = otag;
@@ -2752,7 +2791,7 @@ void make_aligned_word32_undefined_w_otag ( Addr a, UInt otag )
      if (OC_ENABLE_ASSERTIONS) {
         tl_assert(lineoff >= 0 && lineoff < OC_W32S_PER_LINE);
      }
-     line = find_OCacheLine( a );
+     line = find_OCacheLine_for_writing( a );
      line->descr[lineoff] = 0xF;
      line->w32[lineoff]   = otag;
    }
@@ -2789,8 +2828,9 @@ void make_aligned_word32_noaccess ( Addr a )
          if (OC_ENABLE_ASSERTIONS) {
             tl_assert(lineoff >= 0 && lineoff < OC_W32S_PER_LINE);
          }
-         line = find_OCacheLine( a );
-         line->descr[lineoff] = 0;
+         line = maybe_find_OCacheLine( a );
+         if (line)
+            line->descr[lineoff] = 0;
       }
       //// END inlined, specialised version of MC_(helperc_b_store4)
    }
@@ -2835,7 +2875,7 @@ void make_aligned_word64_undefined_w_otag ( Addr a, UInt otag )
      UWord lineoff = oc_line_offset(a);
      tl_assert(lineoff >= 0 
                && lineoff < OC_W32S_PER_LINE -1/*'cos 8-aligned*/);
-     line = find_OCacheLine( a );
+     line = find_OCacheLine_for_writing( a );
      line->descr[lineoff+0] = 0xF;
      line->descr[lineoff+1] = 0xF;
      line->w32[lineoff+0]   = otag;
@@ -2873,9 +2913,11 @@ void make_aligned_word64_noaccess ( Addr a )
          UWord lineoff = oc_line_offset(a);
          tl_assert(lineoff >= 0 
                    && lineoff < OC_W32S_PER_LINE -1/*'cos 8-aligned*/);
-         line = find_OCacheLine( a );
-         line->descr[lineoff+0] = 0;
-         line->descr[lineoff+1] = 0;
+         line = maybe_find_OCacheLine( a );
+         if (line) {
+            line->descr[lineoff+0] = 0;
+            line->descr[lineoff+1] = 0;
+         }
       }
       //// END inlined, specialised version of MC_(helperc_b_store8)
    }
@@ -4120,6 +4162,64 @@ typedef
    exist, *bad_addr is set to the offending address, so the caller can
    know what it is. */
 
+/* Returns the length of an initial segment of [a .. a+len) in which
+   every byte is defined (if want_defined) or at least addressable (if
+   not).  This is the fast path for the range checks below, which are
+   mostly applied to large buffers (syscall arguments, client requests)
+   that are entirely fine.  Whole distinguished secondaries are skipped
+   in one step, and other secondaries are examined one UWord of vabits8
+   -- that is, 4 * sizeof(UWord) bytes of client memory -- at a time.
+   The result is not necessarily the longest such segment: callers must
+   examine the remainder byte by byte, so that error addresses are
+   reported exactly as before. */
+static SizeT mem_ok_prefix_len ( Addr a, SizeT len, Bool want_defined )
+{
+   const UWord chunk   = 4 * sizeof(UWord);
+   const UWord ones    = ~(UWord)0 / 0xFF;   /* 0x0101..01 */
+   const UWord all_def = ones * VA_BITS8_DEFINED;
+   const UWord lo_bits = ones * VA_BITS8_UNDEFINED;
+   SizeT done = 0;
+
+   /* Leading bytes, up to a vabits8-word boundary. */
+   while (done < len && ((a + done) & (chunk-1)) != 0) {
+      UWord vabits2 = get_vabits2(a + done);
+      if (want_defined ? vabits2 != VA_BITS2_DEFINED
+                       : vabits2 == VA_BITS2_NOACCESS)
+         return done;
+      done++;
+   }
+
+   /* Whole words of vabits8, one secondary at a time. */
+   while (len - done >= chunk) {
+      Addr    cur = a + done;
+      SecMap* sm  = get_secmap_for_reading(cur);
+      SizeT   n   = SM_SIZE - (cur & SM_MASK);
+      UWord*  w;
+      SizeT   k;
+      if (n > len - done)
+         n = len - done;
+      n = VG_ROUNDDN(n, chunk);
+
+      if (sm == &sm_distinguished[SM_DIST_DEFINED]
+          || (!want_defined && sm == &sm_distinguished[SM_DIST_UNDEFINED])) {
+         done += n;
+         continue;
+      }
+      if (is_distinguished_sm(sm))
+         return done;
+
+      w = (UWord*)&sm->vabits8[SM_OFF(cur)];
+      for (k = 0; k < n / chunk; k++) {
+         /* For addressability, every 2-bit field must be nonzero. */
+         if (want_defined ? w[k] != all_def
+                          : ((w[k] | (w[k] >> 1)) & lo_bits) != lo_bits)
+            return done + k * chunk;
+      }
+      done += n;
+   }
+   return done;
+}
+
 /* Returns True if [a .. a+len) is not addressible.  Otherwise,
    returns False, and if bad_addr is non-NULL, sets *bad_addr to
    indicate the lowest failing address.  Functions below are
@@ -4149,7 +4249,9 @@ static Bool is_mem_addressable ( Addr a, SizeT len,
    UWord vabits2;
 
    PROF_EVENT(MCPE_IS_MEM_ADDRESSABLE);
-   for (i = 0; i < len; i++) {
+   i = mem_ok_prefix_len(a, len, False/*!want_defined*/);
+   a += i;
+   for (; i < len; i++) {
       PROF_EVENT(MCPE_IS_MEM_ADDRESSABLE_LOOP);
       vabits2 = get_vabits2(a);
       if (VA_BITS2_NOACCESS == vabits2) {
@@ -4173,7 +4275,9 @@ static MC_ReadResult is_mem_defined ( Addr a, SizeT len,
 
    if (otag)     *otag = 0;
    if (bad_addr) *bad_addr = 0;
-   for (i = 0; i < len; i++) {
+   i = mem_ok_prefix_len(a, len, True/*want_defined*/);
+   a += i;
+   for (; i < len; i++) {
       PROF_EVENT(MCPE_IS_MEM_DEFINED_LOOP);
       vabits2 = get_vabits2(a);
       if (VA_BITS2_DEFINED != vabits2) {
@@ -4226,7 +4330,9 @@ static void is_mem_defined_comprehensive (
 
    tl_assert(!(*errorV || *errorA));
 
-   for (i = 0; i < len; i++) {
+   i = mem_ok_prefix_len(a, len, True/*want_defined*/);
+   a += i;
+   for (; i < len; i++) {
       PROF_EVENT(MCPE_IS_MEM_DEFINED_COMPREHENSIVE_LOOP);
       vabits2 = get_vabits2(a);
       switch (vabits2) {
@@ -5893,9 +5999,21 @@ static Bool mc_expensive_sanity_check ( void )
       return False;
    }
 
+   /* Likewise the radix table, if in use. */
+   {
+      Word n_radix_secmaps = 0;
+      errmsg = check_radix_sanity( &n_radix_secmaps );
+      if (errmsg) {
+         VG_(printf)("memcheck expensive sanity, radix table:\n\t%s",
+                     errmsg);
+         return False;
+      }
+      n_secmaps_found += n_radix_secmaps;
+   }
+
    /* n_secmaps_found is now the number referred to by the auxiliary
-      primary map.  Now add on the ones referred to by the main
-      primary map. */
+      primary map and the radix table.  Now add on the ones referred
+      to by the main primary map. */
    for (i = 0; i < N_PRIMARY_MAP; i++) {
       if (primary_map[i] == NULL) {
          bad = True;
@@ -5953,6 +6071,7 @@ Int           MC_(clo_free_fill)              = -1;
 KeepStacktraces MC_(clo_keep_stacktraces)     = KS_alloc_and_free;
 Int           MC_(clo_mc_level)               = 2;
 Bool          MC_(clo_show_mismatched_frees)  = True;
+Bool          MC_(clo_high_shadow_radix)      = False;
 
 ExpensiveDefinednessChecks
               MC_(clo_expensive_definedness_checks) = EdcAUTO;
@@ -6149,6 +6268,11 @@ static Bool mc_process_cmd_line_options(const HChar* arg)
    else if VG_BOOL_CLO(arg, "--show-mismatched-frees",
                        MC_(clo_show_mismatched_frees)) {}
 
+   else if VG_XACT_CLO(arg, "--high-shadow=auxmap",
+                            MC_(clo_high_shadow_radix), False) {}
+   else if VG_XACT_CLO(arg, "--high-shadow=radix",
+                            MC_(clo_high_shadow_radix), True) {}
+
    else if VG_XACT_CLO(arg, "--expensive-definedness-checks=no",
                             MC_(clo_expensive_definedness_checks), EdcNO) {}
    else if VG_XACT_CLO(arg, "--expensive-definedness-checks=auto",
@@ -6211,6 +6335,8 @@ static void mc_print_usage(void)
 "    --keep-stacktraces=alloc|free|alloc-and-free|alloc-then-free|none\n"
 "        stack trace(s) to keep for malloc'd/free'd areas       [alloc-and-free]\n"
 "    --show-mismatched-frees=no|yes   show frees that don't match the allocator? [yes]\n"
+"    --high-shadow=auxmap|radix       how to find the shadow memory of addresses\n"
+"                                     above 128GB (64-bit only) [auxmap]\n"
    );
 }
 
@@ -7401,7 +7527,7 @@ UWord VG_REGPARM(1) MC_(helperc_b_load1)( Addr a ) {
       tl_assert(lineoff >= 0 && lineoff < OC_W32S_PER_LINE);
    }
 
-   line = find_OCacheLine( a );
+   line = find_OCacheLine_for_reading( a );
 
    descr = line->descr[lineoff];
    if (OC_ENABLE_ASSERTIONS) {
@@ -7433,7 +7559,7 @@ UWord VG_REGPARM(1) MC_(helperc_b_load2)( Addr a ) {
    if (OC_ENABLE_ASSERTIONS) {
       tl_assert(lineoff >= 0 && lineoff < OC_W32S_PER_LINE);
    }
-   line = find_OCacheLine( a );
+   line = find_OCacheLine_for_reading( a );
 
    descr = line->descr[lineoff];
    if (OC_ENABLE_ASSERTIONS) {
@@ -7464,7 +7590,7 @@ UWord VG_REGPARM(1) MC_(helperc_b_load4)( Addr a ) {
       tl_assert(lineoff >= 0 && lineoff < OC_W32S_PER_LINE);
    }
 
-   line = find_OCacheLine( a );
+   line = find_OCacheLine_for_reading( a );
 
    descr = line->descr[lineoff];
    if (OC_ENABLE_ASSERTIONS) {
@@ -7495,7 +7621,7 @@ UWord VG_REGPARM(1) MC_(helperc_b_load8)( Addr a ) {
       tl_assert(lineoff == (lineoff & 6)); /*0,2,4,6*//*since 8-aligned*/
    }
 
-   line = find_OCacheLine( a );
+   line = find_OCacheLine_for_reading( a );
 
    descrLo = line->descr[lineoff + 0];
    descrHi = line->descr[lineoff + 1];
@@ -7544,11 +7670,12 @@ void VG_REGPARM(2) MC_(helperc_b_store1)( Addr a, UWord d32 ) {
       tl_assert(lineoff >= 0 && lineoff < OC_W32S_PER_LINE);
    }
 
-   line = find_OCacheLine( a );
-
    if (d32 == 0) {
-      line->descr[lineoff] &= ~(1 << byteoff);
+      line = maybe_find_OCacheLine( a );
+      if (line)
+         line->descr[lineoff] &= ~(1 << byteoff);
    } else {
+      line = find_OCacheLine_for_writing( a );
       line->descr[lineoff] |= (1 << byteoff);
       line->w32[lineoff] = d32;
    }
@@ -7572,11 +7699,12 @@ void VG_REGPARM(2) MC_(helperc_b_store2)( Addr a, UWord d32 ) {
       tl_assert(lineoff >= 0 && lineoff < OC_W32S_PER_LINE);
    }
 
-   line = find_OCacheLine( a );
-
    if (d32 == 0) {
-      line->descr[lineoff] &= ~(3 << byteoff);
+      line = maybe_find_OCacheLine( a );
+      if (line)
+         line->descr[lineoff] &= ~(3 << byteoff);
    } else {
+      line = find_OCacheLine_for_writing( a );
       line->descr[lineoff] |= (3 << byteoff);
       line->w32[lineoff] = d32;
    }
@@ -7598,11 +7726,12 @@ void VG_REGPARM(2) MC_(helperc_b_store4)( Addr a, UWord d32 ) {
       tl_assert(lineoff >= 0 && lineoff < OC_W32S_PER_LINE);
    }
 
-   line = find_OCacheLine( a );
-
    if (d32 == 0) {
-      line->descr[lineoff] = 0;
+      line = maybe_find_OCacheLine( a );
+      if (line)
+         line->descr[lineoff] = 0;
    } else {
+      line = find_OCacheLine_for_writing( a );
       line->descr[lineoff] = 0xF;
       line->w32[lineoff] = d32;
    }
@@ -7624,12 +7753,14 @@ void VG_REGPARM(2) MC_(helperc_b_store8)( Addr a, UWord d32 ) {
       tl_assert(lineoff == (lineoff & 6)); /*0,2,4,6*//*since 8-aligned*/
    }
 
-   line = find_OCacheLine( a );
-
    if (d32 == 0) {
-      line->descr[lineoff + 0] = 0;
-      line->descr[lineoff + 1] = 0;
+      line = maybe_find_OCacheLine( a );
+      if (line) {
+         line->descr[lineoff + 0] = 0;
+         line->descr[lineoff + 1] = 0;
+      }
    } else {
+      line = find_OCacheLine_for_writing( a );
       line->descr[lineoff + 0] = 0xF;
       line->descr[lineoff + 1] = 0xF;
       line->w32[lineoff + 0] = d32;
@@ -7654,6 +7785,40 @@ void VG_REGPARM(2) MC_(helperc_b_store32)( Addr a, UWord d32 ) {
 /*--- Origin tracking: sarp handlers       ---*/
 /*--------------------------------------------*/
 
+/* Set (otag != 0) or clear (otag == 0) the origins of the n 4-aligned
+   words starting at a, doing each leaf's part in one go. */
+static void ocache_sarp_words ( Addr a, UWord n, UInt otag )
+{
+   while (n > 0) {
+      OCacheLeaf* leaf;
+      UWord       i, nHere;
+
+      nHere = ((1 << OC_BITS_PER_LEAF) 
+               - (a & ((1 << OC_BITS_PER_LEAF) - 1))) / 4;
+      if (nHere > n)
+         nHere = n;
+      n -= nHere;
+
+      leaf = otag == 0 ? maybe_find_OCacheLeaf( a )
+                       : find_OCacheLeaf_for_writing( a );
+      if (leaf == NULL) {
+         /* Nothing to clear here. */
+         a += 4 * nHere;
+         continue;
+      }
+      for (i = 0; i < nHere; i++, a += 4) {
+         OCacheLine* line    = line_in_OCacheLeaf( leaf, a );
+         UWord       lineoff = oc_line_offset(a);
+         if (otag == 0) {
+            line->descr[lineoff] = 0;
+         } else {
+            line->descr[lineoff] = 0xF;
+            line->w32[lineoff]   = otag;
+         }
+      }
+   }
+}
+
 __attribute__((noinline))
 static void ocache_sarp_Set_Origins ( Addr a, UWord len, UInt otag ) {
    if ((a & 1) && len >= 1) {
@@ -7666,12 +7831,11 @@ static void ocache_sarp_Set_Origins ( Addr a, UWord len, UInt otag ) {
       a += 2;
       len -= 2;
    }
-   if (len >= 4) 
+   if (len >= 4) {
       tl_assert(0 == (a & 3));
-   while (len >= 4) {
-      MC_(helperc_b_store4)( a, otag );
-      a += 4;
-      len -= 4;
+      ocache_sarp_words( a, len / 4, otag );
+      a += len & ~(UWord)3;
+      len &= 3;
    }
    if (len >= 2) {
       MC_(helperc_b_store2)( a, otag );
@@ -7698,12 +7862,11 @@ static void ocache_sarp_Clear_Origins ( Addr a, UWord len ) {
       a += 2;
       len -= 2;
    }
-   if (len >= 4) 
+   if (len >= 4) {
       tl_assert(0 == (a & 3));
-   while (len >= 4) {
-      MC_(helperc_b_store4)( a, 0 );
-      a += 4;
-      len -= 4;
+      ocache_sarp_words( a, len / 4, 0 );
+      a += len & ~(UWord)3;
+      len &= 3;
    }
    if (len >= 2) {
       MC_(helperc_b_store2)( a, 0 );
@@ -7752,6 +7915,11 @@ static void mc_post_clo_init ( void )
 
    tl_assert( MC_(clo_mc_level) >= 1 && MC_(clo_mc_level) <= 3 );
 
+#  if VG_WORDSIZE == 8
+   if (MC_(clo_high_shadow_radix))
+      init_radix_L1();
+#  endif
+
    if (MC_(clo_mc_level) == 3) {
       /* We're doing origin tracking. */
 #     ifdef PERF_FAST_STACK
@@ -7845,15 +8013,15 @@ static void mc_post_clo_init ( void )
    VG_(track_new_mem_brk)         ( make_mem_defined_w_tid );
 #  endif
 
-   /* This origin tracking cache is huge (~100M), so only initialise
-      if we need it. */
+   /* The origin tag map reserves a lot of address space (16M on 64-bit
+      hosts), so only initialise it if we need it. */
    if (MC_(clo_mc_level) >= 3) {
       init_OCache();
-      tl_assert(ocacheL1 != NULL);
-      tl_assert(ocacheL2 != NULL);
+      tl_assert(ocache_map != NULL);
+      tl_assert(ocache_high != NULL);
    } else {
-      tl_assert(ocacheL1 == NULL);
-      tl_assert(ocacheL2 == NULL);
+      tl_assert(ocache_map == NULL);
+      tl_assert(ocache_high == NULL);
    }
 
    MC_(chunk_poolalloc) = VG_(newPA)
@@ -7913,6 +8081,10 @@ static void mc_print_stats (void)
       " memcheck: auxmaps_L2: %llu searches, %llu nodes\n",
       n_auxmap_L2_searches, n_auxmap_L2_nodes
    );   
+   if (MC_(clo_high_shadow_radix))
+      VG_(message)(Vg_DebugMsg,
+         " memcheck: radix: %llu L2 nodes (%lluk) in use\n",
+         n_radix_L2_nodes, n_radix_L2_nodes * 512 );
 
    print_SM_info("n_issued     ", n_issued_SMs);
    print_SM_info("n_deissued   ", n_deissued_SMs);
@@ -7946,39 +8118,26 @@ static void mc_print_stats (void)
       max_shmem_szB / 1024, max_shmem_szB / (1024 * 1024));
 
    if (MC_(clo_mc_level) >= 3) {
+      UWord finds_direct = stats_ocache_finds - stats_ocache_finds_high;
       VG_(message)(Vg_DebugMsg,
-                   " ocacheL1: %'12lu refs   %'12lu misses (%'lu lossage)\n",
-                   stats_ocacheL1_find, 
-                   stats_ocacheL1_misses,
-                   stats_ocacheL1_lossage );
-      VG_(message)(Vg_DebugMsg,
-                   " ocacheL1: %'12lu at 0   %'12lu at 1\n",
-                   stats_ocacheL1_find - stats_ocacheL1_misses 
-                      - stats_ocacheL1_found_at_1 
-                      - stats_ocacheL1_found_at_N,
-                   stats_ocacheL1_found_at_1 );
-      VG_(message)(Vg_DebugMsg,
-                   " ocacheL1: %'12lu at 2+  %'12lu move-fwds\n",
-                   stats_ocacheL1_found_at_N,
-                   stats_ocacheL1_movefwds );
-      VG_(message)(Vg_DebugMsg,
-                   " ocacheL1: %'12lu sizeB  %'12d useful\n",
-                   (SizeT)sizeof(OCache),
-                   4 * OC_W32S_PER_LINE * OC_LINES_PER_SET * OC_N_SETS );
+                   " ocache: %'12lu finds  %'12lu direct (%lu%%)\n",
+                   stats_ocache_finds, finds_direct,
+                   stats_ocache_finds == 0
+                      ? 0 : (100 * finds_direct) / stats_ocache_finds );
       VG_(message)(Vg_DebugMsg,
-                   " ocacheL2: %'12lu refs   %'12lu misses\n",
-                   stats__ocacheL2_refs, 
-                   stats__ocacheL2_misses );
+                   " ocache: %'12lu finds with no origins nearby\n",
+                   stats_ocache_finds_empty );
       VG_(message)(Vg_DebugMsg,
-                   " ocacheL2:    %'9lu max nodes %'9lu curr nodes\n",
-                   stats__ocacheL2_n_nodes_max,
-                   stats__ocacheL2_n_nodes );
+                   " ocache: %'12lu leaves %'12lu high leaves (%luk)\n",
+                   stats_ocache_n_leaves, stats_ocache_n_leaves_high,
+                   ((stats_ocache_n_leaves + stats_ocache_n_leaves_high)
+                    * sizeof(OCacheLeaf)) / 1024 );
       VG_(message)(Vg_DebugMsg,
                    " niacache: %'12lu refs   %'12lu misses\n",
                    stats__nia_cache_queries, stats__nia_cache_misses);
    } else {
-      tl_assert(ocacheL1 == NULL);
-      tl_assert(ocacheL2 == NULL);
+      tl_assert(ocache_map == NULL);
+      tl_assert(ocache_high == NULL);
    }
 }
 
@@ -8212,11 +8371,11 @@ static void mc_pre_clo_init(void)
    /* This is small.  Always initialise it. */
    init_nia_to_ecu_cache();
 
-   /* We can't initialise ocacheL1/ocacheL2 yet, since we don't know
-      if we need to, since the command line args haven't been
+   /* We can't initialise ocache_map/ocache_high yet, since we don't
+      know if we need to, since the command line args haven't been
       processed yet.  Hence defer it to mc_post_clo_init. */
-   tl_assert(ocacheL1 == NULL);
-   tl_assert(ocacheL2 == NULL);
+   tl_assert(ocache_map == NULL);
+   tl_assert(ocache_high == NULL);
 
    /* Check some important stuff.  See extensive comments above
       re UNALIGNED_OR_HIGH for background. */
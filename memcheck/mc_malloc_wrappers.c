@@ -58,6 +58,12 @@ static SizeT cmalloc_n_mallocs  = 0;
 static SizeT cmalloc_n_frees    = 0;
 static ULong cmalloc_bs_mallocd = 0;
 
+/* Incremented whenever a block is added to or removed from the malloc
+   list or a mempool, or has its address or size changed.  Lets the
+   leak checker reuse its sorted array of blocks when the heap layout
+   has not changed since the previous leak search. */
+static ULong chunks_gen = 0;
+
 /* For debug printing to do with mempools: what stack trace
    depth to show. */
 #define MEMPOOL_DEBUG_STACKTRACE_DEPTH 16
@@ -195,6 +201,7 @@ MC_Chunk* create_MC_Chunk ( ThreadId tid, Addr p, SizeT szB,
                             MC_AllocKind kind)
 {
    MC_Chunk* mc  = VG_(allocEltPA)(MC_(chunk_poolalloc));
+   chunks_gen++;
    mc->data      = p;
    mc->szB       = szB;
    mc->allockind = kind;
@@ -453,6 +460,8 @@ void* MC_(calloc) ( ThreadId tid, SizeT nmemb, SizeT size1 )
 static
 void die_and_free_mem ( ThreadId tid, MC_Chunk* mc, SizeT rzB )
 {
+   chunks_gen++;
+
    /* Note: we do not free fill the custom allocs produced
       by MEMPOOL or by MALLOC/FREELIKE_BLOCK requests. */
    if (MC_(clo_free_fill) != -1 && MC_AllocCustom != mc->allockind ) {
@@ -676,6 +685,7 @@ void MC_(handle_resizeInPlace)(ThreadId tid, Addr p,
        VG_(XTMemory_Full_resize_in_place)(oldSizeB,  newSizeB, mc->where[0]);
 
    mc->szB = newSizeB;
+   chunks_gen++;
    if (newSizeB < oldSizeB) {
       MC_(make_mem_noaccess)( p + newSizeB, oldSizeB - newSizeB + rzB );
    } else {
@@ -793,6 +803,7 @@ void MC_(destroy_mempool)(Addr pool)
       return;
    }
    check_mempool_sane(mp);
+   chunks_gen++;
 
    // Clean up the chunks, one by one
    VG_(HT_ResetIter)(mp->chunks);
@@ -982,6 +993,7 @@ void MC_(mempool_trim)(Addr pool, Addr addr, SizeT szB)
    }
 
    check_mempool_sane(mp);
+   chunks_gen++;
    chunks = VG_(HT_to_array) ( mp->chunks, &n_shadows );
    if (n_shadows == 0) {
      tl_assert(chunks == NULL);
@@ -1125,6 +1137,7 @@ void MC_(mempool_change)(Addr pool, Addr addrA, Addr addrB, SizeT szB)
 
    mc->data = addrB;
    mc->szB  = szB;
+   chunks_gen++;
    VG_(HT_add_node)( mp->chunks, mc );
 
    check_mempool_sane(mp);
@@ -1199,6 +1212,11 @@ SizeT MC_(get_cmalloc_n_frees) ( void )
    return cmalloc_n_frees;
 }
 
+ULong MC_(get_chunks_gen) ( void )
+{
+   return chunks_gen;
+}
+
 
 /*--------------------------------------------------------------------*/
 /*--- end                                                          ---*/
@@ -0,0 +1,60 @@
+/* Checks that definedness and addressability are tracked in memory
+   far above what memcheck's primary map covers (the lowest 128GB), in
+   two different 4GB regions and across 64KB chunk boundaries.  Run
+   with the default --high-shadow=auxmap and with --high-shadow=radix. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "../../memcheck.h"
+
+#define SZB  (4 * 65536)
+
+static char* const wanted[2] = { (char*)0x7e0000000000UL,
+                                 (char*)0x7e0100000000UL };
+
+int main ( void )
+{
+   char* buf = malloc(64);
+   char* p[2];
+   int   i, n = 0;
+
+   for (i = 0; i < 2; i++) {
+      p[i] = mmap(wanted[i], SZB, PROT_READ|PROT_WRITE,
+                  MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED, -1, 0);
+      if (p[i] == MAP_FAILED) {
+         perror("mmap");
+         return 1;
+      }
+   }
+
+   /* Undefined data, copied across a chunk boundary: one error. */
+   memset(buf, 'x', 64);
+   VALGRIND_MAKE_MEM_UNDEFINED(buf, 64);
+   memcpy(p[0] + 65536 - 32, buf, 64);
+   for (i = 0; i < 64; i++)
+      if (p[0][65536 - 32 + i] == 'x')
+         n++;
+
+   /* The same, defined, in the other region: no error. */
+   memset(buf, 'x', 64);
+   memcpy(p[1] + 65536 - 32, buf, 64);
+   for (i = 0; i < 64; i++)
+      if (p[1][65536 - 32 + i] == 'x')
+         n++;
+
+   /* Partly undefined, across a chunk boundary: one error. */
+   VALGRIND_MAKE_MEM_UNDEFINED(p[1] + 3 * 65536 - 8, 16);
+   VALGRIND_CHECK_MEM_IS_DEFINED(p[1] + 3 * 65536 - 16, 32);
+
+   /* Not addressable: one error. */
+   VALGRIND_MAKE_MEM_NOACCESS(p[0] + 2 * 65536, 65536);
+   n += *(volatile char*)(p[0] + 2 * 65536 + 100);
+
+   munmap(p[0], SZB);
+   munmap(p[1], SZB);
+   free(buf);
+   printf("%d\n", n);
+   return 0;
+}
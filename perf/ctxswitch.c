@@ -0,0 +1,76 @@
+// ctxswitch runs a number of threads that take turns on a lock shared by
+// all of them, and work on a private array of their own in between.  The
+// lock hand-offs, each followed by a yield, force many context switches
+// between threads that each have a sizeable set of recently accessed
+// memory.
+//
+// It is a stress test for DRD, which has to bring its conflict set (the
+// memory accesses of the other threads that are not ordered with those of
+// the running thread) up to date on every context switch.
+//
+// Usage: ctxswitch [nr_threads [nr_rounds]]
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PRIVATE_BYTES (256 * 1024)
+#define STRIDE        64
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int nr_rounds;
+static long shared[64];
+
+static void* worker(void* v)
+{
+   long id = (long)v;
+   unsigned char* priv = malloc(PRIVATE_BYTES);
+   unsigned x = id * 7919 + 1;
+   long sum = 0;
+   int r, i;
+
+   for (r = 0; r < nr_rounds; r++) {
+      pthread_mutex_lock(&lock);
+      shared[id % 64] += r;
+      sum += shared[(id + 1) % 64];
+      pthread_mutex_unlock(&lock);
+      sched_yield();
+
+      for (i = 0; i < PRIVATE_BYTES / STRIDE; i++) {
+         x = x * 1103515245u + 12345u;
+         priv[(x >> 8) % PRIVATE_BYTES] = r;
+      }
+   }
+   free(priv);
+   return (void*)sum;
+}
+
+int main(int argc, char* argv[])
+{
+   int nr_threads = argc > 1 ? atoi(argv[1]) : 16;
+   pthread_t* t;
+   long total = 0;
+   int i;
+
+   nr_rounds = argc > 2 ? atoi(argv[2]) : 100;
+   if (nr_threads < 1 || nr_rounds < 1) {
+      fprintf(stderr, "usage: ctxswitch [nr_threads [nr_rounds]]\n");
+      return 1;
+   }
+   t = malloc(nr_threads * sizeof(pthread_t));
+
+   for (i = 0; i < nr_threads; i++)
+      if (pthread_create(&t[i], NULL, worker, (void*)(long)i) != 0) {
+         perror("pthread_create");
+         return 1;
+      }
+   for (i = 0; i < nr_threads; i++) {
+      void* res;
+      pthread_join(t[i], &res);
+      total += (long)res;
+   }
+
+   free(t);
+   return total == 42 ? 2 : 0;
+}
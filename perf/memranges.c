@@ -0,0 +1,52 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// memranges is a micro-benchmark for the operations a tool does on
+// whole address ranges rather than on individual loads and stores:
+// checking syscall buffers (write/read), and copying the shadow state
+// of a block when realloc moves it.  Under memcheck, these are
+// dominated by is_mem_defined, is_mem_addressable and
+// copy_address_range_state respectively.
+
+#define BUF_SZB   (1024 * 1024)
+
+int main(int argc, char* argv[])
+{
+   int   nr_loops = argc > 1 ? atoi(argv[1]) : 400;
+   int   fd_null  = open("/dev/null", O_WRONLY);
+   int   fd_zero  = open("/dev/zero", O_RDONLY);
+   char* buf      = malloc(BUF_SZB);
+   char* r        = NULL;
+   long  total    = 0;
+   int   i;
+   size_t sz;
+
+   if (fd_null < 0 || fd_zero < 0 || buf == NULL) {
+      perror("memranges setup");
+      return 1;
+   }
+   memset(buf, 'x', BUF_SZB);
+
+   for (i = 0; i < nr_loops; i++) {
+      // Syscall buffer checks on a large, fully defined buffer.
+      total += write(fd_null, buf, BUF_SZB);
+      total += read(fd_zero, buf, BUF_SZB);
+
+      // Grow a block so realloc has to move it (and its shadow).
+      for (sz = 4096; sz <= BUF_SZB; sz *= 2) {
+         r = realloc(r, sz);
+         r[sz-1] = (char)i;
+      }
+      free(r);
+      r = NULL;
+   }
+
+   close(fd_null);
+   close(fd_zero);
+   free(buf);
+   printf("memranges: %ld bytes transferred\n", total);
+   return 0;
+}
@@ -0,0 +1,70 @@
+// thrchurn creates and joins a lot of short-lived threads, a few at a
+// time, like a server whose thread pool keeps growing and shrinking.
+// Each thread takes a lock shared by all the threads, updates some
+// shared data under it, and then works on data of its own.
+//
+// It is a stress test for the vector timestamps of Helgrind and DRD:
+// every thread that ever held the lock ends up in the timestamps that
+// are passed on through it.
+//
+// Usage: thrchurn [nr_threads [nr_concurrent]]
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PRIVATE_WORDS 256
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static long shared[64];
+
+static void* worker(void* v)
+{
+   long id = (long)v;
+   long priv[PRIVATE_WORDS];
+   long sum = 0;
+   int i;
+
+   pthread_mutex_lock(&lock);
+   shared[id % 64] += id;
+   sum = shared[(id + 1) % 64];
+   pthread_mutex_unlock(&lock);
+
+   for (i = 0; i < PRIVATE_WORDS; i++)
+      priv[i] = id + i;
+   for (i = 0; i < PRIVATE_WORDS; i++)
+      sum += priv[i];
+   return (void*)sum;
+}
+
+int main(int argc, char* argv[])
+{
+   int nr_threads    = argc > 1 ? atoi(argv[1]) : 2000;
+   int nr_concurrent = argc > 2 ? atoi(argv[2]) : 8;
+   pthread_t* t;
+   long total = 0;
+   int i, j;
+
+   if (nr_threads < 1 || nr_concurrent < 1) {
+      fprintf(stderr, "usage: thrchurn [nr_threads [nr_concurrent]]\n");
+      return 1;
+   }
+   t = malloc(nr_concurrent * sizeof(pthread_t));
+
+   for (i = 0; i < nr_threads; i += nr_concurrent) {
+      int n = nr_threads - i < nr_concurrent ? nr_threads - i : nr_concurrent;
+      for (j = 0; j < n; j++)
+         if (pthread_create(&t[j], NULL, worker, (void*)(long)(i + j)) != 0) {
+            perror("pthread_create");
+            return 1;
+         }
+      for (j = 0; j < n; j++) {
+         void* res;
+         pthread_join(t[j], &res);
+         total += (long)res;
+      }
+   }
+
+   free(t);
+   return total == 42 ? 2 : 0;
+}